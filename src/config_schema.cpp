@@ -0,0 +1,520 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <stddef.h>
+
+#include "config_schema.h"
+#include "frame_ack.h"
+#include "gateway_router.h"
+#include "i2c_output.h"
+#include "mqtt_bridge.h"
+#include "patch.h"
+#include "protocol.h"
+#include "relay_output.h"
+#include "remote_log.h"
+#include "rules.h"
+#include "timer_wheel.h"
+
+// ---------- ENUM NAMES ----------
+
+static const char *sourceName(uint8_t v)
+{
+    if (v == RELAY_SOURCE_ANY) return "any";
+    const ProtocolModule *m = protocolById(v);
+    return m ? m->name : nullptr;
+}
+
+static int sourceFromName(const char *name)
+{
+    if (strcasecmp(name, "any") == 0) return RELAY_SOURCE_ANY;
+    for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+        const ProtocolModule *m = protocolById(id);
+        if (m && strcasecmp(name, m->name) == 0) return id;
+    }
+    return -1;
+}
+
+static const char *policyName(uint8_t v)
+{
+    return v < RELAY_POLICY_COUNT ? relayPolicyName(v) : nullptr;
+}
+
+static const char *modeName(uint8_t v)
+{
+    return v < RELAY_MODE_COUNT ? relayModeName(v) : nullptr;
+}
+
+static constexpr CfgEnum SOURCE_CHOICES = { sourceName, sourceFromName };
+static constexpr CfgEnum POLICY_CHOICES = { policyName, relayPolicyFromName };
+static constexpr CfgEnum MODE_CHOICES   = { modeName,   relayModeFromName };
+static constexpr CfgEnum ACK_CHOICES    = { frameAckModeName, frameAckModeFromName };
+
+// ---------- THE TABLE ----------
+
+template <typename T> struct CfgTypeOf;
+template <> struct CfgTypeOf<uint8_t>  { static constexpr CfgType value = CfgType::U8;  };
+template <> struct CfgTypeOf<uint16_t> { static constexpr CfgType value = CfgType::U16; };
+template <> struct CfgTypeOf<uint32_t> { static constexpr CfgType value = CfgType::U32; };
+
+#define CFG_NUM(m, key, name, lo, hi, def, apply) \
+    { key, name, CfgTypeOf<decltype(DeviceConfig::m)>::value, 0, apply, \
+      offsetof(DeviceConfig, m), sizeof(DeviceConfig::m), lo, hi, def, nullptr, nullptr }
+#define CFG_STR(m, key, name, def, flags, apply) \
+    { key, name, CfgType::Str, flags, apply, offsetof(DeviceConfig, m), \
+      sizeof(DeviceConfig::m), 0, sizeof(DeviceConfig::m) - 1, 0, def, nullptr }
+#define CFG_ENUM(m, key, name, def, choices, apply) \
+    { key, name, CfgType::Enum, 0, apply, offsetof(DeviceConfig, m), \
+      sizeof(DeviceConfig::m), 0, 255, def, nullptr, &choices }
+#define CFG_RELAY(m, key, name, lo, hi, def, flags, apply) \
+    { key, name, CfgTypeOf<decltype(RelayConfig::m)>::value, CFG_PER_RELAY | (flags), apply, \
+      offsetof(RelayConfig, m), sizeof(RelayConfig::m), lo, hi, def, nullptr, nullptr }
+#define CFG_RELAY_ENUM(m, key, name, def, choices, apply) \
+    { key, name, CfgType::Enum, CFG_PER_RELAY, apply, offsetof(RelayConfig, m), \
+      sizeof(RelayConfig::m), 0, 255, def, nullptr, &choices }
+
+// NVS keys are the ones earlier firmware used, so upgrades keep settings.
+static constexpr ConfigField FIELDS[] = {
+    CFG_NUM(universe,   "u",     "universe",      0, 32767, ARTNET_UNIVERSE,    CFG_APPLY_PATCH),
+    CFG_NUM(startChan,  "s",     "startChan",     1, 513 - NUM_RELAYS, 1,       CFG_APPLY_PATCH),
+    CFG_NUM(protoMask,  "pm",    "protocol_mask", 0, 255, 0xFF,                 CFG_APPLY_PATCH),
+    CFG_NUM(eolCycles,  "eol",   "eol_cycles",    0, UINT32_MAX, 0,             0),
+    CFG_STR(ssid,       "ssid",  "wifi.ssid",     WIFI_SSID, 0,                 CFG_APPLY_REBOOT),
+    CFG_STR(pass,       "pass",  "wifi.pass",     WIFI_PASS, CFG_SECRET,        CFG_APPLY_REBOOT),
+    CFG_STR(logHost,    "lh",    "log.host",      "", 0,                        CFG_APPLY_LOG),
+    CFG_NUM(logPort,    "lp",    "log.port",      1, 65535, 514,                CFG_APPLY_LOG),
+    CFG_NUM(logLevel,   "ll",    "log.level",     (uint32_t)LogLevel::Error, (uint32_t)LogLevel::Debug,
+                                                  (uint32_t)LogLevel::Info,     CFG_APPLY_LOG),
+    CFG_STR(mqttHost,   "mh",    "mqtt.host",     "", 0,                        CFG_APPLY_MQTT),
+    CFG_NUM(mqttPort,   "mp",    "mqtt.port",     1, 65535, MQTT_DEFAULT_PORT,  CFG_APPLY_MQTT),
+    CFG_STR(mqttUser,   "mu",    "mqtt.user",     "", 0,                        CFG_APPLY_MQTT),
+    CFG_STR(mqttPass,   "mw",    "mqtt.pass",     "", CFG_SECRET,               CFG_APPLY_MQTT),
+    CFG_STR(mqttTopic,  "mt",    "mqtt.topic",    "", 0,                        CFG_APPLY_MQTT),
+    CFG_ENUM(ackMode,   "am",    "ack.mode",      FRAME_ACK_OFF, ACK_CHOICES,   CFG_APPLY_ACK),
+    CFG_NUM(ackEvery,   "ae",    "ack.every",     1, 255, 10,                   CFG_APPLY_ACK),
+    CFG_STR(ackHost,    "ah",    "ack.host",      "", 0,                        CFG_APPLY_ACK),
+    CFG_STR(gwRoutes,   "gw",    "gateway.routes", "", 0,                       CFG_APPLY_GATEWAY),
+    CFG_NUM(gwUniverse, "gwu",   "gateway.universe", 1, 63999, 1,               CFG_APPLY_GATEWAY),
+    CFG_NUM(gwUniverseSize, "gws", "gateway.universe_size", 1, 512, 510,        CFG_APPLY_GATEWAY),
+    CFG_STR(rules,      "rules", "rules",         "", 0,                        CFG_APPLY_PATCH),
+
+    CFG_RELAY(gpio,     "g",     "gpio",          0, OUTPUT_COUNT - 1, 0, CFG_DEF_INDEX, CFG_APPLY_OUTPUT),
+    CFG_RELAY_ENUM(source, "b",  "source",        RELAY_SOURCE_ANY, SOURCE_CHOICES, CFG_APPLY_PATCH),
+    CFG_RELAY_ENUM(policy, "p",  "policy",        RELAY_NEWEST,     POLICY_CHOICES, CFG_APPLY_PATCH),
+    CFG_RELAY_ENUM(mode,   "m",  "mode",          RELAY_LATCHED,    MODE_CHOICES,   0),
+    CFG_RELAY(pulseMs,  "d",     "pulse_ms",      WHEEL_TICK_MS, WHEEL_MAX_MS, 500, 0, 0),
+};
+static constexpr uint8_t FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+// Checked at build time: NVS key length (per-relay keys get up to two
+// digits), defaults inside their range / buffer, Enum storage, unique keys.
+static constexpr size_t cstrlen(const char *s)
+{
+    return *s ? 1 + cstrlen(s + 1) : 0;
+}
+
+static constexpr bool cstreq(const char *a, const char *b)
+{
+    return *a == *b && (!*a || cstreq(a + 1, b + 1));
+}
+
+static constexpr bool fieldOk(const ConfigField &f)
+{
+    return cstrlen(f.key) <= ((f.flags & CFG_PER_RELAY) ? 13 : 15) &&
+           (f.type == CfgType::Str  ? cstrlen(f.defStr) < f.size :
+            f.type == CfgType::Enum ? f.size == 1 :
+                                      f.def >= f.min && f.def <= f.max);
+}
+
+static constexpr bool keyUnique(const ConfigField *f, size_t n, const char *key)
+{
+    return n == 0 || (!cstreq(f->key, key) && keyUnique(f + 1, n - 1, key));
+}
+
+static constexpr bool tableOk(const ConfigField *f, size_t n)
+{
+    return n == 0 || (fieldOk(*f) && keyUnique(f + 1, n - 1, f->key) && tableOk(f + 1, n - 1));
+}
+
+static_assert(tableOk(FIELDS, FIELD_COUNT), "config schema: bad key, default or type");
+static_assert(NUM_RELAYS <= 100, "per-relay NVS keys allow two index digits");
+
+uint8_t configFieldCount()
+{
+    return FIELD_COUNT;
+}
+
+const ConfigField &configField(uint8_t i)
+{
+    return FIELDS[i];
+}
+
+const ConfigField *configFieldNamed(const char *name)
+{
+    for (const ConfigField &f : FIELDS) {
+        if (strcmp(f.name, name) == 0) return &f;
+    }
+    return nullptr;
+}
+
+// ---------- FIELD ACCESS ----------
+
+static inline uint8_t *fieldPtr(DeviceConfig &c, const ConfigField &f, uint8_t relay)
+{
+    uint8_t *base = (f.flags & CFG_PER_RELAY) ? (uint8_t *)&c.relays[relay] : (uint8_t *)&c;
+    return base + f.offset;
+}
+
+static inline const uint8_t *fieldPtr(const DeviceConfig &c, const ConfigField &f, uint8_t relay)
+{
+    return fieldPtr(const_cast<DeviceConfig &>(c), f, relay);
+}
+
+static uint32_t getNum(const uint8_t *p, const ConfigField &f)
+{
+    switch (f.size) {
+    case 1:  return *p;
+    case 2:  { uint16_t v; memcpy(&v, p, 2); return v; }
+    default: { uint32_t v; memcpy(&v, p, 4); return v; }
+    }
+}
+
+static void setNum(uint8_t *p, const ConfigField &f, uint32_t v)
+{
+    switch (f.size) {
+    case 1:  *p = (uint8_t)v; break;
+    case 2:  { uint16_t w = (uint16_t)v; memcpy(p, &w, 2); break; }
+    default: memcpy(p, &v, 4); break;
+    }
+}
+
+// Instances of a field: 1, or one per relay.
+static inline uint8_t instances(const ConfigField &f)
+{
+    return (f.flags & CFG_PER_RELAY) ? NUM_RELAYS : 1;
+}
+
+static void nvsKey(char *buf, const ConfigField &f, uint8_t relay)
+{
+    if (f.flags & CFG_PER_RELAY) snprintf(buf, 16, "%s%u", f.key, relay);
+    else                         strlcpy(buf, f.key, 16);
+}
+
+// "log.port" / "relays[3].pulse_ms", for error messages
+static void fieldLabel(char *buf, size_t len, const ConfigField &f, uint8_t relay)
+{
+    if (f.flags & CFG_PER_RELAY) snprintf(buf, len, "relays[%u].%s", relay, f.name);
+    else                         strlcpy(buf, f.name, len);
+}
+
+void configDefaults(DeviceConfig &c)
+{
+    for (const ConfigField &f : FIELDS) {
+        for (uint8_t r = 0; r < instances(f); r++) {
+            uint8_t *p = fieldPtr(c, f, r);
+            if (f.type == CfgType::Str) strlcpy((char *)p, f.defStr, f.size);
+            else setNum(p, f, (f.flags & CFG_DEF_INDEX) ? r : f.def);
+        }
+    }
+}
+
+// ---------- NVS ----------
+
+void configLoad(DeviceConfig &c, Preferences &prefs)
+{
+    char key[16];
+    for (const ConfigField &f : FIELDS) {
+        for (uint8_t r = 0; r < instances(f); r++) {
+            uint8_t *p = fieldPtr(c, f, r);
+            nvsKey(key, f, r);
+            if (f.type == CfgType::Str) {
+                // getString() leaves the buffer alone when the key is absent
+                prefs.getString(key, (char *)p, f.size);
+                p[f.size - 1] = '\0';
+            } else if (f.size == 1) {
+                *p = prefs.getUChar(key, *p);
+            } else if (f.size == 2) {
+                setNum(p, f, prefs.getUShort(key, getNum(p, f)));
+            } else {
+                setNum(p, f, prefs.getUInt(key, getNum(p, f)));
+            }
+        }
+    }
+}
+
+void configSave(const DeviceConfig &c, const DeviceConfig &prev, Preferences &prefs)
+{
+    char key[16];
+    for (const ConfigField &f : FIELDS) {
+        for (uint8_t r = 0; r < instances(f); r++) {
+            const uint8_t *p = fieldPtr(c, f, r);
+            const uint8_t *o = fieldPtr(prev, f, r);
+            bool same = (f.type == CfgType::Str)
+                      ? strncmp((const char *)p, (const char *)o, f.size) == 0
+                      : memcmp(p, o, f.size) == 0;
+            if (same) continue;         // flash wear: only what changed
+
+            nvsKey(key, f, r);
+            if (f.type == CfgType::Str) prefs.putString(key, (const char *)p);
+            else if (f.size == 1)       prefs.putUChar(key, *p);
+            else if (f.size == 2)       prefs.putUShort(key, (uint16_t)getNum(p, f));
+            else                        prefs.putUInt(key, getNum(p, f));
+        }
+    }
+}
+
+void configMerge(DeviceConfig &dst, const DeviceConfig &base, const DeviceConfig &next)
+{
+    for (const ConfigField &f : FIELDS) {
+        for (uint8_t r = 0; r < instances(f); r++) {
+            const uint8_t *n = fieldPtr(next, f, r);
+            const uint8_t *b = fieldPtr(base, f, r);
+            bool same = (f.type == CfgType::Str)
+                      ? strncmp((const char *)n, (const char *)b, f.size) == 0
+                      : memcmp(n, b, f.size) == 0;
+            if (!same) memcpy(fieldPtr(dst, f, r), n, f.size);
+        }
+    }
+}
+
+// ---------- PARSING ----------
+
+static bool storeNum(DeviceConfig &c, const ConfigField &f, uint8_t relay, uint32_t v,
+                     uint8_t *applied, char *err, size_t errLen)
+{
+    char label[32];
+    if (v < f.min || v > f.max) {
+        fieldLabel(label, sizeof(label), f, relay);
+        snprintf(err, errLen, "%s must be %u..%u", label, (unsigned)f.min, (unsigned)f.max);
+        return false;
+    }
+    uint8_t *p = fieldPtr(c, f, relay);
+    if (getNum(p, f) != v) {
+        setNum(p, f, v);
+        *applied |= f.apply;
+    }
+    return true;
+}
+
+static bool storeStr(DeviceConfig &c, const ConfigField &f, uint8_t relay, const char *s,
+                     uint8_t *applied, char *err, size_t errLen)
+{
+    char label[32];
+    if (strlen(s) >= f.size) {
+        fieldLabel(label, sizeof(label), f, relay);
+        snprintf(err, errLen, "%s longer than %u", label, (unsigned)(f.size - 1));
+        return false;
+    }
+    char *p = (char *)fieldPtr(c, f, relay);
+    if (strcmp(p, s) != 0) {
+        strlcpy(p, s, f.size);
+        *applied |= f.apply;
+    }
+    return true;
+}
+
+static bool storeName(DeviceConfig &c, const ConfigField &f, uint8_t relay, const char *s,
+                      uint8_t *applied, char *err, size_t errLen)
+{
+    int v = f.choices->fromName(s);
+    if (v < 0 || !f.choices->name((uint8_t)v)) {
+        char label[32];
+        fieldLabel(label, sizeof(label), f, relay);
+        snprintf(err, errLen, "unknown %s '%s'", label, s);
+        return false;
+    }
+    return storeNum(c, f, relay, (uint32_t)v, applied, err, errLen);
+}
+
+bool configParseText(DeviceConfig &c, const ConfigField &f, uint8_t relay,
+                     const char *text, uint8_t *applied, char *err, size_t errLen)
+{
+    if (f.type == CfgType::Str)  return storeStr(c, f, relay, text, applied, err, errLen);
+    if (f.type == CfgType::Enum) return storeName(c, f, relay, text, applied, err, errLen);
+
+    char *end = nullptr;
+    unsigned long v = strtoul(text, &end, 10);
+    if (!*text || *end || *text == '-') {
+        char label[32];
+        fieldLabel(label, sizeof(label), f, relay);
+        snprintf(err, errLen, "%s: not a number", label);
+        return false;
+    }
+    return storeNum(c, f, relay, (uint32_t)v, applied, err, errLen);
+}
+
+static bool storeVariant(DeviceConfig &c, const ConfigField &f, uint8_t relay,
+                         JsonVariantConst v, uint8_t *applied, char *err, size_t errLen)
+{
+    bool text = v.is<const char *>();
+    if (f.type == CfgType::Str && text)  return storeStr(c, f, relay, v.as<const char *>(), applied, err, errLen);
+    if (f.type == CfgType::Enum && text) return storeName(c, f, relay, v.as<const char *>(), applied, err, errLen);
+    if (f.type != CfgType::Str && f.type != CfgType::Enum && v.is<uint32_t>()) {
+        return storeNum(c, f, relay, v.as<uint32_t>(), applied, err, errLen);
+    }
+
+    char label[32];
+    fieldLabel(label, sizeof(label), f, relay);
+    snprintf(err, errLen, "%s: wrong type", label);
+    return false;
+}
+
+// Split "group.leaf"; group is empty for top-level names.
+static const char *splitName(const char *name, char *group, size_t len)
+{
+    const char *dot = strchr(name, '.');
+    if (!dot) {
+        group[0] = '\0';
+        return name;
+    }
+    size_t n = dot - name < (ptrdiff_t)len ? dot - name : len - 1;
+    memcpy(group, name, n);
+    group[n] = '\0';
+    return dot + 1;
+}
+
+bool configFromJson(DeviceConfig &c, JsonObjectConst root, uint8_t *applied,
+                    char *err, size_t errLen)
+{
+    JsonArrayConst relays = root["relays"];
+    char group[16];
+
+    for (const ConfigField &f : FIELDS) {
+        if (f.flags & CFG_PER_RELAY) {
+            uint8_t pos = 0;
+            for (JsonObjectConst o : relays) {
+                // {"index":n,..} addresses a relay; otherwise array position
+                uint8_t r = o["index"].is<uint8_t>() ? o["index"].as<uint8_t>() : pos;
+                pos++;
+                JsonVariantConst v = o[f.name];
+                if (v.isNull()) continue;
+                if (r >= NUM_RELAYS) {
+                    snprintf(err, errLen, "relay index %u out of range", r);
+                    return false;
+                }
+                if (!storeVariant(c, f, r, v, applied, err, errLen)) return false;
+            }
+            continue;
+        }
+
+        const char *leaf = splitName(f.name, group, sizeof(group));
+        JsonObjectConst scope = group[0] ? root[group].as<JsonObjectConst>() : root;
+        JsonVariantConst v = scope[leaf];
+        if (v.isNull()) continue;
+        if (!storeVariant(c, f, 0, v, applied, err, errLen)) return false;
+    }
+    return true;
+}
+
+bool configValidate(const DeviceConfig &c, char *err, size_t errLen)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        const RelayConfig &rc = c.relays[i];
+        if ((rc.policy == RELAY_BIND || rc.policy == RELAY_PRIORITY) &&
+            rc.source == RELAY_SOURCE_ANY) {
+            snprintf(err, errLen, "relays[%u]: policy %s needs a source", i,
+                     relayPolicyName(rc.policy));
+            return false;
+        }
+    }
+
+    IPAddress collector;
+    if (c.ackMode == FRAME_ACK_COLLECTOR && !collector.fromString(c.ackHost)) {
+        snprintf(err, errLen, "ack.mode collector needs ack.host as an IPv4 address");
+        return false;
+    }
+
+    static GatewayTable routes;
+    if (!gatewayParseRoutes(c.gwRoutes, routes, err, errLen)) return false;
+
+    // Compile here so a typo is reported instead of applied.
+    static RuleProgram check;
+    if (!rulesCompile(c.rules, check, err, errLen)) return false;
+    return true;
+}
+
+// ---------- JSON OUT ----------
+
+static JsonObject groupObject(JsonObject root, const char *group)
+{
+    if (!group[0]) return root;
+    JsonObject g = root[group];
+    if (g.isNull()) g = root[group].to<JsonObject>();
+    return g;
+}
+
+static void putValue(JsonObject obj, const char *leaf, const ConfigField &f, const uint8_t *p)
+{
+    switch (f.type) {
+    case CfgType::Str:
+        obj[leaf] = (const char *)p;
+        break;
+    case CfgType::Enum: {
+        const char *name = f.choices->name(*p);
+        obj[leaf] = name ? name : "?";
+        break;
+    }
+    default:
+        obj[leaf] = getNum(p, f);
+        break;
+    }
+}
+
+void configToJson(const DeviceConfig &c, JsonObject root)
+{
+    JsonArray relays = root["relays"];
+    if (relays.isNull()) {
+        relays = root["relays"].to<JsonArray>();
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) relays.add<JsonObject>();
+    }
+
+    char group[16];
+    for (const ConfigField &f : FIELDS) {
+        if (f.flags & CFG_SECRET) continue;
+        if (f.flags & CFG_PER_RELAY) {
+            for (uint8_t r = 0; r < NUM_RELAYS; r++) {
+                putValue(relays[r], f.name, f, fieldPtr(c, f, r));
+            }
+            continue;
+        }
+        const char *leaf = splitName(f.name, group, sizeof(group));
+        putValue(groupObject(root, group), leaf, f, fieldPtr(c, f, 0));
+    }
+}
+
+static const char *const TYPE_NAMES[] = { "u8", "u16", "u32", "str", "enum" };
+
+void configSchemaToJson(JsonObject root)
+{
+    root["relays"] = NUM_RELAYS;
+    JsonArray fields = root["fields"].to<JsonArray>();
+
+    for (const ConfigField &f : FIELDS) {
+        JsonObject o = fields.add<JsonObject>();
+        o["name"] = f.name;
+        o["type"] = TYPE_NAMES[(uint8_t)f.type];
+        if (f.flags & CFG_PER_RELAY)     o["per_relay"] = true;
+        if (f.flags & CFG_SECRET)        o["secret"]    = true;
+        if (f.apply & CFG_APPLY_REBOOT)  o["reboot"]    = true;
+
+        switch (f.type) {
+        case CfgType::Str:
+            o["max_len"] = f.max;
+            o["default"] = f.defStr;
+            break;
+        case CfgType::Enum: {
+            JsonArray names = o["choices"].to<JsonArray>();
+            for (uint16_t v = 0; v <= 0xFF; v++) {
+                const char *name = f.choices->name((uint8_t)v);
+                if (name) names.add(name);
+            }
+            o["default"] = f.choices->name((uint8_t)f.def);
+            break;
+        }
+        default:
+            o["min"] = f.min;
+            o["max"] = f.max;
+            if (f.flags & CFG_DEF_INDEX) o["default"] = "index";
+            else                         o["default"] = f.def;
+            break;
+        }
+    }
+}
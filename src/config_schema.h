@@ -0,0 +1,98 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+#include "main_config.h"
+
+class Preferences;
+
+// ---------- CONFIG SCHEMA ----------
+//
+// One table (config_schema.cpp) describes every persisted DeviceConfig
+// field: NVS key, JSON name, type, range, default and what has to be
+// re-applied when it changes. NVS load/save, the /api/config JSON in both
+// directions, form handlers and /api/schema (which the UI renders) all
+// walk that table, so adding a setting is one line there.
+//
+// JSON names may carry one group level ("log.port" -> {"log":{"port":..}}).
+// Per-relay fields live in "relays":[{..}, ..] and get the relay index
+// appended to their NVS key.
+//
+
+enum class CfgType : uint8_t { U8, U16, U32, Str, Enum };
+
+// Flags
+#define CFG_PER_RELAY         0x01        // one value per relay
+#define CFG_SECRET            0x02        // accepted, never sent back
+#define CFG_DEF_INDEX         0x04        // default is the relay index
+
+// What to re-apply after a change (ConfigField.apply, bits OR'ed)
+#define CFG_APPLY_PATCH       0x01        // patch / dispatch masks
+#define CFG_APPLY_OUTPUT      0x02        // relay -> output mapping
+#define CFG_APPLY_LOG         0x04
+#define CFG_APPLY_MQTT        0x08
+#define CFG_APPLY_REBOOT      0x10        // only takes effect after restart
+#define CFG_APPLY_ACK         0x20
+#define CFG_APPLY_GATEWAY     0x40
+
+// Named values of an Enum field (stored as uint8_t). name() returns
+// nullptr for values that aren't valid; fromName() returns -1.
+struct CfgEnum {
+    const char *(*name)(uint8_t value);
+    int         (*fromName)(const char *name);
+};
+
+struct ConfigField {
+    const char    *key;         // NVS key, max 15 chars incl. relay index
+    const char    *name;        // JSON name
+    CfgType        type;
+    uint8_t        flags;       // CFG_*
+    uint8_t        apply;       // CFG_APPLY_*
+    uint16_t       offset;      // in DeviceConfig, or RelayConfig if per relay
+    uint16_t       size;        // bytes (strings: buffer incl. NUL)
+    uint32_t       min;
+    uint32_t       max;
+    uint32_t       def;
+    const char    *defStr;      // Str default
+    const CfgEnum *choices;     // Enum names
+};
+
+uint8_t configFieldCount();
+const ConfigField &configField(uint8_t i);
+
+// Field by JSON name ("log.port"), nullptr if there is none.
+const ConfigField *configFieldNamed(const char *name);
+
+// Every field to its default.
+void configDefaults(DeviceConfig &c);
+
+// NVS: load keeps the current value for absent keys; save only writes
+// fields that differ from prev (what was last loaded / saved).
+void configLoad(DeviceConfig &c, Preferences &prefs);
+void configSave(const DeviceConfig &c, const DeviceConfig &prev, Preferences &prefs);
+
+// Non-secret fields into root (creates groups and relays[]).
+void configToJson(const DeviceConfig &c, JsonObject root);
+
+// Apply the fields present in root to c. Stops at the first bad value
+// with a message in err; c may then be partly changed, so parse into a
+// copy. *applied collects CFG_APPLY_* of fields that changed.
+bool configFromJson(DeviceConfig &c, JsonObjectConst root, uint8_t *applied,
+                    char *err, size_t errLen);
+
+// One field from text (form parameter). relay is ignored for global fields.
+bool configParseText(DeviceConfig &c, const ConfigField &f, uint8_t relay,
+                     const char *text, uint8_t *applied, char *err, size_t errLen);
+
+// Copy into dst every field (and relay instance) in which next differs
+// from base, leaving the rest of dst alone: applies an edit made on a copy
+// of base without undoing changes dst got in the meantime.
+void configMerge(DeviceConfig &dst, const DeviceConfig &base, const DeviceConfig &next);
+
+// Rules across fields (policy vs source, rules program). Run before
+// adopting a parsed copy.
+bool configValidate(const DeviceConfig &c, char *err, size_t errLen);
+
+// Machine-readable description for the UI.
+void configSchemaToJson(JsonObject root);
@@ -0,0 +1,145 @@
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#include "control.h"
+#include "packet_task.h"
+#include "scenes.h"
+#include "test_pattern.h"
+#include "remote_log.h"
+
+// Commands are parsed in the socket callback and handed to the packet
+// task; the reply says whether they were accepted.
+static AsyncUDP g_ctrlUdp;
+
+typedef bool (*ControlFn)(char *args, char *reply, size_t replyLen);
+
+struct ControlCommand {
+    const char *name;
+    ControlFn   fn;
+};
+
+// TEST <pattern> [stepMs] [board]
+static bool cmdTest(char *args, char *reply, size_t replyLen)
+{
+    char *save = nullptr;
+    char *name = strtok_r(args, " ", &save);
+    if (!name) {
+        snprintf(reply, replyLen, "ERR missing pattern");
+        return false;
+    }
+    if (strcasecmp(name, "stop") == 0) {
+        PacketCommand cmd = { PKT_CMD_TEST_STOP, 0, 0, 0, 0, 0, 0 };
+        if (!packetCommand(cmd)) {
+            snprintf(reply, replyLen, "ERR busy");
+            return false;
+        }
+        snprintf(reply, replyLen, "OK stopped");
+        return true;
+    }
+
+    TestPattern p = testPatternFromName(name);
+    if (p == TestPattern::None) {
+        snprintf(reply, replyLen, "ERR unknown pattern '%s'", name);
+        return false;
+    }
+
+    char *stepArg  = strtok_r(nullptr, " ", &save);
+    char *boardArg = strtok_r(nullptr, " ", &save);
+    uint16_t stepMs = TEST_STEP_DEFAULT_MS;
+    uint8_t  board  = boardArg ? (uint8_t)atoi(boardArg)  : 0;
+    if (stepArg && !testPatternParseStep(stepArg, stepMs)) {
+        snprintf(reply, replyLen, "ERR step must be %u..%u ms", TEST_STEP_MIN_MS, TEST_STEP_MAX_MS);
+        return false;
+    }
+
+    PacketCommand cmd = { PKT_CMD_TEST, 0, (uint8_t)p, board, stepMs, 0, 0 };
+    if (!packetCommand(cmd)) {
+        snprintf(reply, replyLen, "ERR busy");
+        return false;
+    }
+    snprintf(reply, replyLen, "OK %s", testPatternName(p));
+    return true;
+}
+
+// SCENE <n|name> | SCENE SAVE <n> [name]
+static bool cmdScene(char *args, char *reply, size_t replyLen)
+{
+    char *save = nullptr;
+    char *what = strtok_r(args, " ", &save);
+    if (!what) {
+        snprintf(reply, replyLen, "ERR missing scene");
+        return false;
+    }
+
+    if (strcasecmp(what, "save") == 0) {
+        char   *numArg = strtok_r(nullptr, " ", &save);
+        uint8_t n      = numArg ? (uint8_t)atoi(numArg) : 0;
+        if (!sceneCapture(n, save)) {
+            snprintf(reply, replyLen, "ERR scene must be 1..%u", SCENE_COUNT);
+            return false;
+        }
+        snprintf(reply, replyLen, "OK saved %u", n);
+        return true;
+    }
+
+    // The rest of the line is the name, spaces and all.
+    if (save && *save) what[strlen(what)] = ' ';
+    uint8_t n = sceneFind(what);
+    if (!n || !sceneRecall(n)) {
+        snprintf(reply, replyLen, n ? "ERR busy" : "ERR no scene '%s'", what);
+        return false;
+    }
+    snprintf(reply, replyLen, "OK scene %u", n);
+    return true;
+}
+
+static const ControlCommand COMMANDS[] = {
+    { "TEST",  cmdTest },
+    { "SCENE", cmdScene },
+};
+
+static void controlPacket(AsyncUDPPacket &packet)
+{
+    char   line[128];
+    char   reply[96];
+    size_t len = packet.length();
+    if (!len) return;
+    if (len > sizeof(line) - 1) len = sizeof(line) - 1;
+    memcpy(line, packet.data(), len);
+    line[len] = '\0';
+
+    // Strip trailing newline / whitespace from netcat & friends.
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r' ||
+                       line[len - 1] == ' ')) {
+        line[--len] = '\0';
+    }
+
+    char *save = nullptr;
+    char *verb = strtok_r(line, " ", &save);
+    char *args = save ? save : (char *)"";
+
+    snprintf(reply, sizeof(reply), "ERR unknown command");
+    if (verb) {
+        for (const ControlCommand &c : COMMANDS) {
+            if (strcasecmp(verb, c.name) == 0) {
+                c.fn(args, reply, sizeof(reply));
+                break;
+            }
+        }
+    }
+
+    LOGD("[CONTROL] '%s' from %s -> %s", verb ? verb : "",
+         packet.remoteIP().toString().c_str(), reply);
+
+    packet.write((const uint8_t *)reply, strlen(reply));
+}
+
+void startControl()
+{
+    if (!g_ctrlUdp.listen(CONTROL_PORT)) {
+        LOGE("[CONTROL] FAILED to open UDP port %u", CONTROL_PORT);
+        return;
+    }
+    g_ctrlUdp.onPacket(controlPacket);
+    LOGI("[CONTROL] Listening for commands on UDP port %u", CONTROL_PORT);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+// Plain-text UDP control port for scripts and show tools. One command per
+// datagram, answered with "OK ..." or "ERR <reason>":
+//
+//   TEST <walk|pulse|chase|board|stop> [stepMs] [board]
+//   SCENE <n|name>                      recall a scene (see scenes.h)
+//   SCENE SAVE <n> [name]               store the current relay state
+//
+#define CONTROL_PORT 4050
+
+// Open the control port; commands are handled from the socket callback.
+void startControl();
@@ -1,15 +1,20 @@
 #include <WiFi.h>
-#include <WiFiUdp.h>
+#include <AsyncUDP.h>
 #include <ArduinoJson.h>
+#include <atomic>
 
 #include "main_config.h"   // for DeviceConfig cfg
 #include "discovery.h"
+#include "json_arena.h"
+#include "patch.h"
+#include "protocol.h"
+#include "remote_log.h"
 
 // Global config object from main_config.h
 extern DeviceConfig cfg;
 
-// UDP socket for discovery
-static WiFiUDP g_discUdp;
+// UDP socket for discovery (answered from the lwIP callback, no polling)
+static AsyncUDP g_discUdp;
 // Multicast group used by FPP/xLights MultiSync + discovery
 static const IPAddress MULTISYNC_MCAST(239, 70, 80, 80);
 
@@ -17,13 +22,27 @@ static const IPAddress MULTISYNC_MCAST(239, 70, 80, 80);
 // (FPPDiscovery subscribes to broadcast + multicast on 32320)
 static const uint16_t FPP_DISCOVERY_PORT = 32320;
 
-// Small buffer for incoming packets
-static uint8_t g_discBuf[512];
+// The reply only changes with the patch / protocol set, so it is rendered
+// once and re-sent as-is for every query. Two buffers: loop() renders into
+// the spare one while the socket callback may be sending the live one.
+static char              g_replyBuf[2][768];
+static size_t            g_replyLen[2] = { 0, 0 };
+static volatile uint8_t  g_replyLive   = 0;
+static std::atomic<bool> g_replyStale{true};
 
-// Helper: build discovery JSON and send back to the requester
-static void sendDiscoveryReply(const IPAddress &remoteIP, uint16_t remotePort)
+void discoveryRebuildReply()
 {
-    DynamicJsonDocument doc(512);
+    g_replyStale.store(true, std::memory_order_release);
+}
+
+static void renderReply()
+{
+    // Copied: loop() can be pre-empted for longer than a patch slot's grace
+    const Patch &patch     = activePatch();
+    uint16_t     universe  = patch.universe;
+    uint16_t     startChan = patch.startChan;
+    JsonArenaScope arena;
+    JsonDocument   doc(arena.allocator());
 
     // xLights expects EXACTLY this:
     doc["type"]     = "ESPixelStick";
@@ -35,88 +54,77 @@ static void sendDiscoveryReply(const IPAddress &remoteIP, uint16_t remotePort)
     const char *host = WiFi.getHostname() ? WiFi.getHostname() : "esp32-relay";
     doc["name"]     = host;
     doc["hostname"] = host;
-    doc["addr"]     = WiFi.localIP().toString();
-
-    // Supported protocols
-    JsonObject proto = doc.createNestedObject("protocols");
-    proto["e131"]   = true;
-    proto["artnet"] = true;
-    proto["ddp"]    = true;
+    IPAddress ip = WiFi.localIP();
+    char addr[16];
+    snprintf(addr, sizeof(addr), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    doc["addr"]     = addr;
+
+    // Supported protocols (only the ones currently enabled)
+    uint8_t enabled = protocolsEnabledMask();
+    JsonObject proto = doc["protocols"].to<JsonObject>();
+    proto["e131"]   = (bool)(enabled & (1u << PROTO_E131));
+    proto["artnet"] = (bool)(enabled & (1u << PROTO_ARTNET));
+    proto["ddp"]    = (bool)(enabled & (1u << PROTO_DDP));
 
     // Outputs array (MUST EXIST)
-    JsonArray outputs = doc.createNestedArray("outputs");
-    JsonObject out    = outputs.createNestedObject();
+    JsonArray outputs = doc["outputs"].to<JsonArray>();
+    JsonObject out    = outputs.add<JsonObject>();
     out["type"]       = "DDP";         // or "e1.31" but DDP matches your setup
-    out["channel_start"] = cfg.startChan;
+    out["channel_start"] = startChan;
     out["channel_count"] = NUM_RELAYS;
-    out["universe"]       = cfg.universe;
+    out["universe"]       = universe;
     out["universe_count"] = 1;
 
     // Indicate that we can follow MultiSync commands while using on-board
     // storage (SD/SPIFFS) for media/sequences.
-    JsonObject sync = doc.createNestedObject("multisync");
+    JsonObject sync = doc["multisync"].to<JsonObject>();
     sync["enabled"]  = true;
     sync["sd_card"]  = true;
     sync["storage"]  = "sd";
 
-    String outStr;
-    serializeJson(doc, outStr);
-
-    Serial.printf("[DISCOVERY] Reply -> %s:%u : %s\n",
-                  remoteIP.toString().c_str(), remotePort, outStr.c_str());
+    if (doc.overflowed()) {
+        LOGE("[DISCOVERY] reply did not fit the JSON arena");
+        return;                     // keep answering with the old reply
+    }
 
-    g_discUdp.beginPacket(remoteIP, remotePort);
-    g_discUdp.write((const uint8_t *)outStr.c_str(), outStr.length());
-    g_discUdp.endPacket();
+    uint8_t spare = g_replyLive ^ 1;
+    g_replyLen[spare] = serializeJson(doc, g_replyBuf[spare], sizeof(g_replyBuf[spare]));
+    g_replyLive = spare;
 }
-void startXLightsDiscovery()
+
+void discoveryTick()
 {
-    // Listen on FPP/xLights discovery port 32320 on all interfaces
-    // Join the MultiSync multicast group so xLights/FPP "SD card" sync
-    // broadcasts are seen alongside unicast/broadcast discovery traffic.
-    if (!g_discUdp.beginMulticast(WiFi.localIP(), MULTISYNC_MCAST, FPP_DISCOVERY_PORT)) {
-        Serial.println("[DISCOVERY] FAILED to join multicast group 239.70.80.80:32320");
-        return;
-    }
+    if (g_replyStale.exchange(false, std::memory_order_acquire)) renderReply();
+}
 
-    // Also bind the unicast listener for direct queries.
-    if (!g_discUdp.begin(FPP_DISCOVERY_PORT)) {
-        Serial.println("[DISCOVERY] FAILED to open UDP port 32320 for unicast");
-        return;
-    }
+// For now we don't try to parse the query; we just assume any packet
+// on 32320 is a discovery request and answer with our JSON.
+static void discoveryPacket(AsyncUDPPacket &packet)
+{
+    uint8_t live = g_replyLive;
+    if (!g_replyLen[live]) return;
 
-    Serial.print("[DISCOVERY] Listening for discovery on UDP port ");
-    Serial.println(FPP_DISCOVERY_PORT);
+    LOGD("[DISCOVERY] Reply -> %s:%u (%u bytes)",
+         packet.remoteIP().toString().c_str(), packet.remotePort(),
+         (unsigned)g_replyLen[live]);
 
-    Serial.print("[DISCOVERY] Joined MultiSync multicast group: ");
-    Serial.println(MULTISYNC_MCAST);
+    packet.write((const uint8_t *)g_replyBuf[live], g_replyLen[live]);
 }
 
-// Call this from loop()
-void handleXLightsDiscovery()
+void startXLightsDiscovery()
 {
-    int packetSize = g_discUdp.parsePacket();
-    if (!packetSize)
-        return;
-
-    if (packetSize > (int)sizeof(g_discBuf))
-        packetSize = sizeof(g_discBuf);
+    discoveryTick();
 
-    int len = g_discUdp.read(g_discBuf, packetSize);
-    if (len <= 0)
+    // Listen on FPP/xLights discovery port 32320 on all interfaces and join
+    // the MultiSync multicast group so xLights/FPP "SD card" sync broadcasts
+    // are seen alongside unicast/broadcast discovery traffic.
+    if (!g_discUdp.listenMulticast(MULTISYNC_MCAST, FPP_DISCOVERY_PORT)) {
+        LOGE("[DISCOVERY] FAILED to join multicast group 239.70.80.80:32320");
         return;
+    }
+    g_discUdp.onPacket(discoveryPacket);
 
-    IPAddress remoteIP   = g_discUdp.remoteIP();
-    uint16_t remotePort  = g_discUdp.remotePort();
-
-    Serial.print("[DISCOVERY] Packet from ");
-    Serial.print(remoteIP);
-    Serial.print(":");
-    Serial.print(remotePort);
-    Serial.print(" len=");
-    Serial.println(len);
-
-    // For now we don't try to parse the query; we just assume any packet
-    // on 32320 is a discovery request and answer with our JSON.
-    sendDiscoveryReply(remoteIP, remotePort);
+    LOGI("[DISCOVERY] Listening for discovery on UDP port %u", FPP_DISCOVERY_PORT);
+    LOGI("[DISCOVERY] Joined MultiSync multicast group: %s",
+         MULTISYNC_MCAST.toString().c_str());
 }
@@ -1,8 +1,14 @@
 
 #pragma once
 
-// Start UDP listener(s) for discovery (xLights / FPP style)
+// Start UDP listener(s) for discovery (xLights / FPP style). Queries are
+// answered straight from the socket callback.
 void startXLightsDiscovery();
 
-// Poll / process incoming discovery packets (call from loop())
-void handleXLightsDiscovery();
\ No newline at end of file
+// The cached reply is out of date (patch, protocols or address changed).
+// Any task, including the packet task: it only sets a flag.
+void discoveryRebuildReply();
+
+// Re-render the reply if it is out of date (call from loop()). Rendering
+// borrows the shared JSON arena, which the relay path must never wait on.
+void discoveryTick();
@@ -0,0 +1,115 @@
+#include <Arduino.h>
+#include <atomic>
+
+#include "event_bus.h"
+
+static_assert((EVENT_BUS_DEPTH & (EVENT_BUS_DEPTH - 1)) == 0, "EVENT_BUS_DEPTH must be a power of two");
+
+struct Subscriber {
+    const char           *name;
+    TaskHandle_t          notify;
+    std::atomic<uint32_t> head{0};      // written by the publisher
+    std::atomic<uint32_t> tail{0};      // written by the consumer
+    uint32_t              delivered;
+    uint32_t              dropped;
+    RelayEvent            ring[EVENT_BUS_DEPTH];
+
+    // Overflow: newest event that didn't fit, under a sequence lock
+    // (odd = publisher mid-write). lastSeq is the consumer's.
+    std::atomic<uint32_t> latestLock{0};
+    RelayEvent            latest;
+    uint32_t              lastSeq;
+};
+
+static Subscriber            g_subs[EVENT_BUS_MAX_SUBS];
+static std::atomic<uint8_t>  g_subCount{0};
+static uint32_t              g_seq = 0;
+
+int eventBusSubscribe(const char *name, TaskHandle_t notify)
+{
+    uint8_t id = g_subCount.load();
+    if (id >= EVENT_BUS_MAX_SUBS) return -1;
+
+    g_subs[id].name   = name;
+    g_subs[id].notify = notify;
+    g_subCount.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+void eventBusPublish(RelayMask changed, RelayMask state)
+{
+    RelayEvent ev = { ++g_seq, (uint32_t)millis(), changed, state };
+
+    uint8_t n = g_subCount.load(std::memory_order_acquire);
+    for (uint8_t i = 0; i < n; i++) {
+        Subscriber &s = g_subs[i];
+        uint32_t head = s.head.load(std::memory_order_relaxed);
+        if (head - s.tail.load(std::memory_order_acquire) >= EVENT_BUS_DEPTH) {
+            // Slow consumer: keep only the newest for it, never wait.
+            uint32_t lock = s.latestLock.load(std::memory_order_relaxed);
+            s.latestLock.store(lock + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            s.latest = ev;
+            s.latestLock.store(lock + 2, std::memory_order_release);
+            s.dropped++;
+        } else {
+            s.ring[head & (EVENT_BUS_DEPTH - 1)] = ev;
+            s.head.store(head + 1, std::memory_order_release);
+            s.delivered++;
+        }
+        if (s.notify) xTaskNotifyGive(s.notify);
+    }
+}
+
+bool eventBusPoll(int sub, RelayEvent &out)
+{
+    if (sub < 0 || sub >= g_subCount.load(std::memory_order_acquire)) return false;
+
+    Subscriber &s = g_subs[sub];
+    uint32_t tail = s.tail.load(std::memory_order_relaxed);
+    if (tail != s.head.load(std::memory_order_acquire)) {
+        out = s.ring[tail & (EVENT_BUS_DEPTH - 1)];
+        s.tail.store(tail + 1, std::memory_order_release);
+        s.lastSeq = out.seq;
+        return true;
+    }
+
+    // Ring drained: the overflow slot, if it is newer than what we read.
+    RelayEvent ev;
+    uint32_t   lock;
+    do {
+        lock = s.latestLock.load(std::memory_order_acquire);
+        ev   = s.latest;
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((lock & 1) || lock != s.latestLock.load(std::memory_order_relaxed));
+
+    if (!lock || (int32_t)(ev.seq - s.lastSeq) <= 0) return false;
+    out       = ev;
+    s.lastSeq = ev.seq;
+    return true;
+}
+
+size_t eventBusFormat(const RelayEvent &ev, char *buf, size_t len)
+{
+    int n = snprintf(buf, len, "{\"seq\":%u,\"state\":\"", (unsigned)ev.seq);
+    for (uint8_t i = 0; i < NUM_RELAYS && n < (int)len - 3; i++) {
+        buf[n++] = (ev.state & ((RelayMask)1 << i)) ? '1' : '0';
+    }
+    buf[n++] = '"';
+    buf[n++] = '}';
+    buf[n]   = '\0';
+    return n;
+}
+
+void eventBusPrintMetrics(Print &out)
+{
+    uint8_t n = g_subCount.load(std::memory_order_acquire);
+    out.printf("relay_events_published_total %u\n", (unsigned)g_seq);
+    for (uint8_t i = 0; i < n; i++) {
+        const Subscriber &s = g_subs[i];
+        uint32_t queued = s.head.load() - s.tail.load();
+        out.printf("relay_events_delivered_total{sub=\"%s\"} %u\n", s.name, (unsigned)s.delivered);
+        out.printf("relay_events_dropped_total{sub=\"%s\"} %u\n", s.name, (unsigned)s.dropped);
+        out.printf("relay_events_queued{sub=\"%s\"} %u\n", s.name, (unsigned)queued);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+
+#include "main_config.h"
+
+class Print;
+
+// ---------- OUTPUT EVENT BUS ----------
+//
+// commitRelays() publishes one event per commit that changed anything.
+// Each subscriber gets its own single-producer/single-consumer ring, so
+// publishing is a few stores per subscriber with no lock and no wait.
+// When a ring is full the event goes to that subscriber's "latest" slot
+// instead (overwritten by every later overflow, counted as dropped), and
+// the consumer reads it once the ring is drained. Every event carries the
+// complete state, so a consumer that fell behind still ends on the newest
+// state, even when the burst that overflowed it was the last change.
+//
+// Subscribe once at startup; the subscriber id is then owned by one
+// consumer task.
+//
+
+#define EVENT_BUS_MAX_SUBS    4
+#define EVENT_BUS_DEPTH       16          // power of two
+
+struct RelayEvent {
+    uint32_t  seq;          // commit number, gaps = events dropped for you
+                            // (changed then only covers this commit)
+    uint32_t  ms;           // millis() at commit
+    RelayMask changed;
+    RelayMask state;        // all relays after this commit
+};
+
+// Returns a subscriber id, or -1 when EVENT_BUS_MAX_SUBS are taken. If
+// notify is given, that task gets xTaskNotifyGive() on every event.
+int eventBusSubscribe(const char *name, TaskHandle_t notify = nullptr);
+
+// Output path: fan an event out to every subscriber. Never blocks.
+void eventBusPublish(RelayMask changed, RelayMask state);
+
+// Consumer side: next event for this subscriber, false when empty.
+bool eventBusPoll(int sub, RelayEvent &out);
+
+// {"seq":N,"state":"0110..."}, one character per relay, as pushed to the
+// UI and MQTT. Returns the length.
+size_t eventBusFormat(const RelayEvent &ev, char *buf, size_t len);
+#define EVENT_FORMAT_LEN      (32 + NUM_RELAYS)
+
+// Per-subscriber delivered / dropped / queued.
+void eventBusPrintMetrics(Print &out);
@@ -0,0 +1,149 @@
+#include "frame_ack.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncUDP.h>
+
+#include "main_config.h"
+#include "remote_log.h"
+
+static const char *const MODE_NAMES[FRAME_ACK_MODE_COUNT] = { "off", "sender", "collector" };
+
+struct AckBatch {
+    uint32_t dest;          // IPv4 the batch goes to
+    uint32_t firstMs;       // millis() of the first sample
+    uint8_t  count;
+    uint8_t  data[FRAME_ACK_BATCH * FRAME_ACK_SAMPLE_LEN];
+};
+
+static AsyncUDP          ackUDP;
+static portMUX_TYPE      g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// The packet task fills g_batch[g_fill]; loop() swaps and sends the other.
+static AckBatch          g_batch[2];
+static uint8_t           g_fill      = 0;
+static uint32_t          g_dropped   = 0;   // since the last datagram
+
+static volatile uint8_t  g_mode      = FRAME_ACK_OFF;
+static volatile uint8_t  g_every     = 1;
+static volatile uint32_t g_collector = 0;
+static uint8_t           g_skip      = 0;   // packet task only
+
+static uint32_t          g_samples   = 0;
+static uint32_t          g_sent      = 0;
+static uint32_t          g_droppedTotal = 0;
+
+const char *frameAckModeName(uint8_t mode)
+{
+    return mode < FRAME_ACK_MODE_COUNT ? MODE_NAMES[mode] : nullptr;
+}
+
+int frameAckModeFromName(const char *name)
+{
+    for (uint8_t i = 0; i < FRAME_ACK_MODE_COUNT; i++) {
+        if (strcasecmp(name, MODE_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static inline void putLe16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void putLe32(uint8_t *p, uint32_t v)
+{
+    putLe16(p, v & 0xFFFF);
+    putLe16(p + 2, v >> 16);
+}
+
+void frameAckReconfigure()
+{
+    IPAddress collector;
+    uint32_t  ip = 0;
+    if (cfg.ackHost[0]) {
+        if (collector.fromString(cfg.ackHost)) ip = (uint32_t)collector;
+        else LOGW("[ACK] collector '%s' is not an IPv4 address", cfg.ackHost);
+    }
+
+    g_collector = ip;
+    g_every     = cfg.ackEvery ? cfg.ackEvery : 1;
+    g_mode      = (cfg.ackMode == FRAME_ACK_COLLECTOR && !ip) ? (uint8_t)FRAME_ACK_OFF : cfg.ackMode;
+    LOGI("[ACK] frame acks: %s, 1 in %u frames", frameAckModeName(g_mode), g_every);
+}
+
+void frameAckNote(uint8_t proto, uint8_t seq, uint32_t srcIp,
+                  uint32_t rxMicros, uint32_t commitMicros)
+{
+    uint8_t mode = g_mode;
+    if (mode == FRAME_ACK_OFF) return;
+    if (++g_skip < g_every) return;
+    g_skip = 0;
+
+    uint32_t dest = (mode == FRAME_ACK_SENDER) ? srcIp : g_collector;
+
+    portENTER_CRITICAL(&g_mux);
+    AckBatch &b = g_batch[g_fill];
+    if (b.count == 0) {
+        b.dest    = dest;
+        b.firstMs = millis();
+    }
+    if (b.count < FRAME_ACK_BATCH && b.dest == dest) {
+        uint8_t *p = b.data + b.count * FRAME_ACK_SAMPLE_LEN;
+        p[0] = proto;
+        p[1] = seq;
+        putLe16(p + 2, 0);
+        putLe32(p + 4, rxMicros);
+        putLe32(p + 8, commitMicros);
+        b.count++;
+        g_samples++;
+    } else {
+        g_dropped++;        // loop() is behind, or a second sender
+    }
+    portEXIT_CRITICAL(&g_mux);
+}
+
+void frameAckTick()
+{
+    uint8_t  out;
+    uint32_t dropped;
+
+    portENTER_CRITICAL(&g_mux);
+    const AckBatch &cur = g_batch[g_fill];
+    if (cur.count == 0 ||
+        (cur.count < FRAME_ACK_BATCH && millis() - cur.firstMs < FRAME_ACK_FLUSH_MS)) {
+        portEXIT_CRITICAL(&g_mux);
+        return;
+    }
+    out     = g_fill;
+    g_fill ^= 1;
+    g_batch[g_fill].count = 0;
+    dropped   = g_dropped;
+    g_dropped = 0;
+    portEXIT_CRITICAL(&g_mux);
+
+    const AckBatch &b = g_batch[out];
+    uint8_t pkt[FRAME_ACK_HEADER_LEN + sizeof(b.data)];
+    memcpy(pkt, "RACK", 4);
+    pkt[4] = FRAME_ACK_VERSION;
+    pkt[5] = b.count;
+    putLe16(pkt + 6, 0);
+    putLe32(pkt + 8, micros());
+    putLe32(pkt + 12, dropped);
+    memcpy(pkt + FRAME_ACK_HEADER_LEN, b.data, b.count * FRAME_ACK_SAMPLE_LEN);
+
+    size_t len = FRAME_ACK_HEADER_LEN + b.count * FRAME_ACK_SAMPLE_LEN;
+    if (WiFi.isConnected() && ackUDP.writeTo(pkt, len, IPAddress(b.dest), FRAME_ACK_PORT)) {
+        g_sent++;
+    }
+    g_droppedTotal += dropped;
+}
+
+void frameAckPrintMetrics(Print &out)
+{
+    out.printf("relay_frame_ack_mode %u\n", (unsigned)g_mode);
+    out.printf("relay_frame_ack_samples_total %u\n", (unsigned)g_samples);
+    out.printf("relay_frame_ack_datagrams_total %u\n", (unsigned)g_sent);
+    out.printf("relay_frame_ack_dropped_total %u\n", (unsigned)g_droppedTotal);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// ---------- FRAME ACKS ----------
+//
+// Optional feedback for sender-side latency calibration: for every Nth
+// committed frame (cfg.ackEvery) we note the protocol sequence number,
+// when the socket callback saw it and when the relays were committed.
+// Samples are batched and sent as one UDP datagram to FRAME_ACK_PORT,
+// either back to the sender of the frames or to a fixed collector
+// (cfg.ackHost). tools/latency_calib.cpp drives a controller with Art-Net
+// and turns the acks into per-controller offset and jitter.
+//
+// Datagram (little endian):
+//   0  "RACK"
+//   4  u8  version (1)
+//   5  u8  sample count
+//   6  u16 reserved
+//   8  u32 micros() when the datagram was sent
+//  12  u32 samples dropped since the previous datagram
+//  16  samples, FRAME_ACK_SAMPLE_LEN each:
+//        u8 proto (ProtoId), u8 seq, u16 reserved,
+//        u32 receive micros(), u32 commit micros()
+//
+// The packet task only appends to a batch; loop() sends it (frameAckTick).
+//
+
+#define FRAME_ACK_PORT        5570
+#define FRAME_ACK_VERSION     1
+#define FRAME_ACK_HEADER_LEN  16
+#define FRAME_ACK_SAMPLE_LEN  12
+#define FRAME_ACK_BATCH       8           // samples per datagram
+#define FRAME_ACK_FLUSH_MS    250         // send a partial batch this old
+
+// cfg.ackMode
+enum FrameAckMode : uint8_t {
+    FRAME_ACK_OFF       = 0,
+    FRAME_ACK_SENDER    = 1,    // back to whoever sent the frames
+    FRAME_ACK_COLLECTOR = 2,    // to cfg.ackHost
+    FRAME_ACK_MODE_COUNT
+};
+
+const char *frameAckModeName(uint8_t mode);
+int frameAckModeFromName(const char *name);
+
+// Ack settings in cfg changed (mode, collector, sampling).
+void frameAckReconfigure();
+
+// Packet task, after commitRelays(): the newest frame of the batch.
+void frameAckNote(uint8_t proto, uint8_t seq, uint32_t srcIp,
+                  uint32_t rxMicros, uint32_t commitMicros);
+
+// loop(): send a full or aged batch.
+void frameAckTick();
+
+void frameAckPrintMetrics(Print &out);
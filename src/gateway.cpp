@@ -0,0 +1,169 @@
+#include "gateway.h"
+#if RELAY_GATEWAY
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncUDP.h>
+
+#include "main_config.h"
+#include "protocol.h"
+#include "remote_log.h"
+
+#define GW_E131_UNIVERSES     16          // universes filtered at once
+#define GW_E131_LOSS_MS       2500        // E1.31 network data loss timeout
+#define GW_E131_SEQ_WINDOW    20          // reorders discarded (E1.31 6.7.2)
+
+// Which source owns a forwarded universe, and its last sequence number.
+struct GwUniverse {
+    uint16_t universe;      // 0 = free
+    uint8_t  cid[16];
+    uint8_t  priority;
+    uint8_t  seq;
+    uint32_t lastMs;
+};
+
+// Owned by the UDP receive task (DDP and E1.31 callbacks share it).
+static GatewayRouter g_router;
+static uint8_t       g_arena[GATEWAY_ARENA_LEN];
+static AsyncUDP      gwUDP;
+
+// A new table from the web task, adopted by the receive side.
+static GatewayTable  g_pending;
+static volatile bool g_pendingSet = false;
+static portMUX_TYPE  g_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile uint16_t g_universe     = 1;
+static volatile uint16_t g_universeSize = 510;
+static uint32_t          g_ingested     = 0;
+
+static GwUniverse g_owners[GW_E131_UNIVERSES];      // receive task only
+static uint32_t   g_e131Stale  = 0;                 // reordered / duplicate
+static uint32_t   g_e131Losing = 0;                 // not the owning source
+
+static bool sendPacket(uint32_t ip, const uint8_t *pkt, size_t len, void *)
+{
+    return gwUDP.writeTo(pkt, len, IPAddress(ip), DDP_PORT) == len;
+}
+
+void gatewayReconfigure()
+{
+    static GatewayTable t;          // web handlers run one at a time
+    char err[64];
+    if (!gatewayParseRoutes(cfg.gwRoutes, t, err, sizeof(err))) {
+        LOGW("[GW] routes rejected (%s), gateway off", err);   // validated on save; stale NVS
+    }
+
+    portENTER_CRITICAL(&g_mux);
+    g_pending      = t;
+    g_pendingSet   = true;
+    g_universe     = cfg.gwUniverse;
+    g_universeSize = cfg.gwUniverseSize;
+    portEXIT_CRITICAL(&g_mux);
+
+    if (t.count) {
+        LOGI("[GW] %u routes, %u channels, E1.31 from universe %u x %u",
+             t.count, (unsigned)t.channels, cfg.gwUniverse, cfg.gwUniverseSize);
+    }
+}
+
+static inline bool adoptPending()
+{
+    if (g_pendingSet) {
+        static GatewayTable t;
+        portENTER_CRITICAL(&g_mux);
+        t = g_pending;
+        g_pendingSet = false;
+        portEXIT_CRITICAL(&g_mux);
+
+        g_router.arena = g_arena;
+        g_router.send  = sendPacket;
+        gatewayRouterLoad(g_router, t);
+    }
+    return g_router.table.count != 0;
+}
+
+void gatewayIngest(uint32_t first, const uint8_t *data, uint32_t len)
+{
+    if (!adoptPending()) return;
+    g_ingested++;
+    gatewayRouterIngest(g_router, first, data, len);
+}
+
+void gatewayPush()
+{
+    if (adoptPending()) gatewayRouterPush(g_router);
+}
+
+// The universe's entry, else a free or quiet one, else the longest quiet.
+static GwUniverse &ownerOf(uint16_t universe, uint32_t now)
+{
+    GwUniverse *spare = &g_owners[0];
+    for (GwUniverse &u : g_owners) {
+        if (u.universe == universe) return u;
+        if (!u.universe || now - u.lastMs > GW_E131_LOSS_MS) spare = &u;
+        else if (spare->universe && now - u.lastMs > now - spare->lastMs) spare = &u;
+    }
+    spare->universe = universe;
+    spare->lastMs   = 0;
+    return *spare;
+}
+
+static bool acceptSource(uint16_t universe, const uint8_t *cid, uint8_t seq, uint8_t priority)
+{
+    uint32_t    now = millis();
+    GwUniverse &u   = ownerOf(universe, now);
+    bool live = u.lastMs && now - u.lastMs <= GW_E131_LOSS_MS;
+
+    if (live && memcmp(u.cid, cid, sizeof(u.cid)) == 0) {
+        int8_t diff = (int8_t)(seq - u.seq);
+        if (diff <= 0 && diff > -GW_E131_SEQ_WINDOW) {
+            g_e131Stale++;
+            return false;
+        }
+    } else if (live && priority <= u.priority) {
+        g_e131Losing++;
+        return false;
+    } else {
+        memcpy(u.cid, cid, sizeof(u.cid));
+    }
+    u.priority = priority;
+    u.seq      = seq;
+    u.lastMs   = now ? now : 1;
+    return true;
+}
+
+void gatewayIngestUniverse(uint16_t universe, const uint8_t *cid, uint8_t seq,
+                           uint8_t priority, const uint8_t *slots, uint32_t len)
+{
+    uint16_t base = g_universe, size = g_universeSize;
+    if (universe < base || !adoptPending()) return;
+    if (!acceptSource(universe, cid, seq, priority)) return;
+    if (len > size) len = size;
+    gatewayIngest((uint32_t)(universe - base) * size, slots, len);
+}
+
+void gatewayEndUniverse(uint16_t universe, const uint8_t *cid)
+{
+    for (GwUniverse &u : g_owners) {
+        if (u.universe == universe && memcmp(u.cid, cid, sizeof(u.cid)) == 0) u.lastMs = 0;
+    }
+}
+
+void gatewayPrintMetrics(Print &out)
+{
+    out.printf("relay_gateway_ingested_total %u\n", (unsigned)g_ingested);
+    out.printf("relay_gateway_e131_dropped_total{reason=\"stale\"} %u\n", (unsigned)g_e131Stale);
+    out.printf("relay_gateway_e131_dropped_total{reason=\"source\"} %u\n", (unsigned)g_e131Losing);
+    for (uint8_t i = 0; i < g_router.table.count; i++) {
+        const GatewayRouteStats &st = g_router.stats[i];
+        IPAddress ip(g_router.table.routes[i].ip);
+        char label[40];
+        snprintf(label, sizeof(label), "{route=\"%u\",dest=\"%s\"}", i, ip.toString().c_str());
+        out.printf("relay_gateway_packets_total%s %u\n", label, (unsigned)st.packets);
+        out.printf("relay_gateway_bytes_total%s %u\n", label, (unsigned)st.bytes);
+        out.printf("relay_gateway_partial_total%s %u\n", label, (unsigned)st.partial);
+        out.printf("relay_gateway_errors_total%s %u\n", label, (unsigned)st.errors);
+    }
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+
+#include "gateway_router.h"
+
+class Print;
+
+// ---------- FAN-OUT GATEWAY ----------
+//
+// For large WiFi rigs: the sender unicasts one big DDP or E1.31 stream to
+// this controller, which slices out each downstream node's window
+// (cfg.gwRoutes, syntax in gateway_router.h) and forwards it as one
+// unicast DDP packet per node and frame. E1.31 universes map onto the
+// channel space as (universe - cfg.gwUniverse) * cfg.gwUniverseSize.
+//
+// Forwarding runs in the UDP receive callbacks, next to (not through) our
+// own relay path, after the packet's own frame (if any) is stamped and
+// queued; this controller's patch still drives its own relays. E1.31 is
+// filtered per universe like our own input: reordered or duplicate
+// packets are dropped and one source (the highest priority, first come
+// on a tie, until it goes quiet or terminates) owns each universe.
+// Send the stream unicast: only the patched universe's multicast group is
+// joined. Empty routes = off.
+//
+// -DRELAY_GATEWAY=0 drops the gateway code and its buffers.
+//
+
+#ifndef RELAY_GATEWAY
+#define RELAY_GATEWAY         1
+#endif
+
+#if RELAY_GATEWAY
+
+// Route settings in cfg changed (any task); the receive side picks the new
+// table up before its next packet.
+void gatewayReconfigure();
+
+// UDP callbacks: channels [first, first+len) of the incoming stream, and
+// the frame boundary (DDP push).
+void gatewayIngest(uint32_t first, const uint8_t *data, uint32_t len);
+void gatewayPush();
+
+// E1.31: slots 1..len of a universe from source cid (16 bytes), dropped
+// unless that source owns the universe and seq is not stale.
+// gatewayEndUniverse(): the source sent a terminated packet.
+void gatewayIngestUniverse(uint16_t universe, const uint8_t *cid, uint8_t seq,
+                           uint8_t priority, const uint8_t *slots, uint32_t len);
+void gatewayEndUniverse(uint16_t universe, const uint8_t *cid);
+
+// Per-route packets / bytes / partial frames / errors, E1.31 drops.
+void gatewayPrintMetrics(Print &out);
+
+#endif
@@ -0,0 +1,174 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gateway_router.h"
+
+#define DDP_FLAGS_VER1_PUSH   0x41
+#define DDP_ID_DISPLAY        1
+
+// ---------- PARSER ----------
+
+static void skipSpace(const char *&p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+}
+
+static bool number(const char *&p, uint32_t &out)
+{
+    if (!isdigit((unsigned char)*p)) return false;
+    char *end;
+    out = strtoul(p, &end, 10);
+    p = end;
+    return true;
+}
+
+static bool ipv4(const char *&p, uint32_t &out)
+{
+    out = 0;
+    for (int i = 0; i < 4; i++) {
+        uint32_t octet;
+        if (i && *p++ != '.') return false;
+        if (!number(p, octet) || octet > 255) return false;
+        out |= octet << (8 * i);    // first octet in the lowest byte
+    }
+    return true;
+}
+
+static bool route(const char *&p, GatewayRoute &rt, const char *&why)
+{
+    uint32_t first, last, offset = 0;
+
+    if (!ipv4(p, rt.ip)) { why = "bad IPv4 address"; return false; }
+    skipSpace(p);
+    if (!number(p, first) || first < 1) { why = "bad first channel"; return false; }
+    if (*p == '-') {
+        p++;
+        if (!number(p, last) || last < first) { why = "bad last channel"; return false; }
+    } else if (*p == '+') {
+        p++;
+        if (!number(p, last) || last < 1) { why = "bad channel count"; return false; }
+        last = first + last - 1;
+    } else {
+        why = "expected first-last or first+count";
+        return false;
+    }
+    skipSpace(p);
+    if (*p == '@') {
+        p++;
+        if (!number(p, offset)) { why = "bad @offset"; return false; }
+    }
+
+    if (last - first + 1 > GATEWAY_ROUTE_MAX) { why = "more than 1440 channels"; return false; }
+    rt.first      = first - 1;
+    rt.count      = (uint16_t)(last - first + 1);
+    rt.destOffset = offset;
+    return true;
+}
+
+bool gatewayParseRoutes(const char *text, GatewayTable &out, char *err, size_t errLen)
+{
+    memset(&out, 0, sizeof(out));
+    if (err && errLen) err[0] = '\0';
+    if (!text) return true;
+
+    const char *p = text;
+    for (unsigned n = 1; ; n++) {
+        while (*p == ';' || *p == '\n' || isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+
+        const char  *why = nullptr;
+        GatewayRoute rt;
+        if (out.count >= GATEWAY_MAX_ROUTES) why = "too many routes";
+        else if (route(p, rt, why)) {
+            skipSpace(p);
+            if (*p && *p != ';' && *p != '\n') why = "unexpected text";
+            else if (out.channels + rt.count > GATEWAY_MAX_CHANNELS) why = "routes exceed GATEWAY_MAX_CHANNELS";
+        }
+        if (why) {
+            if (err) snprintf(err, errLen, "route %u: %s", n, why);
+            memset(&out, 0, sizeof(out));
+            return false;
+        }
+        out.routes[out.count++] = rt;
+        out.channels += rt.count;
+    }
+    return true;
+}
+
+// ---------- FORWARDING ----------
+
+void gatewayRouterLoad(GatewayRouter &r, const GatewayTable &t)
+{
+    r.table = t;
+    memset(r.state, 0, sizeof(r.state));
+    memset(r.stats, 0, sizeof(r.stats));
+
+    uint32_t at = 0;
+    for (uint8_t i = 0; i < t.count; i++) {
+        const GatewayRoute &rt  = t.routes[i];
+        uint8_t            *pkt = r.arena + at;
+        memset(pkt, 0, GATEWAY_DDP_HEADER + rt.count);
+        pkt[0] = DDP_FLAGS_VER1_PUSH;
+        pkt[3] = DDP_ID_DISPLAY;
+        pkt[4] = rt.destOffset >> 24;
+        pkt[5] = rt.destOffset >> 16;
+        pkt[6] = rt.destOffset >> 8;
+        pkt[7] = rt.destOffset;
+        pkt[8] = rt.count >> 8;
+        pkt[9] = rt.count & 0xFF;
+
+        r.state[i].image = at;
+        at += GATEWAY_DDP_HEADER + rt.count;
+    }
+}
+
+static void sendRoute(GatewayRouter &r, uint8_t i)
+{
+    GatewayRouteState  &st  = r.state[i];
+    GatewayRouteStats  &sts = r.stats[i];
+    const GatewayRoute &rt  = r.table.routes[i];
+    uint8_t            *pkt = r.arena + st.image;
+
+    st.seq = st.seq >= 15 ? 1 : st.seq + 1;
+    pkt[1] = st.seq;
+    if (r.send(rt.ip, pkt, GATEWAY_DDP_HEADER + rt.count, r.ctx)) {
+        sts.packets++;
+        sts.bytes += rt.count;
+    } else {
+        sts.errors++;
+    }
+    if (st.filled < rt.count) sts.partial++;
+    st.pending = false;
+    st.filled  = 0;
+    st.lastEnd = 0;
+}
+
+void gatewayRouterIngest(GatewayRouter &r, uint32_t first, const uint8_t *data, uint32_t len)
+{
+    uint32_t end = first + len;
+
+    for (uint8_t i = 0; i < r.table.count; i++) {
+        const GatewayRoute &rt = r.table.routes[i];
+        uint32_t lo = first > rt.first ? first : rt.first;
+        uint32_t hi = end < rt.first + rt.count ? end : rt.first + rt.count;
+        if (lo >= hi) continue;
+
+        GatewayRouteState &st = r.state[i];
+        if (st.pending && lo < st.lastEnd) sendRoute(r, i);    // next frame began
+
+        memcpy(r.arena + st.image + GATEWAY_DDP_HEADER + (lo - rt.first), data + (lo - first), hi - lo);
+        st.filled += hi - lo;
+        st.lastEnd = hi;
+        st.pending = true;
+        if (hi == rt.first + rt.count) sendRoute(r, i);         // window complete
+    }
+}
+
+void gatewayRouterPush(GatewayRouter &r)
+{
+    for (uint8_t i = 0; i < r.table.count; i++) {
+        if (r.state[i].pending) sendRoute(r, i);
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// ---------- GATEWAY ROUTER ----------
+//
+// Platform-free core of the fan-out gateway (gateway.h), so the same code
+// runs on the controller and in tools/gateway_loopback.cpp.
+//
+// A routing table maps windows of the incoming channel space (DDP offset,
+// or E1.31 universes laid end to end) to downstream nodes. Every route
+// owns the image of one outgoing DDP packet in the arena; incoming slices
+// are copied straight from the receive payload into those images, and a
+// route is sent once its last channel has arrived, so a node spanning
+// several incoming packets still gets one packet per frame. A slice that
+// goes backwards (next frame) or a DDP push flushes what is pending.
+//
+// Routes, one per ';' or line; channels 1-based in the incoming stream,
+// "@offset" = DDP offset at the node (default 0 = its channel 1):
+//
+//   10.0.0.21 1-510; 10.0.0.22 511+510; 10.0.0.23 1021+64 @128
+//
+
+#define GATEWAY_MAX_ROUTES    40
+#ifndef GATEWAY_MAX_CHANNELS
+#define GATEWAY_MAX_CHANNELS  4096        // sum of all route windows
+#endif
+#define GATEWAY_ROUTE_MAX     1440        // channels per route (one DDP packet)
+#define GATEWAY_DDP_HEADER    10
+#define GATEWAY_ARENA_LEN     (GATEWAY_MAX_CHANNELS + GATEWAY_MAX_ROUTES * GATEWAY_DDP_HEADER)
+#define GATEWAY_ROUTES_MAX    1024        // route text incl. NUL
+
+struct GatewayRoute {
+    uint32_t ip;            // IPv4 as lwIP / in_addr store it (network order)
+    uint32_t first;         // 0-based channel in the incoming stream
+    uint16_t count;
+    uint32_t destOffset;    // DDP offset at the node
+};
+
+struct GatewayTable {
+    uint8_t      count;
+    uint32_t     channels;  // sum of route counts
+    GatewayRoute routes[GATEWAY_MAX_ROUTES];
+};
+
+struct GatewayRouteStats {
+    uint32_t packets;       // DDP packets sent
+    uint32_t bytes;         // channel bytes sent
+    uint32_t partial;       // sent before every channel of the frame arrived
+    uint32_t errors;        // send failed
+};
+
+struct GatewayRouteState {
+    uint32_t image;         // packet image offset in the arena
+    uint32_t lastEnd;       // end of the newest slice this frame
+    uint16_t filled;        // channels copied this frame
+    bool     pending;
+    uint8_t  seq;           // DDP sequence, 1..15
+};
+
+// Sends one finished packet; false = failed.
+typedef bool (*GatewaySendFn)(uint32_t ip, const uint8_t *pkt, size_t len, void *ctx);
+
+struct GatewayRouter {
+    GatewayTable      table;
+    GatewayRouteState state[GATEWAY_MAX_ROUTES];
+    GatewayRouteStats stats[GATEWAY_MAX_ROUTES];
+    uint8_t          *arena;        // GATEWAY_ARENA_LEN bytes
+    GatewaySendFn     send;
+    void             *ctx;
+};
+
+// Parse route text. On error out is empty and err says where.
+bool gatewayParseRoutes(const char *text, GatewayTable &out, char *err, size_t errLen);
+
+// Adopt a table: lays out the packet images, clears state and stats.
+void gatewayRouterLoad(GatewayRouter &r, const GatewayTable &t);
+
+// Channels [first, first+len) of the incoming stream arrived.
+void gatewayRouterIngest(GatewayRouter &r, uint32_t first, const uint8_t *data, uint32_t len);
+
+// Frame boundary (DDP push): send every route with pending data.
+void gatewayRouterPush(GatewayRouter &r);
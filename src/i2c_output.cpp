@@ -0,0 +1,199 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_PWMServoDriver.h>
+#include <freertos/semphr.h>
+
+#include "i2c_output.h"
+#include "remote_log.h"
+
+#define PCA9685_LED0_ON       0x06        // LEDn_ON_L = 0x06 + 4n
+#define PCA9685_FULL_BIT      0x10        // bit 4 of LEDn_ON_H / LEDn_OFF_H
+#define I2C_FLUSH_TIMEOUT_MS  20
+
+#define I2C_ACTIVE_BUSES      (RELAY_BOARDS < I2C_BUSES ? RELAY_BOARDS : I2C_BUSES)
+
+static_assert(I2C_BUSES == 1 || I2C_BUSES == 2, "the ESP32 has two I2C controllers");
+
+struct BoardState {
+    uint8_t  bus;
+    uint8_t  addr;
+    bool     present;
+    uint16_t on;            // wanted state per channel
+    uint16_t dirty;         // channels to write on the next flush
+};
+
+struct BusStats {
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t errors;        // NACK / timeout from endTransmission()
+    uint64_t busyUs;        // time spent inside transactions
+};
+
+static TwoWire *const g_wire[2] = { &Wire, &Wire1 };
+
+static BoardState g_boards[RELAY_BOARDS];
+static BusStats   g_busStats[2];
+
+// Bus 1 writes from its own copy of its boards, handed over by the flush,
+// so staging the next commit never races the worker. g_bus1Busy (flush
+// side only) is set per hand-over and cleared per g_bus1Done taken, which
+// keeps notify and give paired even after a timeout.
+static BoardState        g_bus1Work[RELAY_BOARDS];
+static TaskHandle_t      g_bus1Task = nullptr;
+static SemaphoreHandle_t g_bus1Done = nullptr;
+static bool              g_bus1Busy = false;
+
+static uint32_t g_flushes       = 0;
+static uint64_t g_flushUs       = 0;
+static uint32_t g_flushMaxUs    = 0;
+static uint32_t g_flushTimeouts = 0;
+static uint32_t g_flushDeferred = 0;     // bus 1 still busy, boards left dirty
+
+// One auto-increment write per changed board, spanning lowest..highest
+// dirty channel (unchanged channels in between are rewritten as they are).
+static void flushBus(uint8_t bus, BoardState *boards)
+{
+    TwoWire  &wire = *g_wire[bus];
+    BusStats &st   = g_busStats[bus];
+
+    for (uint8_t b = bus; b < RELAY_BOARDS; b += I2C_BUSES) {
+        BoardState &bd = boards[b];
+        if (!bd.dirty) continue;
+
+        uint8_t lo = __builtin_ctz(bd.dirty);
+        uint8_t hi = 31 - __builtin_clz(bd.dirty);
+        bd.dirty = 0;
+
+        uint32_t t0 = micros();
+        wire.beginTransmission(bd.addr);
+        wire.write(PCA9685_LED0_ON + 4 * lo);
+        for (uint8_t ch = lo; ch <= hi; ch++) {
+            bool on = bd.on & (1u << ch);
+            uint8_t regs[4] = { 0, (uint8_t)(on ? PCA9685_FULL_BIT : 0),
+                                0, (uint8_t)(on ? 0 : PCA9685_FULL_BIT) };
+            wire.write(regs, sizeof(regs));
+        }
+        if (wire.endTransmission() != 0) st.errors++;
+        st.busyUs += micros() - t0;
+        st.transactions++;
+        st.bytes += 2 + 4 * (hi - lo + 1);      // address + register + data
+    }
+}
+
+static void bus1Task(void *)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        flushBus(1, g_bus1Work);
+        xSemaphoreGive(g_bus1Done);
+    }
+}
+
+void i2cOutputStage(uint16_t output, bool on)
+{
+    if (output >= OUTPUT_COUNT) return;
+    BoardState &bd  = g_boards[output / PCA9685_OUTPUTS];
+    uint16_t    bit = 1u << (output % PCA9685_OUTPUTS);
+
+    if (on) bd.on |= bit;
+    else    bd.on &= ~bit;
+    bd.dirty |= bit;
+}
+
+void i2cOutputFlush()
+{
+    uint32_t t0 = micros();
+
+    // A bus 1 write that timed out last time must finish before its copy
+    // can be reused; until then its boards stay dirty here.
+    if (g_bus1Busy && xSemaphoreTake(g_bus1Done, pdMS_TO_TICKS(I2C_FLUSH_TIMEOUT_MS)) == pdTRUE) {
+        g_bus1Busy = false;
+    }
+
+    bool remote = false;
+    if (g_bus1Task && !g_bus1Busy) {
+        for (uint8_t b = 1; b < RELAY_BOARDS; b += I2C_BUSES) {
+            g_bus1Work[b]     = g_boards[b];
+            g_boards[b].dirty = 0;
+            remote           |= g_bus1Work[b].dirty != 0;
+        }
+        if (remote) {
+            g_bus1Busy = true;
+            xTaskNotifyGive(g_bus1Task);
+        }
+    } else if (g_bus1Task) {
+        g_flushDeferred++;
+    }
+
+    flushBus(0, g_boards);
+
+    if (remote) {
+        if (xSemaphoreTake(g_bus1Done, pdMS_TO_TICKS(I2C_FLUSH_TIMEOUT_MS)) == pdTRUE) {
+            g_bus1Busy = false;
+        } else {
+            g_flushTimeouts++;
+        }
+    }
+
+    uint32_t us = micros() - t0;
+    g_flushes++;
+    g_flushUs += us;
+    if (us > g_flushMaxUs) g_flushMaxUs = us;
+}
+
+void startI2cOutput()
+{
+    Wire.begin();
+    Wire.setClock(I2C_CLOCK_HZ);
+    if (I2C_ACTIVE_BUSES > 1) {
+        Wire1.begin(I2C1_SDA, I2C1_SCL, I2C_CLOCK_HZ);
+    }
+
+    for (uint8_t b = 0; b < RELAY_BOARDS; b++) {
+        BoardState &bd = g_boards[b];
+        bd.bus  = b % I2C_BUSES;
+        bd.addr = PCA9685_BASE_ADDR + b / I2C_BUSES;
+
+        TwoWire &wire = *g_wire[bd.bus];
+        wire.beginTransmission(bd.addr);
+        bd.present = wire.endTransmission() == 0;
+        if (!bd.present) {
+            LOGW("[I2C] board %u (bus %u, 0x%02X) not responding", b, bd.bus, bd.addr);
+            continue;
+        }
+
+        // The library only sets the chip up (oscillator, prescaler, MODE1
+        // auto-increment); output writes are batched in flushBus().
+        Adafruit_PWMServoDriver drv(bd.addr, wire);
+        drv.begin();
+        drv.setOscillatorFrequency(27000000);
+        drv.setPWMFreq(1000);  // Fast enough for SSR on/off
+    }
+
+    if (I2C_ACTIVE_BUSES > 1) {
+        g_bus1Done = xSemaphoreCreateBinary();
+        xTaskCreatePinnedToCore(bus1Task, "i2c1", 2048, nullptr, 3, &g_bus1Task, 0);
+    }
+
+    LOGI("[I2C] %u board(s) on %u bus(es), %u outputs",
+         RELAY_BOARDS, I2C_ACTIVE_BUSES, OUTPUT_COUNT);
+}
+
+void i2cOutputPrintMetrics(Print &out)
+{
+    for (uint8_t bus = 0; bus < I2C_ACTIVE_BUSES; bus++) {
+        const BusStats &st = g_busStats[bus];
+        out.printf("relay_i2c_transactions_total{bus=\"%u\"} %u\n", bus, (unsigned)st.transactions);
+        out.printf("relay_i2c_bytes_total{bus=\"%u\"} %u\n", bus, (unsigned)st.bytes);
+        out.printf("relay_i2c_errors_total{bus=\"%u\"} %u\n", bus, (unsigned)st.errors);
+        out.printf("relay_i2c_busy_us_total{bus=\"%u\"} %llu\n", bus, (unsigned long long)st.busyUs);
+    }
+    for (uint8_t b = 0; b < RELAY_BOARDS; b++) {
+        out.printf("relay_i2c_board_present{board=\"%u\"} %u\n", b, g_boards[b].present);
+    }
+    out.printf("relay_i2c_flush_total %u\n", (unsigned)g_flushes);
+    out.printf("relay_i2c_flush_us_total %llu\n", (unsigned long long)g_flushUs);
+    out.printf("relay_i2c_flush_max_us %u\n", (unsigned)g_flushMaxUs);
+    out.printf("relay_i2c_flush_timeouts_total %u\n", (unsigned)g_flushTimeouts);
+    out.printf("relay_i2c_flush_deferred_total %u\n", (unsigned)g_flushDeferred);
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <stdint.h>
+
+#include "main_config.h"
+
+class Print;
+
+// ---------- PCA9685 OUTPUT STAGE ----------
+//
+// Boards are spread over both ESP32 I2C controllers: board b sits on bus
+// b % I2C_BUSES at address PCA9685_BASE_ADDR + b / I2C_BUSES, so boards
+// 0, 2, 4... share Wire and 1, 3, 5... share Wire1. A flush writes every
+// changed board with one auto-increment transaction and runs the two
+// buses concurrently (bus 1 from a worker task), so commit time is that
+// of the busier bus rather than the sum.
+//
+// Capacity is 64 relays (four boards): RelayMask is 64 bits and relay
+// indices are uint8_t, main_config.h asserts the limit. Wire time at
+// 400 kHz is 22.5 us a byte, so a board with all 16 outputs changed is
+// one 66-byte write, about 1.5 ms. 64 relays all changing: ~3.0 ms (two
+// boards per bus, buses in parallel) against ~8.6 ms for the old one
+// 6-byte write per relay on one bus. These are bus-time estimates; the
+// real figure on a device is relay_i2c_flush_max_us.
+//
+
+#ifndef RELAY_BOARDS
+#define RELAY_BOARDS          ((RELAY_COUNT + PCA9685_OUTPUTS - 1) / PCA9685_OUTPUTS)
+#endif
+#ifndef I2C_BUSES
+#define I2C_BUSES             2           // 1 = everything on Wire
+#endif
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ          400000
+#endif
+#ifndef I2C1_SDA
+#define I2C1_SDA              33          // Wire keeps the default 21/22
+#endif
+#ifndef I2C1_SCL
+#define I2C1_SCL              32
+#endif
+
+#define PCA9685_OUTPUTS       16
+#define PCA9685_BASE_ADDR     0x40
+#define OUTPUT_COUNT          (RELAY_BOARDS * PCA9685_OUTPUTS)
+
+// Probe and configure every board.
+void startI2cOutput();
+
+// Record the wanted state of one output (board * 16 + channel). Nothing
+// goes on the wire until i2cOutputFlush().
+void i2cOutputStage(uint16_t output, bool on);
+
+// Write every changed board, both buses at once; returns when both are done.
+void i2cOutputFlush();
+
+// Per-bus transactions / bytes / errors / busy time, flush time.
+void i2cOutputPrintMetrics(Print &out);
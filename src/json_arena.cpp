@@ -0,0 +1,125 @@
+#include <Arduino.h>
+#include <freertos/semphr.h>
+
+#include "json_arena.h"
+#include "mem_place.h"
+#include "packet_task.h"
+#include "remote_log.h"
+
+// Block header: payload size, keeps payloads 8-byte aligned.
+#define ARENA_HDR             8
+#define ARENA_ALIGN(n)        (((n) + 7) & ~(size_t)7)
+
+static JsonArena g_arena(nullptr, 0);      // empty until startJsonArena()
+
+static StaticSemaphore_t g_lockBuf;
+static SemaphoreHandle_t g_arenaLock = nullptr;
+static uint32_t          g_leases    = 0;
+static uint32_t          g_hotLeases = 0;     // from the packet task: a bug
+
+static inline uint32_t &blockSize(uint8_t *hdr)
+{
+    return *reinterpret_cast<uint32_t *>(hdr);
+}
+
+void *JsonArena::allocate(size_t size)
+{
+    size_t need = ARENA_ALIGN(size) + ARENA_HDR;
+    if (need > size_ - used_) {
+        failures_++;
+        return nullptr;             // ArduinoJson reports overflowed()
+    }
+
+    uint8_t *hdr = buf_ + used_;
+    blockSize(hdr) = ARENA_ALIGN(size);
+    last_  = used_;
+    used_ += need;
+    if (used_ > highWater_) highWater_ = used_;
+    return hdr + ARENA_HDR;
+}
+
+void JsonArena::deallocate(void *ptr)
+{
+    if (!ptr) return;
+    size_t off = (uint8_t *)ptr - buf_ - ARENA_HDR;
+    if (off == last_) {
+        used_ = last_;
+        last_ = SIZE_MAX;           // only one level of undo
+    }
+}
+
+void *JsonArena::reallocate(void *ptr, size_t newSize)
+{
+    if (!ptr) return allocate(newSize);
+
+    uint8_t *hdr = (uint8_t *)ptr - ARENA_HDR;
+    size_t   off = hdr - buf_;
+    size_t   cur = blockSize(hdr);
+
+    // Newest block: grow or shrink in place.
+    if (off == last_) {
+        size_t want = ARENA_ALIGN(newSize);
+        if (want > size_ - off - ARENA_HDR) {
+            failures_++;
+            return nullptr;
+        }
+        blockSize(hdr) = want;
+        used_ = off + ARENA_HDR + want;
+        if (used_ > highWater_) highWater_ = used_;
+        return ptr;
+    }
+
+    if (newSize <= cur) return ptr;
+
+    void *moved = allocate(newSize);
+    if (moved) memcpy(moved, ptr, cur);
+    return moved;
+}
+
+void JsonArena::reset()
+{
+    used_ = 0;
+    last_ = SIZE_MAX;
+}
+
+void startJsonArena()
+{
+    if (g_arenaLock) return;
+
+    // heap_caps_malloc() blocks are 8-byte aligned, as the headers need.
+    size_t size = 0;
+    void  *buf  = memPlace("json", JSON_ARENA_PLACE, JSON_ARENA_PSRAM_SIZE,
+                           JSON_ARENA_SIZE, &size);
+    g_arena.attach((uint8_t *)buf, size);
+    g_arenaLock = xSemaphoreCreateMutexStatic(&g_lockBuf);
+}
+
+JsonArenaScope::JsonArenaScope()
+{
+    if (packetTaskIsCurrent() && g_hotLeases++ == 0) {
+        LOGE("[JSON] arena borrowed on the packet task");
+    }
+    xSemaphoreTake(g_arenaLock, portMAX_DELAY);
+    g_arena.reset();
+    g_leases++;
+}
+
+JsonArenaScope::~JsonArenaScope()
+{
+    g_arena.reset();
+    xSemaphoreGive(g_arenaLock);
+}
+
+ArduinoJson::Allocator *JsonArenaScope::allocator()
+{
+    return &g_arena;
+}
+
+void jsonArenaPrintMetrics(Print &out)
+{
+    out.printf("relay_json_arena_capacity_bytes %u\n", (unsigned)g_arena.capacity());
+    out.printf("relay_json_arena_high_water_bytes %u\n", (unsigned)g_arena.highWater());
+    out.printf("relay_json_arena_failures_total %u\n", (unsigned)g_arena.failures());
+    out.printf("relay_json_arena_leases_total %u\n", (unsigned)g_leases);
+    out.printf("relay_json_arena_packet_task_leases_total %u\n", (unsigned)g_hotLeases);
+}
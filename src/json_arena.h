@@ -0,0 +1,78 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+class Print;
+
+// ---------- JSON ARENA ----------
+//
+// Every JsonDocument in the firmware allocates from one fixed bump arena
+// instead of the heap. A request borrows the arena with a JsonArenaScope,
+// which locks it and starts from empty; when the scope ends everything is
+// dropped at once. Freeing the most recent block (ArduinoJson shrinking a
+// string it just built) gives the space back; anything else is reclaimed
+// at the next reset.
+//
+//   JsonArenaScope arena;                  // declare before the document
+//   JsonDocument   doc(arena.allocator());
+//
+
+// Cold memory: in PSRAM at the larger size when the board has it (see
+// mem_place.h), otherwise JSON_ARENA_SIZE of internal SRAM. Never borrow
+// it from the packet task: the lock waits on web renders and the buffer
+// may be PSRAM. Doing so anyway is logged and counted.
+#ifndef JSON_ARENA_SIZE
+#define JSON_ARENA_SIZE       8192
+#endif
+#ifndef JSON_ARENA_PSRAM_SIZE
+#define JSON_ARENA_PSRAM_SIZE 32768
+#endif
+#ifndef JSON_ARENA_PLACE
+#define JSON_ARENA_PLACE      MEM_PREFER_PSRAM
+#endif
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+    JsonArena(uint8_t *buf, size_t size) : buf_(buf), size_(size) {}
+
+    // Hand the arena its buffer (once, before first use).
+    void attach(uint8_t *buf, size_t size) { buf_ = buf; size_ = size; reset(); }
+
+    void *allocate(size_t size) override;
+    void  deallocate(void *ptr) override;
+    void *reallocate(void *ptr, size_t newSize) override;
+
+    void   reset();
+    size_t used() const      { return used_; }
+    size_t capacity() const  { return size_; }
+    size_t highWater() const { return highWater_; }
+    uint32_t failures() const { return failures_; }
+
+private:
+    uint8_t *buf_;
+    size_t   size_;
+    size_t   used_      = 0;
+    size_t   last_      = SIZE_MAX;     // header offset of the newest block
+    size_t   highWater_ = 0;
+    uint32_t failures_  = 0;
+};
+
+// Place the buffer and create the arena lock; call early in setup(),
+// before any JSON is built.
+void startJsonArena();
+
+// Exclusive use of the shared arena for one request / one render.
+class JsonArenaScope {
+public:
+    JsonArenaScope();
+    ~JsonArenaScope();
+    JsonArenaScope(const JsonArenaScope &) = delete;
+    JsonArenaScope &operator=(const JsonArenaScope &) = delete;
+
+    ArduinoJson::Allocator *allocator();
+};
+
+// Bytes in use / high-water mark / allocation failures / leases, leases
+// taken on the packet task (should stay 0).
+void jsonArenaPrintMetrics(Print &out);
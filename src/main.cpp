@@ -1,149 +1,71 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WiFiUdp.h>
 #include <SPIFFS.h>
 #include <Preferences.h>
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include <ElegantOTA.h>
-#include <ESPAsyncE131.h>
-#include <Adafruit_PWMServoDriver.h>
 
-// If you already have discovery.{h,cpp} from earlier, keep this include:
+#include "config_schema.h"
+#include "control.h"
 #include "discovery.h"
+#include "event_bus.h"
+#include "frame_ack.h"
+#include "gateway.h"
+#include "i2c_output.h"
+#include "json_arena.h"
 #include "main_config.h"
-
-// ---------- PROTOCOL CONSTANTS ----------
+#include "mem_place.h"
+#include "mqtt_bridge.h"
+#include "packet_task.h"
+#include "patch.h"
+#include "protocol.h"
+#include "relay_output.h"
+#include "relay_stats.h"
+#include "remote_log.h"
+#include "scenes.h"
+#include "status_led.h"
+#include "test_pattern.h"
+#include "ws_push.h"
+
+// ---------- PROTOCOLS ----------
 //
-// We only care about network protocols: ArtNet, E1.31 (sACN), DDP.
+// We only care about network protocols: ArtNet, E1.31 (sACN), DDP, and
+// for older sequencers OPC (TCP) and KiNET.
 // “DMX” in comments elsewhere just means “per-channel 0–255 values”,
 // coming from these network packets – no physical DMX output here.
+// Each receiver lives in its own proto_*.cpp module, see protocol.h.
 //
 
-// Art-Net
-#define ARTNET_SUBNET         0
-#define ARTNET_UNIVERSE       41
-#define ARTNET_ARTDMX         0x5000
-#define ARTNET_ARTPOLL        0x2000
-#define ARTNET_PORT           0x1936      // 6454
-#define ARTNET_START_ADDRESS  18          // first channel byte in ArtNet packet
-
-// E1.31 (sACN)
-#define E131_SUBNET           0
-#define E131_PORT             5568
-#define E131_START_ADDRESS    126         // first channel byte in E1.31 packet
-
-// DDP
-#define DDP_PORT              4048
-#define DDP_HEADER_LEN        10          // payload starts at byte 10
-
 // Misc
-#define ETHERNET_BUFFER_MAX   640
 #define STATUS_LED            2
 
-Adafruit_PWMServoDriver pwm;
-
-// ---------- WiFi CONFIG (change these) ----------
-
-const char* WIFI_SSID = "xlights";
-const char* WIFI_PASS = "christmas2024";
-
 // ---------- CONFIG / STATE STRUCTS ----------
 
 DeviceConfig cfg;
 Preferences prefs;
 
-// High-level trigger: HIGH = ON, LOW = OFF
-bool relayState[NUM_RELAYS] = { false };
-
-// ---------- UDP / PACKET STATE ----------
-
-WiFiUDP aUDP;   // Art-Net
-WiFiUDP suUDP;  // E1.31 (sACN)
-WiFiUDP ddpUDP; // DDP
-uint8_t packetBuffer[ETHERNET_BUFFER_MAX];
-// Async E1.31 receiver (E1.31 / sACN)
-ESPAsyncE131 e131(10);   // queue depth = 10 packets
-
-// Timeout logic
-volatile byte currentcounter = 0;
-byte   previouscounter       = 0;
-unsigned long currentDelay   = 0;
-
-// ---------- RELAY HELPERS (HIGH-LEVEL TRIGGER) ----------
+// What NVS holds right now; saveCfg() only writes fields that differ.
+static DeviceConfig g_savedCfg;
 
-void setRelay(uint8_t index, bool on) {
-    if (index >= NUM_RELAYS) return;
-    uint8_t gpio = cfg.relays[index].gpio;
-    if (gpio == 0xFF || gpio >= NUM_RELAYS) return;   // unmapped / disabled
-
-    pwm.setPin(gpio, on ? 4096 : 0);   // HIGH = ON, LOW = OFF
-    relayState[index] = on;
-}
-
-void setAllRelays(bool on) {
-    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
-        setRelay(i, on);
-    }
-}
-
-// ---------- NVS CONFIG (GPIO + WiFi) ----------
+// ---------- NVS CONFIG (see config_schema.h) ----------
 
 void loadCfg() {
-    // Defaults
-    cfg.universe  = ARTNET_UNIVERSE;
-    cfg.startChan = 1;
-
-    // Default PCA9685 channel mapping 0..15
-    uint8_t defPins[NUM_RELAYS] = {0, 1, 2, 3, 4, 5, 6, 7,
-                                   8, 9, 10, 11, 12, 13, 14, 15};
-    for (int i = 0; i < NUM_RELAYS; i++) {
-        cfg.relays[i].gpio = defPins[i];
-    }
-
-    strncpy(cfg.ssid, WIFI_SSID, sizeof(cfg.ssid) - 1);
-    strncpy(cfg.pass, WIFI_PASS, sizeof(cfg.pass) - 1);
+    configDefaults(cfg);
 
     prefs.begin("cfg", true);
-
-    cfg.universe  = prefs.getUShort("u", cfg.universe);
-    cfg.startChan = prefs.getUShort("s", cfg.startChan);
-
-    for (int i = 0; i < NUM_RELAYS; i++) {
-        char key[8];
-        sprintf(key, "g%u", i);
-        uint8_t pin = prefs.getUChar(key, cfg.relays[i].gpio);
-        cfg.relays[i].gpio = pin;
-    }
-
-    char ssidBuf[32] = {0};
-    char passBuf[32] = {0};
-    if (prefs.getString("ssid", ssidBuf, sizeof(ssidBuf)) > 0) {
-        strncpy(cfg.ssid, ssidBuf, sizeof(cfg.ssid) - 1);
-    }
-    if (prefs.getString("pass", passBuf, sizeof(passBuf)) > 0) {
-        strncpy(cfg.pass, passBuf, sizeof(cfg.pass) - 1);
-    }
-
+    configLoad(cfg, prefs);
     prefs.end();
+
+    g_savedCfg = cfg;
 }
 
 void saveCfg() {
     prefs.begin("cfg", false);
-
-    prefs.putUShort("u", cfg.universe);
-    prefs.putUShort("s", cfg.startChan);
-
-    for (int i = 0; i < NUM_RELAYS; i++) {
-        char key[8];
-        sprintf(key, "g%u", i);
-        prefs.putUChar(key, cfg.relays[i].gpio);
-    }
-
-    prefs.putString("ssid", cfg.ssid);
-    prefs.putString("pass", cfg.pass);
-
+    configSave(cfg, g_savedCfg, prefs);
     prefs.end();
+
+    g_savedCfg = cfg;
 }
 
 // ---------- WiFi ----------
@@ -162,67 +84,285 @@ void wifiConnect() {
     Serial.println();
 
     if (WiFi.status() == WL_CONNECTED) {
-        Serial.print("WiFi connected, IP: ");
-        Serial.println(WiFi.localIP());
+        LOGI("WiFi connected, IP: %s", WiFi.localIP().toString().c_str());
         // No WiFi.enableMulticast() on ESP32 core
     } else {
-        Serial.println("WiFi connect FAILED, working offline.");
+        LOGW("WiFi connect FAILED, working offline.");
     }
+
+    // Every new address (reconnect, DHCP renew, a late first connect):
+    // the cached ArtPollReply and discovery reply carry the IP, and
+    // multicast memberships are per interface address.
+    WiFi.onEvent([](WiFiEvent_t, WiFiEventInfo_t) {
+        LOGI("WiFi got IP %s", WiFi.localIP().toString().c_str());
+        requestReconfigure();
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
 }
 
 // ---------- WEB / API / UI ----------
 
 AsyncWebServer server(80);
 
+// Serialize straight into the response buffer; the document lives in the
+// JSON arena, so a 500 here means JSON_ARENA_SIZE is too small.
+static void sendJson(AsyncWebServerRequest *request, const JsonDocument &doc, bool pretty) {
+    if (doc.overflowed()) {
+        LOGE("[JSON] arena full building %s", request->url().c_str());
+        request->send(500, "text/plain", "JSON arena full");
+        return;
+    }
+    AsyncResponseStream *res = request->beginResponseStream("application/json");
+    if (pretty) serializeJsonPretty(doc, *res);
+    else        serializeJson(doc, *res);
+    request->send(res);
+}
+
+// Re-apply whatever a config change touched (CFG_APPLY_* bits).
+static void applyConfig(uint8_t applied) {
+    if (applied & CFG_APPLY_PATCH) {
+        requestReconfigure();       // dispatch masks rebuilt between frames
+    }
+    if (applied & CFG_APPLY_OUTPUT) {
+        PacketCommand cmd = { PKT_CMD_REFRESH, 0, 0, 0, 0, RELAY_MASK_ALL, 0 };
+        packetCommand(cmd);         // current state onto the new outputs
+    }
+    if (applied & CFG_APPLY_LOG) {
+        logSetCollector(cfg.logHost, cfg.logPort);
+        logSetLevel((LogLevel)cfg.logLevel);
+    }
+    if (applied & CFG_APPLY_MQTT) {
+        mqttReconfigure();
+    }
+    if (applied & CFG_APPLY_ACK) {
+        frameAckReconfigure();
+    }
+#if RELAY_GATEWAY
+    if (applied & CFG_APPLY_GATEWAY) {
+        gatewayReconfigure();
+    }
+#endif
+    if (applied & CFG_APPLY_REBOOT) {
+        LOGI("Config saved, takes effect after a restart");
+    }
+}
+
+// Every config change from the web: edit g_cfgNext (a copy of cfg taken
+// by beginConfigChange()), then commitConfigChange() validates it, has the
+// packet task merge the changed fields into cfg, saves and re-applies.
+static DeviceConfig g_cfgBase;      // web handlers run one at a time
+static DeviceConfig g_cfgNext;
+
+static DeviceConfig &beginConfigChange() {
+    g_cfgBase = cfg;
+    g_cfgNext = cfg;
+    return g_cfgNext;
+}
+
+static bool commitConfigChange(uint8_t applied, char *err, size_t errLen) {
+    if (!configValidate(g_cfgNext, err, errLen)) return false;
+    if (!packetAdoptConfig(g_cfgBase, g_cfgNext)) {
+        snprintf(err, errLen, "Busy, try again");
+        return false;
+    }
+    saveCfg();
+    applyConfig(applied);
+    return true;
+}
+
+// One schema field from text, for forms whose parameter names differ.
+static bool parseField(DeviceConfig &next, const char *name, const char *text,
+                       uint8_t *applied, char *err, size_t errLen) {
+    const ConfigField *f = configFieldNamed(name);
+    if (!f) {
+        snprintf(err, errLen, "no field %s", name);
+        return false;
+    }
+    return configParseText(next, *f, 0, text, applied, err, errLen);
+}
+
+// Form parameters named like schema fields: global fields under prefix
+// (relay < 0), or the per-relay fields of one relay. Only the names in
+// fields (relative to prefix, nullptr-terminated) are taken; nullptr =
+// every field under prefix. All or nothing; on error cfg is untouched and
+// err says why.
+static bool applyForm(AsyncWebServerRequest *request, const char *prefix,
+                      const char *const *fields, int relay,
+                      uint8_t *applied, char *err, size_t errLen) {
+    DeviceConfig &next = beginConfigChange();
+
+    size_t plen = strlen(prefix);
+    for (uint8_t i = 0; i < configFieldCount(); i++) {
+        const ConfigField &f = configField(i);
+        bool perRelay = f.flags & CFG_PER_RELAY;
+        if (perRelay != (relay >= 0) || strncmp(f.name, prefix, plen) != 0) continue;
+
+        const char *param = f.name + plen;
+        if (strchr(param, '.')) continue;
+        if (fields) {
+            const char *const *n = fields;
+            while (*n && strcmp(*n, param) != 0) n++;
+            if (!*n) continue;
+        }
+        if (!request->hasParam(param, true)) continue;
+        const String &value = request->getParam(param, true)->value();
+        if (!configParseText(next, f, relay >= 0 ? relay : 0, value.c_str(),
+                             applied, err, errLen)) {
+            return false;
+        }
+    }
+    return commitConfigChange(*applied, err, errLen);
+}
+
+// Fields each settings form may change
+static const char *const GPIO_FIELDS[]    = { "gpio", nullptr };
+static const char *const BINDING_FIELDS[] = { "source", "policy", nullptr };
+static const char *const MODE_FIELDS[]    = { "mode", "pulse_ms", nullptr };
+static const char *const RULES_FIELDS[]   = { "rules", nullptr };
+static const char *const PATCH_FIELDS[]   = { "universe", "startChan", nullptr };
+
+// POST /api/config collects its JSON body here (one request at a time).
+#define CONFIG_BODY_MAX       3072        // full config incl. gateway routes
+static char                   g_cfgBody[CONFIG_BODY_MAX];
+static AsyncWebServerRequest *g_cfgBodyOwner = nullptr;
+
+static void configBody(AsyncWebServerRequest *request, uint8_t *data, size_t len,
+                       size_t index, size_t total) {
+    if (index == 0) {
+        if (g_cfgBodyOwner || total >= sizeof(g_cfgBody)) return;   // answered in the handler
+        g_cfgBodyOwner = request;
+        request->onDisconnect([request]() {
+            if (g_cfgBodyOwner == request) g_cfgBodyOwner = nullptr;
+        });
+    }
+    if (g_cfgBodyOwner != request) return;
+    memcpy(g_cfgBody + index, data, len);
+    if (index + len == total) g_cfgBody[total] = '\0';
+}
+
 void startWeb() {
     // Advanced GUI
     server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
         request->send(SPIFFS, "/ui.html", "text/html");
     });
 
-    // Config + relay state for UI
     // Config + relay state for UI
     server.on("/api/config", HTTP_GET, [](AsyncWebServerRequest *request) {
-        DynamicJsonDocument doc(1024);
+        JsonArenaScope arena;
+        JsonDocument   doc(arena.allocator());
 
         // Informational only – you don't care about DMX, just network protocols
-        doc["protocols"] = "ArtNet / E1.31 / DDP";
+        char protos[64] = "";
+        JsonObject enabled = doc["protocol_enabled"].to<JsonObject>();
+        for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+            const ProtocolModule *m = protocolById(id);
+            if (!m) continue;                       // compiled out
+            bool on = protocolsEnabledMask() & (1u << id);
+            enabled[m->name] = on;
+            if (!on) continue;
+            if (protos[0]) strlcat(protos, " / ", sizeof(protos));
+            strlcat(protos, m->label, sizeof(protos));
+        }
+        doc["protocols"] = protos;
         doc["channels"]  = NUM_RELAYS;
 
         // For your banner
         doc["xlights_discovery"] = true;
 
+#if RELAY_PROTO_E131
+        // Universes E1.31 senders announce, and the one we'd suggest
+        uint16_t offered[E131_DISC_MAX_UNIVERSES];
+        uint8_t  nOffered = e131OfferedUniverses(offered, E131_DISC_MAX_UNIVERSES);
+        JsonArray offers  = doc["e131_offered"].to<JsonArray>();
+        for (uint8_t i = 0; i < nOffered; i++) offers.add(offered[i]);
+        doc["e131_suggest"] = e131SuggestUniverse();
+#endif
+
         // Advertise MultiSync capability sourced from on-board storage
-        JsonObject sync = doc.createNestedObject("multisync");
+        JsonObject sync = doc["multisync"].to<JsonObject>();
         sync["enabled"] = true;
         sync["source"]  = "sd";
 
-        // Kept for backward compatibility with older UIs
-        doc["universe"]  = cfg.universe;
-        doc["startChan"] = cfg.startChan;
+        // Every persisted setting (groups log/mqtt/wifi, relays[]), then
+        // the live relay state on top.
+        configToJson(cfg, doc.as<JsonObject>());
 
-        JsonArray arr = doc.createNestedArray("relays");
+        JsonArray arr = doc["relays"];
         for (uint8_t i = 0; i < NUM_RELAYS; i++) {
-            JsonObject o = arr.createNestedObject();
-            o["index"] = i;
-            o["gpio"]  = cfg.relays[i].gpio;
-            o["state"] = relayState[i];
+            arr[i]["index"] = i;
+            arr[i]["state"] = relayState[i];
         }
 
-        String out;
-        serializeJsonPretty(doc, out);
-        request->send(200, "application/json", out);
+        sendJson(request, doc, true);
     });
 
+    // Any subset of the /api/config document, validated as a whole:
+    // POST {"log":{"level":7},"relays":[{"index":2,"mode":"toggle"}]}
+    server.on("/api/config", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (g_cfgBodyOwner != request) {
+            request->send(413, "text/plain", "Body too large or busy");
+            return;
+        }
+
+        uint8_t applied = 0;
+        char    err[64] = "";
+        {
+            JsonArenaScope arena;
+            JsonDocument   doc(arena.allocator());
+            DeviceConfig  &next = beginConfigChange();
+
+            DeserializationError jerr = deserializeJson(doc, g_cfgBody);
+            g_cfgBodyOwner = nullptr;
+            if (jerr || !doc.is<JsonObject>()) {
+                snprintf(err, sizeof(err), "Bad JSON: %s", jerr ? jerr.c_str() : "not an object");
+            } else if (configFromJson(next, doc.as<JsonObjectConst>(), &applied, err, sizeof(err))) {
+                err[0] = '\0';
+            }
+        }
+        if (err[0] || !commitConfigChange(applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
+            return;
+        }
+
+        request->send(200, "text/plain", "OK");
+        LOGI("Config updated (apply 0x%02x)", applied);
+    }, nullptr, configBody);
 
-    // Manual relay control from UI: POST relay=<n>&value=0|1
+    // Field table for clients that render settings generically
+    server.on("/api/schema", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonArenaScope arena;
+        JsonDocument   doc(arena.allocator());
+        configSchemaToJson(doc.to<JsonObject>());
+        sendJson(request, doc, false);
+    });
+
+    // Manual relay control from UI: POST relay=<n>&value=0|1, or
+    // state=<'1'/'0'/'-' per relay> to set many at once in one commit
     server.on("/api/set", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (request->hasParam("state", true)) {
+            const String &text = request->getParam("state", true)->value();
+            PacketCommand cmd = { PKT_CMD_SET_MASK, 0, 0, 0, 0, 0, 0 };
+            if (!relayParseState(text.c_str(), text.length(), cmd.mask, cmd.state)) {
+                request->send(400, "text/plain", "Bad state");
+                return;
+            }
+            if (!packetCommand(cmd)) {
+                request->send(503, "text/plain", "Busy");
+                return;
+            }
+            request->send(200, "text/plain", "OK");
+            return;
+        }
         if (request->hasParam("relay", true) && request->hasParam("value", true)) {
             int  idx = request->getParam("relay", true)->value().toInt();
             bool val = (request->getParam("value", true)->value() == "1");
 
             if (idx >= 0 && idx < NUM_RELAYS) {
-                setRelay((uint8_t)idx, val);
+                // Relays are only ever written by the packet task.
+                PacketCommand cmd = { PKT_CMD_SET, (uint8_t)idx, val, 0, 0, 0, 0 };
+                if (!packetCommand(cmd)) {
+                    request->send(503, "text/plain", "Busy");
+                    return;
+                }
                 request->send(200, "text/plain", "OK");
                 return;
             }
@@ -230,180 +370,346 @@ void startWeb() {
         request->send(400, "text/plain", "Bad params");
     });
 
-    // GPIO mapping from UI: POST relay=<n>&gpio=<pin>
-    server.on("/api/set_gpio", HTTP_POST, [](AsyncWebServerRequest *request) {
-        if (request->hasParam("relay", true) && request->hasParam("gpio", true)) {
-            int idx  = request->getParam("relay", true)->value().toInt();
-            int gpio = request->getParam("gpio",  true)->value().toInt();
+    // Settings forms. Parameter names are schema field names; values are
+    // range-checked by the schema and cross-checked by configValidate().
 
+    // Per relay: POST relay=<n>& gpio | source, policy | mode, pulse_ms
+    auto relayForm = [](const char *const *fields) {
+        return [fields](AsyncWebServerRequest *request) {
+            int idx = request->hasParam("relay", true)
+                    ? request->getParam("relay", true)->value().toInt() : -1;
             if (idx < 0 || idx >= NUM_RELAYS) {
                 request->send(400, "text/plain", "Invalid relay index");
                 return;
             }
-            if (gpio < 0 || gpio >= NUM_RELAYS) {
-                request->send(400, "text/plain", "Invalid channel");
+            uint8_t applied = 0;
+            char    err[64];
+            if (!applyForm(request, "", fields, idx, &applied, err, sizeof(err))) {
+                request->send(400, "text/plain", err);
                 return;
             }
+            request->send(200, "text/plain", "OK");
 
-            cfg.relays[idx].gpio = (uint8_t)gpio;
-            saveCfg();
-            setRelay((uint8_t)idx, relayState[idx]);   // apply current state on new pin
+            const RelayConfig &rc = cfg.relays[idx];
+            const ProtocolModule *src = protocolById(rc.source);
+            LOGI("Relay %d: output %u, %s (%s), mode %s (%u ms)", idx, rc.gpio,
+                 src ? src->name : "any", relayPolicyName(rc.policy),
+                 relayModeName(rc.mode), rc.pulseMs);
+        };
+    };
+    server.on("/api/set_gpio",    HTTP_POST, relayForm(GPIO_FIELDS));
+    server.on("/api/set_binding", HTTP_POST, relayForm(BINDING_FIELDS));
+    server.on("/api/set_mode",    HTTP_POST, relayForm(MODE_FIELDS));
+
+    // Channel rules: POST rules=<text> (see rules.h), empty clears them
+    server.on("/api/set_rules", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("rules", true)) {
+            request->send(400, "text/plain", "Missing rules");
+            return;
+        }
+        uint8_t applied = 0;
+        char    err[64];
+        if (!applyForm(request, "", RULES_FIELDS, -1, &applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+        LOGI("Rules updated: '%s'", cfg.rules);
+    });
 
-            request->send(200, "text/plain", "OK");
-            Serial.printf("Relay %d remapped to GPIO %d\n", idx, gpio);
+    // Remote syslog from UI: POST host=<ipv4|empty>&port=<n>&level=<3..7>
+    server.on("/api/set_log", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint8_t applied = 0;
+        char    err[64];
+        if (!applyForm(request, "log.", nullptr, -1, &applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
             return;
         }
-        request->send(400, "text/plain", "Missing relay/gpio");
+        request->send(200, "text/plain", "OK");
+        LOGI("Syslog collector '%s:%u', level %u", cfg.logHost, cfg.logPort, cfg.logLevel);
     });
 
-    // OTA
-    ElegantOTA.begin(&server);
+    // MQTT broker: POST host=<name|ip>&port=<n>&user=..&pass=..&topic=<prefix>
+    // (empty host disables MQTT)
+    server.on("/api/set_mqtt", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint8_t applied = 0;
+        char    err[64];
+        if (!applyForm(request, "mqtt.", nullptr, -1, &applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+        LOGI("MQTT broker '%s:%u', topic '%s'", cfg.mqttHost, cfg.mqttPort, cfg.mqttTopic);
+    });
 
-    server.begin();
-    Serial.println("HTTP server started");
-}
+    // Commissioning patterns: POST pattern=walk|pulse|chase|board|stop[&step=ms][&board=n]
+    server.on("/api/test", HTTP_POST, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("pattern", true)) {
+            request->send(400, "text/plain", "Missing pattern");
+            return;
+        }
+        String name = request->getParam("pattern", true)->value();
+        if (name == "stop") {
+            PacketCommand cmd = { PKT_CMD_TEST_STOP, 0, 0, 0, 0, 0, 0 };
+            packetCommand(cmd);
+            request->send(200, "text/plain", "OK");
+            return;
+        }
 
-// ---------- ArtNet / E1.31 / DDP HANDLERS ----------
+        TestPattern p = testPatternFromName(name.c_str());
+        if (p == TestPattern::None) {
+            request->send(400, "text/plain", "Unknown pattern");
+            return;
+        }
+        uint16_t stepMs = TEST_STEP_DEFAULT_MS;
+        if (request->hasParam("step", true) &&
+            !testPatternParseStep(request->getParam("step", true)->value().c_str(), stepMs)) {
+            char err[48];
+            snprintf(err, sizeof(err), "step: %u..%u ms", TEST_STEP_MIN_MS, TEST_STEP_MAX_MS);
+            request->send(400, "text/plain", err);
+            return;
+        }
+        uint8_t  board  = request->hasParam("board", true)
+                        ? request->getParam("board", true)->value().toInt() : 0;
 
-// ArtNet opcode
-int artNetOpCode(uint8_t* pbuff) {
-    String test = String((char*)pbuff);
-    if (test.equals("Art-Net")) {
-        if (pbuff[11] >= 14) {
-            return pbuff[9] * 256 + pbuff[8];  // lo byte first
+        PacketCommand cmd = { PKT_CMD_TEST, 0, (uint8_t)p, board, stepMs, 0, 0 };
+        if (!packetCommand(cmd)) {
+            request->send(503, "text/plain", "Busy");
+            return;
         }
-    }
-    return 0;
-}
+        request->send(200, "text/plain", "OK");
+    });
 
-// ArtNet → relays
-void artDMXReceived(uint8_t* pbuff) {
-    if ((pbuff[14] & 0xF) == ARTNET_UNIVERSE) {
-        if ((pbuff[14] >> 8) == ARTNET_SUBNET) {
-            int channelOffset = 0;
-            for (int b = 0; b < NUM_RELAYS; b++) {
-                uint8_t val = pbuff[ARTNET_START_ADDRESS + channelOffset];
-                bool on = (val > 127);
-                setRelay(b, on);
-                channelOffset++;
+    // Stored scenes: state as '1'/'0'/'-' per relay, modes as the comma
+    // list POST takes (empty = keep); omitted if the scene sets none.
+    server.on("/api/scenes", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonArenaScope arena;
+        JsonDocument   doc(arena.allocator());
+        doc["count"] = SCENE_COUNT;
+
+        JsonArray arr = doc["scenes"].to<JsonArray>();
+        for (uint8_t n = 1; n <= SCENE_COUNT; n++) {
+            Scene s;
+            if (!sceneGet(n, s)) continue;
+            char state[NUM_RELAYS + 1];
+            sceneFormatState(s, state, sizeof(state));
+
+            JsonObject o = arr.add<JsonObject>();
+            o["scene"] = n;
+            o["name"]  = s.name;
+            o["state"] = state;
+
+            char   modes[NUM_RELAYS * (RELAY_MODE_NAME_MAX + 1)];
+            size_t len     = 0;
+            bool   anyMode = false;
+            for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+                if (i) modes[len++] = ',';
+                if (s.modes[i] >= RELAY_MODE_COUNT) continue;
+                len    += snprintf(modes + len, sizeof(modes) - len, "%s", relayModeName(s.modes[i]));
+                anyMode = true;
             }
+            modes[len] = '\0';
+            if (anyMode) o["modes"] = modes;
         }
-    }
-}
 
+        sendJson(request, doc, false);
+    });
 
-// DDP → relays
-void ddpReceived(uint8_t* buf, int len) {
-    if (len <= DDP_HEADER_LEN) return;
-
-    // Very lightweight parse: default DDP header is 10 bytes.
-    // Byte 2..5: 32-bit big-endian offset
-    // Byte 6..7: 16-bit big-endian data length
-    uint32_t offset = ((uint32_t)buf[2] << 24) |
-                      ((uint32_t)buf[3] << 16) |
-                      ((uint32_t)buf[4] << 8)  |
-                      (uint32_t)buf[5];
-
-    uint16_t dataLen = ((uint16_t)buf[6] << 8) | (uint16_t)buf[7];
-
-    // Clamp to actual packet size
-    if (DDP_HEADER_LEN + dataLen > len) {
-        dataLen = len - DDP_HEADER_LEN;
-    }
-
-    // We assume 1 byte per “channel” (no RGB unpacking here).
-    // First 8 channels coming from DDP control our 8 relays.
-    // offset is the starting channel index in the global stream.
-    for (int i = 0; i < NUM_RELAYS; i++) {
-        uint32_t chanIndex = offset + i;
-        if (chanIndex >= dataLen) break;
+    // POST scene=<n> and one of: capture=1 [name] (current relays),
+    // erase=1, or name + state ("01-1..") [+ modes "latched,,toggle,.."]
+    server.on("/api/scenes", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint8_t n = request->hasParam("scene", true)
+                  ? request->getParam("scene", true)->value().toInt() : 0;
+        if (n < 1 || n > SCENE_COUNT) {
+            request->send(400, "text/plain", "Invalid scene number");
+            return;
+        }
+        String name = request->hasParam("name", true)
+                    ? request->getParam("name", true)->value() : String();
+
+        if (request->hasParam("erase", true)) {
+            sceneErase(n);
+        } else if (request->hasParam("capture", true)) {
+            sceneCapture(n, name.c_str());
+        } else {
+            Scene s;
+            memset(&s, 0, sizeof(s));
+            memset(s.modes, SCENE_MODE_KEEP, sizeof(s.modes));
+            strlcpy(s.name, name.c_str(), sizeof(s.name));
+            if (!request->hasParam("state", true) ||
+                !sceneParseState(s, request->getParam("state", true)->value().c_str())) {
+                request->send(400, "text/plain", "state needs one of 0/1/- per relay");
+                return;
+            }
+            if (request->hasParam("modes", true)) {
+                String list = request->getParam("modes", true)->value();
+                int    from = 0;
+                for (uint8_t i = 0; i < NUM_RELAYS && from <= (int)list.length(); i++) {
+                    int to = list.indexOf(',', from);
+                    if (to < 0) to = list.length();
+                    String m = list.substring(from, to);
+                    from = to + 1;
+                    if (!m.length()) continue;
+                    int mode = relayModeFromName(m.c_str());
+                    if (mode < 0) {
+                        request->send(400, "text/plain", "Invalid mode");
+                        return;
+                    }
+                    s.modes[i] = mode;
+                }
+            }
+            sceneStore(n, s);
+        }
+        request->send(200, "text/plain", "OK");
+    });
 
-        uint8_t v = buf[DDP_HEADER_LEN + chanIndex];
-        bool on = (v > 127);
-        setRelay((uint8_t)i, on);
-    }
-}
+    // POST scene=<n|name>
+    server.on("/api/recall_scene", HTTP_POST, [](AsyncWebServerRequest *request) {
+        String  which = request->hasParam("scene", true)
+                      ? request->getParam("scene", true)->value() : String();
+        uint8_t n = sceneFind(which.c_str());
+        if (!n) {
+            request->send(404, "text/plain", "No such scene");
+            return;
+        }
+        if (!sceneRecall(n)) {
+            request->send(503, "text/plain", "Busy");
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    });
 
-// Unified handler for all three protocols
-void handlePackets() {
-    // Timeout logic
-    if (currentcounter != previouscounter) {
-        currentDelay = millis();
-        previouscounter = currentcounter;
-    }
-    if (millis() - currentDelay > 30000) {
-        digitalWrite(STATUS_LED, LOW);   // not receiving
-        // Optionally: setAllRelays(false);
-    }
+    // Relay wear counters
+    server.on("/api/relay_stats", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonArenaScope arena;
+        JsonDocument   doc(arena.allocator());
+        doc["eol_cycles"] = cfg.eolCycles;
 
-    // 1) Art-Net
-    int packetSize = aUDP.parsePacket();
-    if (packetSize > 0) {
-        if (packetSize > ETHERNET_BUFFER_MAX) packetSize = ETHERNET_BUFFER_MAX;
-        aUDP.read(packetBuffer, packetSize);
-
-        int opcode = artNetOpCode(packetBuffer);
-        if (opcode == ARTNET_ARTDMX) {
-            Serial.println("ArtNet Packet Received");
-            artDMXReceived(packetBuffer);
-            currentcounter++;
-            digitalWrite(STATUS_LED, HIGH);
+        JsonArray arr = doc["relays"].to<JsonArray>();
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+            RelayCounters c = relayStatsGet(i);
+            JsonObject    o = arr.add<JsonObject>();
+            o["relay"]     = i + 1;             // numbered from 1, like /metrics
+            o["cycles"]    = c.cycles;
+            o["on_time_s"] = (uint32_t)(c.onTimeMs / 1000);
+            o["eol"]       = relayStatsEol(i);
         }
-        return;
-    }
-
-    // 2) E1.31 (sACN) via ESPAsyncE131
-    while (!e131.isEmpty()) {
-        e131_packet_t packet;
-        e131.pull(&packet);
 
-        // property_values[0] = start code
-        // property_values[1..] = DMX channels 1..N
-        Serial.println("E131 Packet Received (ESPAsyncE131)");
+        sendJson(request, doc, false);
+    });
 
-        for (int i = 0; i < NUM_RELAYS; i++) {
-            // cfg.startChan is 1-based DMX start channel
-            uint16_t chan = cfg.startChan + i;  // 1..n
-            if (chan >= packet.property_value_count) {
-                break;
+    // POST eol=<cycles> (schema field eol_cycles) and/or reset=<relay 1..N|all>
+    server.on("/api/relay_stats", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint8_t reset = 0xFF;                   // relay index, NUM_RELAYS = all
+        if (request->hasParam("reset", true)) {
+            const String &which = request->getParam("reset", true)->value();
+            char *end   = nullptr;
+            long  relay = strtol(which.c_str(), &end, 10);
+            if (which == "all") {
+                reset = NUM_RELAYS;
+            } else if (end != which.c_str() && *end == '\0' && relay >= 1 && relay <= NUM_RELAYS) {
+                reset = (uint8_t)(relay - 1);
+            } else {
+                char err[40];
+                snprintf(err, sizeof(err), "reset: relay 1..%u or all", NUM_RELAYS);
+                request->send(400, "text/plain", err);
+                return;
+            }
+        }
+        if (request->hasParam("eol", true)) {
+            DeviceConfig &next    = beginConfigChange();
+            uint8_t       applied = 0;
+            char          err[64];
+            const String &text    = request->getParam("eol", true)->value();
+            if (!parseField(next, "eol_cycles", text.c_str(), &applied, err, sizeof(err)) ||
+                !commitConfigChange(applied, err, sizeof(err))) {
+                request->send(400, "text/plain", err);
+                return;
             }
+        }
+        if (reset != 0xFF) {
+            PacketCommand cmd = { PKT_CMD_STATS_RESET, reset, 0, 0, 0, 0, 0 };
+            if (!packetCommand(cmd)) {
+                request->send(503, "text/plain", "Busy");
+                return;
+            }
+            if (reset < NUM_RELAYS) LOGI("[RSTATS] counters of relay %u reset", reset + 1);
+            else                    LOGI("[RSTATS] all counters reset");
+        }
+        request->send(200, "text/plain", "OK");
+    });
 
-            uint8_t v = packet.property_values[chan];
-            bool on = (v > 127);
-            setRelay((uint8_t)i, on);
+    // Runtime protocol selection: POST artnet=0|1&e131=0|1&ddp=0|1&opc=0|1&kinet=0|1
+    // (one bit each of the schema's protocol_mask)
+    server.on("/api/set_protocols", HTTP_POST, [](AsyncWebServerRequest *request) {
+        DeviceConfig &next = beginConfigChange();
+        uint8_t mask = next.protoMask;
+        for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+            const ProtocolModule *m = protocolById(id);
+            if (!m || !request->hasParam(m->name, true)) continue;
+            if (request->getParam(m->name, true)->value() == "1") mask |= 1u << id;
+            else                                                  mask &= ~(1u << id);
         }
 
-        currentcounter++;
-        digitalWrite(STATUS_LED, HIGH);
-        // NO return here – we let DDP still be processed in same loop if needed
-    }
+        char    text[4];
+        uint8_t applied = 0;
+        char    err[64];
+        snprintf(text, sizeof(text), "%u", mask);
+        if (!parseField(next, "protocol_mask", text, &applied, err, sizeof(err)) ||
+            !commitConfigChange(applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    });
 
+    // Live re-patch, no reboot: POST universe=<n>&startChan=<n>
+    // (universe fits a 15-bit Art-Net port-address as well as E1.31)
+    server.on("/api/set_patch", HTTP_POST, [](AsyncWebServerRequest *request) {
+        uint8_t applied = 0;
+        char    err[64];
+        if (!applyForm(request, "", PATCH_FIELDS, -1, &applied, err, sizeof(err))) {
+            request->send(400, "text/plain", err);
+            return;
+        }
+        request->send(200, "text/plain", "OK");
+    });
 
-    // 3) DDP
-    packetSize = ddpUDP.parsePacket();
-    if (packetSize > 0) {
-        if (packetSize > ETHERNET_BUFFER_MAX) packetSize = ETHERNET_BUFFER_MAX;
-        ddpUDP.read(packetBuffer, packetSize);
+    // Plain-text counters for scraping
+    server.on("/metrics", HTTP_GET, [](AsyncWebServerRequest *request) {
+        AsyncResponseStream *res = request->beginResponseStream("text/plain");
+        logPrintMetrics(*res);
+        protocolsPrintMetrics(*res);
+#if RELAY_PROTO_E131
+        e131PrintDiscovery(*res);
+#endif
+        packetPrintMetrics(*res);
+        i2cOutputPrintMetrics(*res);
+        relayOutputPrintMetrics(*res);
+        relayStatsPrintMetrics(*res);
+        scenesPrintMetrics(*res);
+        jsonArenaPrintMetrics(*res);
+        mqttPrintMetrics(*res);
+        frameAckPrintMetrics(*res);
+#if RELAY_GATEWAY
+        gatewayPrintMetrics(*res);
+#endif
+        memPrintMetrics(*res);
+        eventBusPrintMetrics(*res);
+        wsPushPrintMetrics(*res);
+        request->send(res);
+    });
 
-        Serial.println("DDP Packet Received");
-        Serial.print("BUFFER" + packetBuffer[packetSize]);
-        ddpReceived(packetBuffer, packetSize);
-        currentcounter++;
-        digitalWrite(STATUS_LED, HIGH);
-        return;
-    }
-}
+    // Live relay state for the UI
+    startWsPush(server);
 
-// ---------- Power On Self Test ----------
+    // OTA
+    ElegantOTA.begin(&server);
+    ElegantOTA.onStart([]() { statusLedSetOta(true); });
+    ElegantOTA.onEnd([](bool success) { statusLedSetOta(false); });
 
-void POST() {
-    Serial.println("POST: walking the relays");
-    for (int i = 0; i < NUM_RELAYS; i++) {
-        setRelay(i, true);
-        delay(300);
-        setRelay(i, false);
-    }
-    Serial.println("POST Complete");
+    server.begin();
+    LOGI("HTTP server started");
 }
 
 // ---------- SETUP / LOOP ----------
@@ -412,44 +718,48 @@ void setup() {
     Serial.begin(115200);
     delay(200);
     Serial.println();
-    Serial.println("ESP32 WiFi Relay Controller (ArtNet / E1.31 / DDP)");
+    startLogging();
+    startJsonArena();
+    LOGI("ESP32 WiFi Relay Controller (ArtNet / E1.31 / DDP / OPC / KiNET)");
 
-    pinMode(STATUS_LED, OUTPUT);
-    digitalWrite(STATUS_LED, LOW);
+    startStatusLed(STATUS_LED);
 
     if (!SPIFFS.begin(true)) {
-        Serial.println("SPIFFS mount failed!");
+        LOGE("SPIFFS mount failed!");
     }
 
-    pwm.begin();
-    pwm.setOscillatorFrequency(27000000);
-    pwm.setPWMFreq(1000);  // Fast enough for SSR on/off
+    startRelayOutput();
 
     loadCfg();
+    startPatch();
+    logSetLevel((LogLevel)cfg.logLevel);
+    logSetCollector(cfg.logHost, cfg.logPort);
+    frameAckReconfigure();
+#if RELAY_GATEWAY
+    gatewayReconfigure();
+#endif
     wifiConnect();
 
 
-    // Start UDP listeners
-    aUDP.begin(ARTNET_PORT);
-    ddpUDP.begin(DDP_PORT);
+    // Start UDP listeners for the enabled protocols
+    // (E1.31 joins the multicast group for cfg.universe)
+    protocolsApply(cfg.protoMask);
 
-    // Start async E1.31 listener (multicast)
-    // Uses cfg.universe from main_config.h and joins 1 universe.
-    if (e131.begin(E131_MULTICAST, cfg.universe, 1)) {
-        Serial.printf("E1.31 listening (multicast), universe %u\n", cfg.universe);
-    } else {
-        Serial.println("E1.31 init FAILED");
-    }
 
-    Serial.printf("Listening for Art-Net on port %u\n", ARTNET_PORT);
-    Serial.printf("Listening for DDP on port %u\n", DDP_PORT);
+    // Wear counters from the last checkpoint
+    startRelayStats();
 
+    // Stored cues for ArtTrigger / ArtCommand / SCENE / HTTP recall
+    startScenes();
 
     // Initialize relays to OFF
     setAllRelays(false);
 
-    // Self-test
-    POST();
+    // Self-test: relay walk runs in the packet task, show data pre-empts it
+    testPatternStart(TestPattern::Walk);
+
+    // From here on only the packet task touches the relays
+    startPacketTask();
 
     // Web UI + OTA
     startWeb();
@@ -457,14 +767,25 @@ void setup() {
     // xLights & FPP discovery
     startXLightsDiscovery();
 
+    // Text control port (test patterns etc.)
+    startControl();
+
+    // Building automation (idle until a broker is configured)
+    startMqtt();
+
+    // Where the big buffers ended up
+    memReport();
 
-    currentDelay = millis();
 }
 
+// Relays, patch and timeouts run in the packet task; sockets are served
+// from their callbacks. What's left here is slow housekeeping.
 void loop() {
-    handlePackets();    // ArtNet / E1.31 / DDP
-    handleXLightsDiscovery();  // <--- add this
+    discoveryTick();
+    wsPushTick();
+    frameAckTick();
+    relayStatsTick();
+    scenesTick();
     ElegantOTA.loop();  // if you kept OTA
-    delay(1);
-
+    delay(50);
 }
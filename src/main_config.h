@@ -1,20 +1,94 @@
 #pragma once
 #include <stdint.h>
 
-constexpr uint8_t NUM_RELAYS = 16;
+// Relays on this controller; one PCA9685 board per 16 (see i2c_output.h).
+#ifndef RELAY_COUNT
+#define RELAY_COUNT 16
+#endif
+constexpr uint8_t NUM_RELAYS = RELAY_COUNT;
+
+// One bit per relay.
+#if RELAY_COUNT <= 32
+typedef uint32_t RelayMask;
+#else
+typedef uint64_t RelayMask;
+#endif
+static_assert(NUM_RELAYS <= 64, "RelayMask too narrow for NUM_RELAYS");
+constexpr RelayMask RELAY_MASK_ALL = (NUM_RELAYS < sizeof(RelayMask) * 8)
+                                   ? ((RelayMask)1 << NUM_RELAYS) - 1 : ~(RelayMask)0;
+
+// Factory WiFi credentials (change these, or -DWIFI_SSID=\"...\"); the UI /
+// API can store others in NVS.
+#ifndef WIFI_SSID
+#define WIFI_SSID "xlights"
+#endif
+#ifndef WIFI_PASS
+#define WIFI_PASS "christmas2024"
+#endif
+
+// Which incoming data may drive a relay.
+enum RelayPolicy : uint8_t {
+    RELAY_NEWEST   = 0,    // any protocol, last frame wins (default)
+    RELAY_BIND     = 1,    // only `source`, everything else ignored
+    RELAY_PRIORITY = 2,    // `source` while it is live, others as fallback
+    RELAY_HTP      = 3,    // on if any live protocol says on
+    RELAY_POLICY_COUNT
+};
+
+constexpr uint8_t RELAY_SOURCE_ANY = 0xFF;
+
+// How the (arbitrated) channel level turns into contact state.
+enum RelayMode : uint8_t {
+    RELAY_LATCHED      = 0,    // follows the channel (default)
+    RELAY_PULSE_RISE   = 1,    // on for pulseMs when the channel goes on
+    RELAY_PULSE_CHANGE = 2,    // on for pulseMs on every on/off edge
+    RELAY_TOGGLE       = 3,    // each off->on edge flips the relay
+    RELAY_MODE_COUNT
+};
 
 struct RelayConfig {
     uint8_t gpio;
+    uint8_t source;        // ProtoId for BIND/PRIORITY, else RELAY_SOURCE_ANY
+    uint8_t policy;        // RelayPolicy
+    uint8_t mode;          // RelayMode
+    uint16_t pulseMs;      // pulse length for the PULSE_* modes
 };
 
 struct DeviceConfig {
     uint16_t universe;
     uint16_t startChan;
+    uint8_t  protoMask;    // bit per ProtoId, runtime enable
     RelayConfig relays[NUM_RELAYS];
+    uint32_t eolCycles;    // end-of-life alert per relay, 0 = off
 
     // WiFi credentials used in main.cpp
     char ssid[32];
     char pass[32];
+
+    // Remote syslog collector (empty host = Serial only)
+    char     logHost[32];
+    uint16_t logPort;
+    uint8_t  logLevel;     // LogLevel value, messages above it are discarded
+
+    // MQTT broker (empty host = off), see mqtt_bridge.h
+    char     mqttHost[32];
+    uint16_t mqttPort;
+    char     mqttUser[32];
+    char     mqttPass[32];
+    char     mqttTopic[32];    // topic prefix, empty = hostname
+
+    // Frame acks for latency calibration, see frame_ack.h
+    uint8_t  ackMode;      // FrameAckMode
+    uint8_t  ackEvery;     // ack 1 in N committed frames
+    char     ackHost[16];  // collector IPv4 for FRAME_ACK_COLLECTOR
+
+    // Fan-out gateway, see gateway.h (empty routes = off)
+    char     gwRoutes[1024];
+    uint16_t gwUniverse;       // E1.31 universe at stream channel 1
+    uint16_t gwUniverseSize;   // channels per universe in the stream
+
+    // Channel-to-relay rules (see rules.h), empty = one relay per channel
+    char     rules[192];
 };
 
 extern DeviceConfig cfg;
@@ -0,0 +1,92 @@
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+#include "mem_place.h"
+#include "remote_log.h"
+
+#define MEM_REGIONS_MAX       16
+#define MEM_CAPS_INTERNAL     (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define MEM_CAPS_PSRAM        (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+struct MemRegion {
+    const char *name;
+    size_t      size;
+    bool        psram;
+    bool        degraded;   // wanted PSRAM, got the internal fallback
+    bool        hot;        // read by the packet task (memHotQueue)
+};
+
+static MemRegion g_regions[MEM_REGIONS_MAX];
+static uint8_t   g_regionCount = 0;
+
+static void noteRegion(const char *name, size_t size, bool psram, bool degraded, bool hot)
+{
+    if (g_regionCount >= MEM_REGIONS_MAX) return;
+    g_regions[g_regionCount++] = { name, size, psram, degraded, hot };
+}
+
+void *memPlace(const char *name, uint8_t policy, size_t psramSize,
+               size_t internalSize, size_t *got)
+{
+    void *p = nullptr;
+    if (policy == MEM_PREFER_PSRAM && psramFound()) {
+        p = heap_caps_malloc(psramSize, MEM_CAPS_PSRAM);
+        if (p) {
+            noteRegion(name, psramSize, true, false, false);
+            *got = psramSize;
+            return p;
+        }
+    }
+
+    p = heap_caps_malloc(internalSize, MEM_CAPS_INTERNAL);
+    *got = p ? internalSize : 0;
+    if (!p) {
+        LOGE("[MEM] %s: no memory for %u bytes", name, (unsigned)internalSize);
+        return nullptr;
+    }
+    noteRegion(name, internalSize, false, policy == MEM_PREFER_PSRAM, false);
+    return p;
+}
+
+QueueHandle_t memHotQueue(const char *name, uint32_t depth, uint32_t itemSize)
+{
+    // xQueueCreate() would use malloc(), which may hand out PSRAM once
+    // internal memory runs low.
+    StaticQueue_t *ctl  = (StaticQueue_t *)heap_caps_malloc(sizeof(StaticQueue_t), MEM_CAPS_INTERNAL);
+    uint8_t       *data = (uint8_t *)heap_caps_malloc(depth * itemSize, MEM_CAPS_INTERNAL);
+    if (!ctl || !data) {
+        heap_caps_free(ctl);
+        heap_caps_free(data);
+        LOGE("[MEM] %s: no internal memory for queue", name);
+        return nullptr;
+    }
+    noteRegion(name, sizeof(StaticQueue_t) + depth * itemSize, false, false, true);
+    return xQueueCreateStatic(depth, itemSize, data, ctl);
+}
+
+void memReport()
+{
+    for (uint8_t i = 0; i < g_regionCount; i++) {
+        const MemRegion &r = g_regions[i];
+        LOGI("[MEM] %-10s %6u bytes %-8s %s%s", r.name, (unsigned)r.size,
+             r.psram ? "PSRAM" : "internal", r.hot ? "hot: packet path" : "cold: off the packet path",
+             r.degraded ? " (no PSRAM, reduced)" : "");
+    }
+    LOGI("[MEM] free: internal %u (largest %u), PSRAM %u",
+         (unsigned)heap_caps_get_free_size(MEM_CAPS_INTERNAL),
+         (unsigned)heap_caps_get_largest_free_block(MEM_CAPS_INTERNAL),
+         (unsigned)(psramFound() ? heap_caps_get_free_size(MEM_CAPS_PSRAM) : 0));
+}
+
+void memPrintMetrics(Print &out)
+{
+    for (uint8_t i = 0; i < g_regionCount; i++) {
+        const MemRegion &r = g_regions[i];
+        out.printf("relay_mem_region_bytes{region=\"%s\",tier=\"%s\",path=\"%s\"} %u\n", r.name,
+                   r.psram ? "psram" : "internal", r.hot ? "hot" : "cold", (unsigned)r.size);
+    }
+    out.printf("relay_mem_free_bytes{tier=\"internal\"} %u\n",
+               (unsigned)heap_caps_get_free_size(MEM_CAPS_INTERNAL));
+    out.printf("relay_mem_free_bytes{tier=\"psram\"} %u\n",
+               (unsigned)(psramFound() ? heap_caps_get_free_size(MEM_CAPS_PSRAM) : 0));
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <Arduino.h>
+#include <freertos/queue.h>
+
+class Print;
+
+// ---------- MEMORY PLACEMENT ----------
+//
+// Every large buffer states where it may live. Hot-path memory (patch
+// tables, frame queues, relay state, event rings) is internal SRAM only;
+// statics are there by construction and queues come from memHotQueue().
+// Cold buffers (JSON arena, ...) may go to PSRAM and are sized up there;
+// without PSRAM they fall back to their smaller internal size. Cold
+// buffers are only used from loop(), the web server and other slow tasks,
+// never from the packet task (the JSON arena counts any such use; the
+// discovery reply is rendered from loop() for this reason). Placement is
+// chosen once at boot and never changes.
+//
+// Per-buffer policy is a build flag, e.g. -DJSON_ARENA_PLACE=MEM_INTERNAL.
+// Boards with PSRAM also need -DBOARD_HAS_PSRAM (see platformio.ini).
+//
+
+#define MEM_INTERNAL          0           // internal SRAM only
+#define MEM_PREFER_PSRAM      1           // PSRAM at the big size if present
+
+// Allocate a cold buffer. psramSize is used when placed in PSRAM,
+// internalSize otherwise. *got receives the size actually allocated
+// (0 and nullptr when even the internal allocation failed).
+void *memPlace(const char *name, uint8_t policy, size_t psramSize,
+               size_t internalSize, size_t *got);
+
+// Queue whose storage is guaranteed internal (the packet path reads it).
+QueueHandle_t memHotQueue(const char *name, uint32_t depth, uint32_t itemSize);
+
+// One log line per buffer plus free heap, once setup() is done.
+void memReport();
+
+// Bytes per region and tier, free internal / PSRAM heap.
+void memPrintMetrics(Print &out);
@@ -0,0 +1,228 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <PubSubClient.h>
+#include <atomic>
+
+#include "mqtt_bridge.h"
+#include "event_bus.h"
+#include "main_config.h"
+#include "packet_task.h"
+#include "protocol.h"
+#include "relay_output.h"
+#include "remote_log.h"
+
+#define MQTT_TASK_STACK       4096
+#define MQTT_TASK_PRIO        1           // below the packet task, with the log task
+#define MQTT_TASK_CORE        0
+#define MQTT_POLL_MS          100         // keepalive / inbound, when no events
+#define MQTT_RETRY_MS         5000
+#define MQTT_BUFFER_LEN       256         // one state message or one command
+#define MQTT_SOCKET_TIMEOUT_S 2
+
+static WiFiClient   g_net;
+static PubSubClient g_mqtt(g_net);
+static TaskHandle_t g_task = nullptr;
+static int          g_sub  = -1;
+
+static std::atomic<bool> g_reconfig{true};
+
+// Copied from cfg when (re)connecting, the web handlers may change cfg.
+static char     g_host[sizeof(cfg.mqttHost)];
+static char     g_topic[sizeof(cfg.mqttTopic)];
+static char     g_user[sizeof(cfg.mqttUser)];
+static char     g_pass[sizeof(cfg.mqttPass)];
+static uint16_t g_port = MQTT_DEFAULT_PORT;
+
+static uint32_t g_lastSeq    = 0;
+static bool     g_republish  = false;   // publish state even without an event
+
+static uint32_t g_connects   = 0;
+static uint32_t g_published  = 0;
+static uint32_t g_pubFailed  = 0;
+static uint32_t g_commands   = 0;
+static uint32_t g_rejectShow = 0;       // refused, show data is live
+static uint32_t g_rejectBad  = 0;       // unknown topic / payload, queue full
+
+static void topicFor(char *buf, size_t len, const char *leaf)
+{
+    snprintf(buf, len, "%s/%s", g_topic, leaf);
+}
+
+static int parseOnOff(const uint8_t *p, unsigned len)
+{
+    if (len == 1 && (p[0] == '1' || p[0] == '0')) return p[0] == '1';
+    if (len == 2 && strncasecmp((const char *)p, "ON", 2) == 0)  return 1;
+    if (len == 3 && strncasecmp((const char *)p, "OFF", 3) == 0) return 0;
+    return -1;
+}
+
+static bool queueSet(uint8_t index, bool on)
+{
+    PacketCommand cmd = { PKT_CMD_SET, index, (uint8_t)on, 0, 0, 0, 0 };
+    return packetCommand(cmd);
+}
+
+// <t>/relay/<n>/set or <t>/relays/set; anything else was not subscribed.
+static void mqttMessage(char *topic, uint8_t *payload, unsigned int len)
+{
+    g_commands++;
+    const char *leaf = topic + strlen(g_topic) + 1;
+
+    if (protocolsShowActive()) {
+        g_rejectShow++;
+        g_republish = true;         // put the real state back on the broker
+        LOGD("[MQTT] '%s' ignored, show data is live", topic);
+        return;
+    }
+
+    bool ok = true;
+    if (strncmp(leaf, "relay/", 6) == 0) {
+        char *end = nullptr;
+        long  idx = strtol(leaf + 6, &end, 10);
+        int   on  = parseOnOff(payload, len);
+        ok = end != leaf + 6 && strcmp(end, "/set") == 0 &&
+             idx >= 0 && idx < NUM_RELAYS && on >= 0 &&
+             queueSet((uint8_t)idx, on);
+    } else {
+        // Every relay it names in one command: one commit, one event.
+        PacketCommand cmd = { PKT_CMD_SET_MASK, 0, 0, 0, 0, 0, 0 };
+        ok = relayParseState((const char *)payload, len, cmd.mask, cmd.state) &&
+             packetCommand(cmd);
+    }
+
+    if (!ok) {
+        g_rejectBad++;
+        g_republish = true;
+        LOGW("[MQTT] bad or dropped command on '%s'", topic);
+    }
+}
+
+static bool mqttConnect()
+{
+    char status[sizeof(g_topic) + 8];
+    topicFor(status, sizeof(status), "status");
+
+    g_mqtt.setServer(g_host, g_port);
+    if (!g_mqtt.connect(g_topic, g_user[0] ? g_user : nullptr,
+                        g_user[0] ? g_pass : nullptr,
+                        status, 1, true, "offline")) {
+        LOGW("[MQTT] connect to %s:%u failed (state %d)", g_host, g_port, g_mqtt.state());
+        return false;
+    }
+
+    char sub[sizeof(g_topic) + 16];
+    topicFor(sub, sizeof(sub), "relay/+/set");
+    g_mqtt.subscribe(sub);
+    topicFor(sub, sizeof(sub), "relays/set");
+    g_mqtt.subscribe(sub);
+
+    g_mqtt.publish(status, "online", true);
+    g_connects++;
+    g_republish = true;
+    LOGI("[MQTT] connected to %s:%u as '%s'", g_host, g_port, g_topic);
+    return true;
+}
+
+static void loadSettings()
+{
+    if (g_mqtt.connected()) {
+        char status[sizeof(g_topic) + 8];
+        topicFor(status, sizeof(status), "status");
+        g_mqtt.publish(status, "offline", true);
+        g_mqtt.disconnect();
+    }
+
+    strlcpy(g_host, cfg.mqttHost, sizeof(g_host));
+    strlcpy(g_user, cfg.mqttUser, sizeof(g_user));
+    strlcpy(g_pass, cfg.mqttPass, sizeof(g_pass));
+    g_port = cfg.mqttPort ? cfg.mqttPort : MQTT_DEFAULT_PORT;
+    if (cfg.mqttTopic[0]) {
+        strlcpy(g_topic, cfg.mqttTopic, sizeof(g_topic));
+    } else {
+        const char *host = WiFi.getHostname();
+        strlcpy(g_topic, host ? host : "esp32-relay", sizeof(g_topic));
+    }
+}
+
+// Newest state only: every event carries the full state, so a backlog
+// collapses into one retained message.
+static void publishState(bool connected)
+{
+    RelayEvent ev, last;
+    bool any = false;
+    while (eventBusPoll(g_sub, ev)) {
+        last = ev;
+        any  = true;
+    }
+    if (any) g_lastSeq = last.seq;
+    if (!connected || !(any || g_republish)) return;
+
+    if (!any) last = { g_lastSeq, (uint32_t)millis(), 0, relayStateMask() };
+
+    char topic[sizeof(g_topic) + 8];
+    char msg[EVENT_FORMAT_LEN];
+    topicFor(topic, sizeof(topic), "state");
+    size_t len = eventBusFormat(last, msg, sizeof(msg));
+    if (g_mqtt.publish(topic, (const uint8_t *)msg, len, true)) {
+        g_published++;
+        g_republish = false;
+    } else {
+        g_pubFailed++;
+        g_republish = true;
+    }
+}
+
+static void mqttTask(void *)
+{
+    uint32_t lastTry = 0;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_POLL_MS));
+
+        if (g_reconfig.exchange(false)) {
+            loadSettings();
+            lastTry = 0;
+        }
+
+        bool up = g_host[0] && WiFi.status() == WL_CONNECTED;
+        if (up && !g_mqtt.connected()) {
+            if (!lastTry || millis() - lastTry >= MQTT_RETRY_MS) {
+                lastTry = millis();
+                mqttConnect();
+            }
+        }
+
+        bool connected = up && g_mqtt.connected();
+        if (connected) g_mqtt.loop();
+        publishState(connected);        // drains the bus either way
+    }
+}
+
+void mqttReconfigure()
+{
+    g_reconfig.store(true);
+    TaskHandle_t t = g_task;
+    if (t) xTaskNotifyGive(t);
+}
+
+void startMqtt()
+{
+    if (g_task) return;
+    g_mqtt.setBufferSize(MQTT_BUFFER_LEN);
+    g_mqtt.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+    g_mqtt.setCallback(mqttMessage);
+    xTaskCreatePinnedToCore(mqttTask, "mqtt", MQTT_TASK_STACK, nullptr,
+                            MQTT_TASK_PRIO, &g_task, MQTT_TASK_CORE);
+    g_sub = eventBusSubscribe("mqtt", g_task);
+}
+
+void mqttPrintMetrics(Print &out)
+{
+    out.printf("relay_mqtt_connected %u\n", (unsigned)g_mqtt.connected());
+    out.printf("relay_mqtt_connects_total %u\n", (unsigned)g_connects);
+    out.printf("relay_mqtt_published_total %u\n", (unsigned)g_published);
+    out.printf("relay_mqtt_publish_failed_total %u\n", (unsigned)g_pubFailed);
+    out.printf("relay_mqtt_commands_total %u\n", (unsigned)g_commands);
+    out.printf("relay_mqtt_commands_rejected_total{reason=\"show\"} %u\n", (unsigned)g_rejectShow);
+    out.printf("relay_mqtt_commands_rejected_total{reason=\"invalid\"} %u\n", (unsigned)g_rejectBad);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// ---------- MQTT ----------
+//
+// Relays for building automation. Topics under cfg.mqttTopic (default:
+// the hostname):
+//
+//   <t>/status           "online" / "offline" (retained, last will)
+//   <t>/state            {"seq":N,"state":"0110..."} (retained), one
+//                        message per commit, newest only if we fall behind
+//   <t>/relay/<n>/set    "1"/"0"/"ON"/"OFF", n = relay index from 0
+//   <t>/relays/set       "ON"/"OFF", or one '0'/'1' per relay ('-' = leave)
+//
+// Runs in its own low-priority task on core 0 and reads relay changes
+// from the event bus, so the packet path never waits for the broker.
+// Commands are refused while show data is live (protocolsShowActive()).
+// Empty cfg.mqttHost = disabled. Try it against a local broker with
+//   mosquitto_sub -v -t '<t>/#'   and   mosquitto_pub -t <t>/relay/0/set -m 1
+//
+
+#define MQTT_DEFAULT_PORT     1883
+
+void startMqtt();
+
+// Broker settings in cfg changed: drop the connection and reconnect.
+void mqttReconfigure();
+
+// Connection state plus published / command counters.
+void mqttPrintMetrics(Print &out);
@@ -0,0 +1,171 @@
+#include <Arduino.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+#include "packet_task.h"
+#include "config_schema.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "protocol.h"
+#include "relay_output.h"
+#include "relay_stats.h"
+#include "scenes.h"
+#include "test_pattern.h"
+#include "timer_wheel.h"
+#include "remote_log.h"
+
+#define PKT_TASK_STACK        4096
+#define PKT_TASK_PRIO         3           // above loop() and the log task
+#define PKT_TASK_CORE         1           // lwIP/WiFi live on core 0
+#define PKT_CMD_DEPTH         32          // bulk changes are one mask command
+
+// Nothing timed pending: wake this often anyway for the receive timeout.
+#define PKT_IDLE_WAIT_MS      250
+
+static TaskHandle_t  g_pktTask  = nullptr;
+static QueueHandle_t g_cmdQueue = nullptr;
+
+// One config hand-over at a time (g_adoptLock), done when g_adoptDone.
+static StaticSemaphore_t   g_adoptLockBuf, g_adoptDoneBuf;
+static SemaphoreHandle_t   g_adoptLock = nullptr;
+static SemaphoreHandle_t   g_adoptDone = nullptr;
+static const DeviceConfig *g_adoptBase = nullptr;
+static const DeviceConfig *g_adoptNext = nullptr;
+
+static uint32_t g_wakeFrame    = 0;
+static uint32_t g_wakeCommand  = 0;
+static uint32_t g_wakeReconfig = 0;
+static uint32_t g_wakeTimer    = 0;
+static uint32_t g_cmdDropped   = 0;
+
+void packetNotify(uint32_t bits)
+{
+    TaskHandle_t t = g_pktTask;
+    if (t) xTaskNotify(t, bits, eSetBits);
+}
+
+bool packetCommand(const PacketCommand &cmd)
+{
+    if (!g_cmdQueue || xQueueSend(g_cmdQueue, &cmd, 0) != pdTRUE) {
+        g_cmdDropped++;
+        return false;
+    }
+    packetNotify(PKT_EV_COMMAND);
+    return true;
+}
+
+bool packetAdoptConfig(const DeviceConfig &base, const DeviceConfig &next)
+{
+    if (!g_pktTask) {
+        configMerge(cfg, base, next);
+        return true;
+    }
+
+    xSemaphoreTake(g_adoptLock, portMAX_DELAY);
+    g_adoptBase = &base;
+    g_adoptNext = &next;
+    PacketCommand cmd = { PKT_CMD_CONFIG, 0, 0, 0, 0, 0, 0 };
+    bool ok = packetCommand(cmd);
+    if (ok) xSemaphoreTake(g_adoptDone, portMAX_DELAY);
+    g_adoptBase = g_adoptNext = nullptr;
+    xSemaphoreGive(g_adoptLock);
+    return ok;
+}
+
+static void runCommand(const PacketCommand &cmd)
+{
+    switch (cmd.type) {
+    case PKT_CMD_SET:
+        setRelay(cmd.index, cmd.value);
+        break;
+    case PKT_CMD_SET_MASK:
+        setRelays(cmd.mask, cmd.state);
+        break;
+    case PKT_CMD_REFRESH:
+        refreshRelays(cmd.mask);
+        break;
+    case PKT_CMD_TEST:
+        if (!testPatternStart((TestPattern)cmd.value, cmd.stepMs, cmd.arg)) {
+            LOGW("[TEST] %s: nothing to test", testPatternName((TestPattern)cmd.value));
+        }
+        break;
+    case PKT_CMD_TEST_STOP:
+        testPatternStop();
+        break;
+    case PKT_CMD_SCENE:
+        sceneApply(cmd.index);
+        break;
+    case PKT_CMD_STATS_RESET:
+        relayStatsReset(cmd.index);
+        break;
+    case PKT_CMD_CONFIG:
+        configMerge(cfg, *g_adoptBase, *g_adoptNext);
+        xSemaphoreGive(g_adoptDone);
+        break;
+    }
+}
+
+// Timed work only needs a short sleep while something is actually timed.
+static TickType_t nextWait()
+{
+    if (relayOutputBusy() || testPatternRunning()) return pdMS_TO_TICKS(WHEEL_TICK_MS);
+    return pdMS_TO_TICKS(PKT_IDLE_WAIT_MS);
+}
+
+static void packetTask(void *)
+{
+    uint32_t bits = PKT_EV_FRAME | PKT_EV_RECONFIG | PKT_EV_COMMAND;
+
+    for (;;) {
+        if (bits & PKT_EV_RECONFIG) {
+            g_wakeReconfig++;
+            patchService();                 // between frames, never during one
+        }
+        if (bits & PKT_EV_COMMAND) {
+            g_wakeCommand++;
+            PacketCommand cmd;
+            while (xQueueReceive(g_cmdQueue, &cmd, 0) == pdTRUE) runCommand(cmd);
+        }
+        if (bits & PKT_EV_FRAME) {
+            g_wakeFrame++;
+            protocolsPoll();
+        }
+        if (!bits) g_wakeTimer++;
+
+        testPatternTick();
+        relayOutputTick();
+        protocolsCheckTimeout();
+
+        bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, nextWait());
+    }
+}
+
+void startPacketTask()
+{
+    if (g_pktTask) return;
+    g_cmdQueue  = memHotQueue("pkt_cmd", PKT_CMD_DEPTH, sizeof(PacketCommand));
+    g_adoptLock = xSemaphoreCreateMutexStatic(&g_adoptLockBuf);
+    g_adoptDone = xSemaphoreCreateBinaryStatic(&g_adoptDoneBuf);
+    xTaskCreatePinnedToCore(packetTask, "pkt", PKT_TASK_STACK, nullptr,
+                            PKT_TASK_PRIO, &g_pktTask, PKT_TASK_CORE);
+}
+
+bool packetTaskIsCurrent()
+{
+    return g_pktTask && xTaskGetCurrentTaskHandle() == g_pktTask;
+}
+
+bool packetTaskRunning()
+{
+    return g_pktTask != nullptr;
+}
+
+void packetPrintMetrics(Print &out)
+{
+    out.printf("relay_pkt_wakeups_total{reason=\"frame\"} %u\n", (unsigned)g_wakeFrame);
+    out.printf("relay_pkt_wakeups_total{reason=\"command\"} %u\n", (unsigned)g_wakeCommand);
+    out.printf("relay_pkt_wakeups_total{reason=\"reconfig\"} %u\n", (unsigned)g_wakeReconfig);
+    out.printf("relay_pkt_wakeups_total{reason=\"timer\"} %u\n", (unsigned)g_wakeTimer);
+    out.printf("relay_pkt_commands_dropped_total %u\n", (unsigned)g_cmdDropped);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+
+#include "main_config.h"
+
+class Print;
+
+// ---------- PACKET TASK ----------
+//
+// The relay path runs in one task that sleeps until there is work: socket
+// callbacks, the web server and the control port post notification bits
+// (and commands) instead of the task polling every socket each millisecond.
+// Everything that stages or commits relays runs here, so the output path
+// has a single owner.
+//
+
+#define PKT_EV_FRAME          (1u << 0)   // a protocol queued an RxFrame
+#define PKT_EV_RECONFIG       (1u << 1)   // requestReconfigure() was called
+#define PKT_EV_COMMAND        (1u << 2)   // a PacketCommand is queued
+
+enum PacketCmdType : uint8_t {
+    PKT_CMD_SET,            // index, value
+    PKT_CMD_SET_MASK,       // mask, state: every relay in mask, one commit
+    PKT_CMD_REFRESH,        // mask: re-send state (GPIO remap)
+    PKT_CMD_TEST,           // value = TestPattern, stepMs, arg
+    PKT_CMD_TEST_STOP,
+    PKT_CMD_SCENE,          // index = scene number
+    PKT_CMD_CONFIG,         // adopt the edit packetAdoptConfig() handed over
+    PKT_CMD_STATS_RESET,    // index = relay, NUM_RELAYS = all
+};
+
+struct PacketCommand {
+    uint8_t  type;          // PacketCmdType
+    uint8_t  index;
+    uint8_t  value;
+    uint8_t  arg;
+    uint16_t stepMs;
+    RelayMask mask;
+    RelayMask state;
+};
+
+// Create the task (after protocols, patch and relays are up).
+void startPacketTask();
+
+// Wake the packet task with PKT_EV_* bits; any task, never blocks.
+// A no-op until the task exists (it does a full pass when it starts).
+void packetNotify(uint32_t bits);
+
+// Hand a relay/test command to the packet task. false = queue full.
+bool packetCommand(const PacketCommand &cmd);
+
+// cfg is read on every frame, so only the packet task writes it: other
+// tasks edit a copy (base = cfg when the edit started) and hand it over
+// here. The packet task merges the changed fields into cfg between
+// frames (configMerge); this blocks until it has. Before the task exists
+// the merge happens in place. false = command queue full, cfg unchanged.
+bool packetAdoptConfig(const DeviceConfig &base, const DeviceConfig &next);
+
+// True when called from the packet task (for "never on the relay path"
+// checks in cold code). packetTaskRunning(): the task exists, so its
+// state is no longer touched from setup().
+bool packetTaskIsCurrent();
+bool packetTaskRunning();
+
+// Wakeups by reason, commands.
+void packetPrintMetrics(Print &out);
@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <atomic>
+
+#include "patch.h"
+#include "main_config.h"
+#include "discovery.h"
+#include "packet_task.h"
+#include "protocol.h"
+#include "remote_log.h"
+
+// Readers on other tasks (UDP callbacks on core 0, loop()) take a
+// reference to the live slot and use it for one packet or one render.
+// After a swap the old slot is left alone for PATCH_GRACE_MS before it is
+// rebuilt, so a reader that started just before the swap finishes first.
+#define PATCH_GRACE_MS        50
+
+static Patch g_patchSlots[2];
+static uint8_t g_liveSlot = 0;
+static uint32_t g_swapMs  = 0;
+static bool     g_swapped = false;
+
+const Patch *volatile g_activePatch = &g_patchSlots[0];
+
+static std::atomic<bool> g_reconfigPending{false};
+
+// (cfg.universe it replaces << 16) | universe, 0 = none
+static std::atomic<uint32_t> g_universeOverride{0};
+
+static const char *const POLICY_NAMES[RELAY_POLICY_COUNT] = {
+    "newest", "bind", "priority", "htp"
+};
+
+const char *relayPolicyName(uint8_t policy)
+{
+    return policy < RELAY_POLICY_COUNT ? POLICY_NAMES[policy] : "?";
+}
+
+int relayPolicyFromName(const char *name)
+{
+    for (uint8_t i = 0; i < RELAY_POLICY_COUNT; i++) {
+        if (strcasecmp(name, POLICY_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static void buildPatch(Patch &p)
+{
+    static uint32_t generation = 0;
+    p.generation = ++generation;
+    uint32_t over = g_universeOverride.load(std::memory_order_acquire);
+    p.universe  = (over && (over >> 16) == cfg.universe) ? (uint16_t)over : cfg.universe;
+    p.startChan = cfg.startChan ? cfg.startChan : 1;
+
+    memset(p.direct, 0, sizeof(p.direct));
+    memset(p.preferred, 0, sizeof(p.preferred));
+    p.priority = p.htp = 0;
+
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        const RelayConfig &rc = cfg.relays[i];
+        RelayMask bit = (RelayMask)1 << i;
+        bool bound    = rc.source < PROTO_COUNT;
+
+        uint8_t policy = rc.policy;
+        if (policy == RELAY_PRIORITY && !bound) policy = RELAY_NEWEST;
+
+        switch (policy) {
+        case RELAY_BIND:
+            if (bound) p.direct[rc.source] |= bit;     // unbound = never driven
+            break;
+        case RELAY_PRIORITY:
+            p.direct[rc.source]    |= bit;
+            p.preferred[rc.source] |= bit;
+            p.priority             |= bit;
+            break;
+        case RELAY_HTP:
+            p.htp |= bit;
+            break;
+        default:                                       // RELAY_NEWEST
+            for (uint8_t id = 0; id < PROTO_COUNT; id++) p.direct[id] |= bit;
+            break;
+        }
+    }
+
+    // cfg.rules was validated when it was set; a bad one from NVS just
+    // leaves every relay on its own channel.
+    char err[48];
+    if (!rulesCompile(cfg.rules, p.rules, err, sizeof(err))) {
+        LOGE("[PATCH] rules ignored, %s", err);
+    }
+}
+
+void startPatch()
+{
+    buildPatch(g_patchSlots[g_liveSlot]);
+    g_activePatch = &g_patchSlots[g_liveSlot];
+}
+
+void requestReconfigure()
+{
+    g_reconfigPending.store(true, std::memory_order_release);
+    packetNotify(PKT_EV_RECONFIG);
+}
+
+void patchOverrideUniverse(uint16_t from, uint16_t universe)
+{
+    g_universeOverride.store(universe ? ((uint32_t)from << 16) | universe : 0,
+                             std::memory_order_release);
+    requestReconfigure();
+}
+
+void patchService()
+{
+    if (!g_reconfigPending.exchange(false, std::memory_order_acquire)) return;
+
+    uint16_t oldUniverse = activePatch().universe;
+    uint16_t oldStart    = activePatch().startChan;
+
+    // 1) complete new table in the spare slot, then one pointer swap; the
+    //    spare may still have readers from the last swap (back-to-back
+    //    reconfigurations, e.g. a new IP and a web edit)
+    uint32_t since = millis() - g_swapMs;
+    if (g_swapped && since < PATCH_GRACE_MS) vTaskDelay(pdMS_TO_TICKS(PATCH_GRACE_MS - since) + 1);
+
+    uint8_t spare = g_liveSlot ^ 1;
+    buildPatch(g_patchSlots[spare]);
+    g_activePatch = &g_patchSlots[spare];
+    g_liveSlot    = spare;
+    g_swapMs      = millis();
+    g_swapped     = true;
+
+    // 2) receivers follow: open/close per protocol mask, then multicast
+    //    membership and cached poll replies for the ones left open
+    protocolsApply(cfg.protoMask);
+    protocolsReconfigure();
+
+    // 3) discovery answers with the new patch once loop() re-renders it
+    discoveryRebuildReply();
+
+    const Patch &now = activePatch();
+    LOGI("[PATCH] universe %u -> %u, start channel %u -> %u",
+         oldUniverse, now.universe, oldStart, now.startChan);
+}
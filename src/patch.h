@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+
+#include "main_config.h"
+#include "protocol.h"
+#include "rules.h"
+
+// The compiled patch the decoders work from. Built from cfg, never edited
+// in place: a reconfiguration builds a complete new table in the spare slot
+// and swaps the pointer between two frames.
+struct Patch {
+    uint16_t universe;      // Art-Net port-address / E1.31 universe
+    uint16_t startChan;     // 1-based first slot we consume
+    uint32_t generation;    // bumped on every rebuild
+
+    // Per-relay bindings compiled into dispatch masks, indexed by ProtoId.
+    // A frame from protocol p writes `direct[p]` straight through; the
+    // other masks need the arbitration state kept in protocol.cpp.
+    RelayMask direct[PROTO_COUNT];      // BIND/PRIORITY to p, and NEWEST
+    RelayMask preferred[PROTO_COUNT];   // PRIORITY relays whose source is p
+    RelayMask priority;                 // every PRIORITY relay
+    RelayMask htp;                      // every HTP relay
+
+    RuleProgram rules;                  // compiled cfg.rules
+};
+
+extern const Patch *volatile g_activePatch;
+
+inline const Patch &activePatch()
+{
+    return *g_activePatch;
+}
+
+// RelayPolicy <-> API name ("newest", "bind", "priority", "htp").
+const char *relayPolicyName(uint8_t policy);
+int relayPolicyFromName(const char *name);          // -1 if unknown
+
+// Build the first table from cfg (call after loadCfg()).
+void startPatch();
+
+// cfg changed (any task): rebuild and apply before the next frame.
+void requestReconfigure();
+
+// Runtime-only universe (E1.31 auto-join, any task): patch `universe`
+// instead of cfg.universe for as long as cfg.universe is still `from`.
+// Never written to cfg, so never saved; a configured universe change ends
+// it. universe 0 = none.
+void patchOverrideUniverse(uint16_t from, uint16_t universe);
+
+// Packet task: apply a pending reconfiguration. Cheap when nothing's pending.
+void patchService();
@@ -0,0 +1,203 @@
+#include "protocol.h"
+#if RELAY_PROTO_ARTNET
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncUDP.h>
+
+#include "main_config.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "remote_log.h"
+#include "scenes.h"
+
+#define ARTNET_ARTPOLLREPLY   0x2100
+#define ARTPOLLREPLY_LEN      239
+#define ARTNET_ARTCOMMAND     0x2400
+#define ARTNET_ARTTRIGGER     0x9900
+
+// ArtTrigger: OEM code 14-15 (0xFFFF = everyone; ours is 0), Key, SubKey
+#define ARTTRIGGER_KEY        16
+#define ARTTRIGGER_SUBKEY     17
+#define ARTTRIGGER_KEY_MACRO  1
+#define ARTTRIGGER_KEY_SHOW   3
+// ArtCommand: ESTA code 12-13 (0xFFFF = everyone), length 14-15, text
+#define ARTCOMMAND_TEXT       16
+
+static AsyncUDP      aUDP;
+static QueueHandle_t g_queue = nullptr;
+static ProtocolStats g_stats;
+
+// Prebuilt ArtPollReply, rebuilt when the patch or address changes.
+static uint8_t g_pollReply[ARTPOLLREPLY_LEN];
+
+static void buildPollReply()
+{
+    const Patch &patch = activePatch();
+    uint8_t *r = g_pollReply;
+    memset(r, 0, sizeof(g_pollReply));
+
+    memcpy(r, "Art-Net", 8);
+    r[8]  = ARTNET_ARTPOLLREPLY & 0xFF;             // opcode, lo byte first
+    r[9]  = ARTNET_ARTPOLLREPLY >> 8;
+
+    IPAddress ip = WiFi.localIP();
+    for (uint8_t i = 0; i < 4; i++) r[10 + i] = ip[i];
+    r[14] = ARTNET_PORT & 0xFF;
+    r[15] = ARTNET_PORT >> 8;
+
+    r[18] = (patch.universe >> 8) & 0x7F;           // NetSwitch
+    r[19] = (patch.universe >> 4) & 0x0F;           // SubSwitch
+    r[23] = 0xD0;                                   // Status1: normal, port-address by network
+
+    const char *host = WiFi.getHostname() ? WiFi.getHostname() : "esp32-relay";
+    strncpy((char *)r + 26, host, 17);                          // ShortName
+    snprintf((char *)r + 44, 64, "ESP32 Relay Controller (%u relays)", NUM_RELAYS);
+    snprintf((char *)r + 108, 64, "#0001 [0000] start channel %u", patch.startChan);
+
+    r[173] = 1;                                     // NumPorts (lo)
+    r[174] = 0x80;                                  // PortTypes[0]: output, DMX512
+    r[182] = 0x80;                                  // GoodOutput[0]: data
+    r[190] = patch.universe & 0x0F;                 // SwOut[0]
+    r[200] = 0x00;                                  // Style: StNode
+
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    memcpy(r + 201, mac, 6);
+    for (uint8_t i = 0; i < 4; i++) r[207 + i] = ip[i];   // BindIp
+    r[211] = 1;                                     // BindIndex
+    r[212] = 0x08;                                  // Status2: 15-bit port-address
+}
+
+// ArtNet opcode, 0 if this isn't an Art-Net packet
+static int artNetOpCode(const uint8_t *pbuff, size_t len)
+{
+    if (len < 12 || memcmp(pbuff, "Art-Net", 8) != 0) return 0;
+    if (pbuff[11] >= 14) {
+        return pbuff[9] * 256 + pbuff[8];  // lo byte first
+    }
+    return 0;
+}
+
+// ArtDMX header → our channel window, straight from the packet payload
+static bool artDMXReceived(AsyncUDPPacket &packet, const uint8_t *pbuff, size_t len)
+{
+    if (len <= ARTNET_START_ADDRESS) return false;
+
+    // 15-bit port-address: Net (byte 15) + SubUni (byte 14)
+    const Patch &patch = activePatch();
+    uint16_t portAddr = ((uint16_t)(pbuff[15] & 0x7F) << 8) | pbuff[14];
+    if (portAddr != patch.universe) return false;
+
+    uint32_t dataLen = ((uint32_t)pbuff[16] << 8) | pbuff[17];
+    if (ARTNET_START_ADDRESS + dataLen > len) {
+        dataLen = len - ARTNET_START_ADDRESS;
+    }
+
+    RxFrame f;
+    f.proto    = PROTO_ARTNET;
+    f.flags    = 0;
+    f.seq      = pbuff[12];
+    f.rxMicros = micros();
+    f.srcIp    = (uint32_t)packet.remoteIP();
+    if (!protocolExtractWindow(f, patch.startChan - 1, 0,
+                               pbuff + ARTNET_START_ADDRESS, dataLen)) {
+        return false;
+    }
+
+    protocolCountSeq(g_stats, f.seq, 255, true);
+    protocolQueueFrame(g_queue, f, g_stats);
+    return true;
+}
+
+// Cue recall without DMX: ArtTrigger macro/show n, ArtCommand "Scene=n&".
+static bool artTriggerReceived(const uint8_t *pbuff, size_t len)
+{
+    if (len <= ARTTRIGGER_SUBKEY) return false;
+    uint16_t oem = ((uint16_t)pbuff[14] << 8) | pbuff[15];
+    uint8_t  key = pbuff[ARTTRIGGER_KEY];
+    if ((oem != 0xFFFF && oem != 0) ||
+        (key != ARTTRIGGER_KEY_MACRO && key != ARTTRIGGER_KEY_SHOW)) {
+        return false;
+    }
+    return sceneRecall(pbuff[ARTTRIGGER_SUBKEY]);
+}
+
+static bool artCommandReceived(const uint8_t *pbuff, size_t len)
+{
+    if (len <= ARTCOMMAND_TEXT) return false;
+    uint16_t esta = ((uint16_t)pbuff[12] << 8) | pbuff[13];
+    if (esta != 0xFFFF && esta != 0) return false;
+
+    char text[128];
+    size_t n = ((size_t)pbuff[14] << 8) | pbuff[15];
+    if (n > len - ARTCOMMAND_TEXT) n = len - ARTCOMMAND_TEXT;
+    if (n > sizeof(text) - 1)      n = sizeof(text) - 1;
+    memcpy(text, pbuff + ARTCOMMAND_TEXT, n);
+    text[n] = '\0';
+
+    bool  any  = false;
+    char *save = nullptr;
+    for (char *cmd = strtok_r(text, "&", &save); cmd; cmd = strtok_r(nullptr, "&", &save)) {
+        char *eq = strchr(cmd, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        if (strcasecmp(cmd, "Scene") == 0) any |= sceneRecall(sceneFind(eq + 1));
+    }
+    return any;
+}
+
+static void artnetPacket(AsyncUDPPacket &packet)
+{
+    const uint8_t *buf = packet.data();
+    size_t len = packet.length();
+    g_stats.bytes += len;
+
+    int opcode = artNetOpCode(buf, len);
+    if (opcode == ARTNET_ARTPOLL) {
+        aUDP.writeTo(g_pollReply, sizeof(g_pollReply), packet.remoteIP(), ARTNET_PORT);
+        return;
+    }
+    if (opcode == ARTNET_ARTTRIGGER) {
+        if (!artTriggerReceived(buf, len)) g_stats.ignored++;
+        return;
+    }
+    if (opcode == ARTNET_ARTCOMMAND) {
+        if (!artCommandReceived(buf, len)) g_stats.ignored++;
+        return;
+    }
+    if (opcode != ARTNET_ARTDMX || !artDMXReceived(packet, buf, len)) {
+        g_stats.ignored++;
+    }
+}
+
+static bool artnetOpen()
+{
+    buildPollReply();
+    if (!g_queue) g_queue = memHotQueue("rx_artnet", RX_QUEUE_DEPTH, sizeof(RxFrame));
+    if (!g_queue || !aUDP.listen(ARTNET_PORT)) return false;
+    aUDP.onPacket(artnetPacket);
+    return true;
+}
+
+static void artnetClose()
+{
+    aUDP.close();
+}
+
+static void artnetReceive()
+{
+    protocolDrainFrames(g_queue, g_stats);
+}
+
+static const ProtocolStats &artnetStats()
+{
+    return g_stats;
+}
+
+extern const ProtocolModule artnetModule = {
+    PROTO_ARTNET, "artnet", "Art-Net", ARTNET_PORT, "UDP",
+    artnetOpen, artnetClose, artnetReceive, artnetStats, buildPollReply,
+};
+
+#endif // RELAY_PROTO_ARTNET
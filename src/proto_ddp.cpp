@@ -0,0 +1,110 @@
+#include "protocol.h"
+#if RELAY_PROTO_DDP
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#include "gateway.h"
+#include "main_config.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "remote_log.h"
+
+// Header (DDP v1): flags, sequence, data type, destination id,
+// 32-bit offset, 16-bit length, [32-bit timecode], data
+#define DDP_FLAGS_VER_MASK    0xC0
+#define DDP_FLAGS_VER1        0x40
+#define DDP_FLAGS_TIMECODE    0x10
+#define DDP_FLAGS_PUSH        0x01
+#define DDP_FLAGS_QUERY       0x02
+#define DDP_FLAGS_REPLY       0x04
+#define DDP_ID_DISPLAY        1
+
+static AsyncUDP      ddpUDP;
+static QueueHandle_t g_queue = nullptr;
+static ProtocolStats g_stats;
+
+static inline uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+}
+
+// DDP header → our channel window, straight from the packet payload
+static void ddpPacket(AsyncUDPPacket &packet)
+{
+    uint32_t rxMicros = micros();
+    const uint8_t *buf = packet.data();
+    size_t len = packet.length();
+    g_stats.bytes += len;
+
+    if (len <= DDP_HEADER_LEN ||
+        (buf[0] & DDP_FLAGS_VER_MASK) != DDP_FLAGS_VER1 ||
+        (buf[0] & (DDP_FLAGS_QUERY | DDP_FLAGS_REPLY)) ||
+        buf[3] != DDP_ID_DISPLAY) {
+        g_stats.ignored++;
+        return;
+    }
+
+    size_t hdrLen = DDP_HEADER_LEN + ((buf[0] & DDP_FLAGS_TIMECODE) ? DDP_TIMECODE_LEN : 0);
+    if (len <= hdrLen) {
+        g_stats.ignored++;
+        return;
+    }
+
+    // offset is the byte index of data[0] in the controller's channel space
+    uint32_t offset  = be32(buf + 4);
+    uint32_t dataLen = ((uint32_t)buf[8] << 8) | buf[9];
+    if (hdrLen + dataLen > len) dataLen = len - hdrLen;   // clamp to packet
+
+    // We assume 1 byte per “channel” (no RGB unpacking here).
+    RxFrame f;
+    f.proto    = PROTO_DDP;
+    f.flags    = 0;
+    f.seq      = buf[1] & 0x0F;
+    f.rxMicros = rxMicros;
+    f.srcIp    = (uint32_t)packet.remoteIP();
+    if (protocolExtractWindow(f, activePatch().startChan - 1, offset,
+                              buf + hdrLen, dataLen)) {
+        protocolCountSeq(g_stats, f.seq, 15, true);
+        protocolQueueFrame(g_queue, f, g_stats);
+    } else {
+        g_stats.ignored++;          // valid packet, just not our channels
+    }
+
+#if RELAY_GATEWAY
+    // Our frame is queued first: the sends below must not delay it.
+    gatewayIngest(offset, buf + hdrLen, dataLen);
+    if (buf[0] & DDP_FLAGS_PUSH) gatewayPush();
+#endif
+}
+
+static bool ddpOpen()
+{
+    if (!g_queue) g_queue = memHotQueue("rx_ddp", RX_QUEUE_DEPTH, sizeof(RxFrame));
+    if (!g_queue || !ddpUDP.listen(DDP_PORT)) return false;
+    ddpUDP.onPacket(ddpPacket);
+    return true;
+}
+
+static void ddpClose()
+{
+    ddpUDP.close();
+}
+
+static void ddpReceive()
+{
+    protocolDrainFrames(g_queue, g_stats);
+}
+
+static const ProtocolStats &ddpStats()
+{
+    return g_stats;
+}
+
+extern const ProtocolModule ddpModule = {
+    PROTO_DDP, "ddp", "DDP", DDP_PORT, "UDP",
+    ddpOpen, ddpClose, ddpReceive, ddpStats, nullptr,
+};
+
+#endif // RELAY_PROTO_DDP
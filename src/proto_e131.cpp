@@ -0,0 +1,559 @@
+#include "protocol.h"
+#if RELAY_PROTO_E131
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <AsyncUDP.h>
+#include <lwip/igmp.h>
+#include <lwip/tcpip.h>
+#include <esp_timer.h>
+
+#include "gateway.h"
+#include "main_config.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "remote_log.h"
+
+// Header offsets (ANSI E1.31-2018, data packet)
+#define E131_ROOT_VECTOR      18          // 32-bit, 0x00000004 = data
+#define E131_CID              22          // 16 byte sender id
+#define E131_FRAME_VECTOR     40          // 32-bit, 0x00000002 = data
+#define E131_PRIORITY         108
+#define E131_SEQUENCE         111
+#define E131_OPTIONS          112
+#define E131_UNIVERSE         113         // 16-bit big-endian
+#define E131_PROP_COUNT       123         // 16-bit, includes start code
+#define E131_START_CODE       125
+
+#define E131_OPT_PREVIEW      0x80        // visualiser data, not for output
+#define E131_OPT_TERMINATED   0x40        // sender is ending this stream
+
+#define E131_SC_DMX           0x00        // null start code: levels
+#define E131_SC_PRIORITY      0xDD        // per-address priority
+
+// Universe discovery (E1.31-2018 section 8): same root layer, then
+#define E131_ROOT_EXTENDED    0x00000008
+#define E131_FRAME_DISCOVERY  0x00000002
+#define E131_DISC_LAYER       112         // discovery layer flags+length
+#define E131_DISC_VECTOR      114         // 0x00000001 = universe list
+#define E131_DISC_PAGE        118
+#define E131_DISC_LAST_PAGE   119
+#define E131_DISC_LIST        120         // 16-bit universes, ascending
+#define E131_DISC_LEN(n)      (E131_DISC_LIST + 2 * (n))
+
+// Sources are merged per address by priority, HTP on ties (E1.31 6.2.3).
+#define E131_MAX_SOURCES      4
+#define E131_SOURCE_LOSS_MS   2500        // E1.31 network data loss timeout
+
+struct E131Source {
+    bool     used;
+    bool     hasLevels;
+    uint8_t  cid[16];
+    uint8_t  priority;                    // from the framing layer
+    uint8_t  lastSeq;
+    uint32_t lastMs;                      // any packet from this source
+    uint32_t papMs;                       // last 0xDD packet, 0 = none
+    uint8_t  level[CHANNEL_WINDOW];
+    uint8_t  pap[CHANNEL_WINDOW];         // per-address priority, 0 = not driven
+};
+
+static AsyncUDP      suUDP;
+static QueueHandle_t g_queue = nullptr;
+static ProtocolStats g_stats;
+static uint16_t      g_joinedUniverse = 0;     // 0 = no group joined
+static uint32_t      g_joinedIp       = 0;     // interface the groups are on
+
+// Only touched from the UDP callback.
+static E131Source    g_sources[E131_MAX_SOURCES];
+
+// ---------- UNIVERSE DISCOVERY ----------
+//
+// Senders announce the universes they transmit on 239.255.250.214 every
+// 10 s. We keep what they offer (to suggest a universe, or with
+// E131_AUTO_JOIN follow the only one on offer) and announce the universe
+// we consume the same way. The announcement is built once per patch
+// change and sent from an esp_timer; the frame path never sees it.
+//
+
+struct E131Offer {
+    uint16_t universe;
+    uint32_t lastMs;
+};
+
+static E131Offer          g_offers[E131_DISC_MAX_UNIVERSES];
+static portMUX_TYPE       g_offerMux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t           g_discReceived = 0;
+
+static uint8_t            g_discPkt[2][E131_DISC_LEN(1)];
+static volatile uint8_t   g_discLive  = 0;
+static esp_timer_handle_t g_discTimer = nullptr;
+static uint32_t           g_discSent  = 0;
+
+static inline uint32_t be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8)  |  (uint32_t)p[3];
+}
+
+static inline uint16_t be16(const uint8_t *p)
+{
+    return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static IPAddress universeGroup(uint16_t universe)
+{
+    return IPAddress(239, 255, (universe >> 8) & 0xFF, universe & 0xFF);
+}
+
+// Group membership is handled here rather than by the socket, so the
+// universe can change while the socket (bound to any address) stays open.
+static bool igmpUniverse(uint16_t universe, bool join)
+{
+    ip4_addr_t ifaddr, group;
+    ifaddr.addr = static_cast<uint32_t>(WiFi.localIP());
+    group.addr  = static_cast<uint32_t>(universeGroup(universe));
+
+#ifdef LOCK_TCPIP_CORE
+    LOCK_TCPIP_CORE();
+#endif
+    err_t err = join ? igmp_joingroup(&ifaddr, &group)
+                     : igmp_leavegroup(&ifaddr, &group);
+#ifdef UNLOCK_TCPIP_CORE
+    UNLOCK_TCPIP_CORE();
+#endif
+    return err == ERR_OK;
+}
+
+static void followUniverse(uint16_t universe)
+{
+    if (universe == g_joinedUniverse) return;
+
+    if (g_joinedUniverse) igmpUniverse(g_joinedUniverse, false);
+    g_joinedUniverse = 0;
+
+    if (igmpUniverse(universe, true)) {
+        g_joinedUniverse = universe;
+        LOGI("E1.31 joined multicast for universe %u", universe);
+    } else {
+        LOGE("E1.31 FAILED to join multicast for universe %u (unicast still works)", universe);
+    }
+}
+
+static E131Source *findSource(const uint8_t *cid, bool create)
+{
+    E131Source *freeSlot = nullptr;
+    for (E131Source &src : g_sources) {
+        if (src.used && memcmp(src.cid, cid, 16) == 0) return &src;
+        if (!src.used && !freeSlot) freeSlot = &src;
+    }
+    if (!create || !freeSlot) return nullptr;
+
+    memset(freeSlot, 0, sizeof(*freeSlot));
+    freeSlot->used = true;
+    memcpy(freeSlot->cid, cid, 16);
+    return freeSlot;
+}
+
+static uint8_t liveSources(uint32_t now)
+{
+    uint8_t n = 0;
+    for (E131Source &src : g_sources) {
+        if (!src.used) continue;
+        if (now - src.lastMs > E131_SOURCE_LOSS_MS) {
+            src.used = false;           // sender vanished without terminating
+            continue;
+        }
+        if (src.hasLevels) n++;
+    }
+    return n;
+}
+
+// Merge every live source into f. Priority per address (0xDD data when
+// fresh, else the packet priority), highest level wins a tie.
+static void mergeSources(RxFrame &f, uint32_t now)
+{
+    f.first = 0;
+    f.count = CHANNEL_WINDOW;
+
+    for (uint16_t c = 0; c < CHANNEL_WINDOW; c++) {
+        int16_t bestPrio  = 0;          // priority 0 at an address = not driven
+        uint8_t bestLevel = 0;
+        for (const E131Source &src : g_sources) {
+            if (!src.used || !src.hasLevels) continue;
+            bool papFresh = src.papMs && now - src.papMs <= E131_SOURCE_LOSS_MS;
+            int16_t prio  = papFresh ? src.pap[c] : src.priority;
+            if (prio == 0) continue;
+            if (prio > bestPrio || (prio == bestPrio && src.level[c] > bestLevel)) {
+                bestPrio  = prio;
+                bestLevel = src.level[c];
+            }
+        }
+        f.data[c] = bestLevel;
+    }
+}
+
+static inline void putBe16(uint8_t *p, uint16_t v)
+{
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+}
+
+static inline void putBe32(uint8_t *p, uint32_t v)
+{
+    putBe16(p, v >> 16);
+    putBe16(p + 2, v & 0xFFFF);
+}
+
+// Flags (0x7) + 12-bit length from this PDU to the end of the packet.
+static inline void putFlagsLen(uint8_t *p, uint16_t len)
+{
+    putBe16(p, 0x7000 | (len & 0x0FFF));
+}
+
+// Announcement for the universe we consume, into the spare buffer.
+static void buildDiscovery(uint16_t universe)
+{
+    uint8_t  spare = g_discLive ^ 1;
+    uint8_t *p     = g_discPkt[spare];
+    const uint16_t len = sizeof(g_discPkt[spare]);
+    memset(p, 0, len);
+
+    // Root layer: preamble, ACN id, extended vector, our CID (from the MAC
+    // so it survives reboots).
+    putBe16(p + 0, 0x0010);
+    memcpy(p + 4, "ASC-E1.17", 9);
+    putFlagsLen(p + 16, len - 16);
+    putBe32(p + E131_ROOT_VECTOR, E131_ROOT_EXTENDED);
+    memcpy(p + E131_CID, "relayctl--", 10);
+    WiFi.macAddress(p + E131_CID + 10);
+
+    // Framing layer: discovery vector, source name
+    putFlagsLen(p + 38, len - 38);
+    putBe32(p + E131_FRAME_VECTOR, E131_FRAME_DISCOVERY);
+    const char *host = WiFi.getHostname() ? WiFi.getHostname() : "esp32-relay";
+    strncpy((char *)p + 44, host, 63);
+
+    // Discovery layer: one page, one universe
+    putFlagsLen(p + E131_DISC_LAYER, len - E131_DISC_LAYER);
+    putBe32(p + E131_DISC_VECTOR, 0x00000001);
+    p[E131_DISC_PAGE]      = 0;
+    p[E131_DISC_LAST_PAGE] = 0;
+    putBe16(p + E131_DISC_LIST, universe);
+
+    g_discLive = spare;
+}
+
+static void sendDiscovery(void *)
+{
+    if (!WiFi.isConnected()) return;
+    const uint8_t *pkt = g_discPkt[g_discLive];
+    if (suUDP.writeTo(pkt, sizeof(g_discPkt[0]), universeGroup(E131_DISC_UNIVERSE), E131_PORT)) {
+        g_discSent++;
+    }
+}
+
+// A sender's universe list (one page of it) from the UDP callback.
+static void noteDiscovery(const uint8_t *buf, size_t len, uint32_t now)
+{
+    if (len < E131_DISC_LIST || be32(buf + E131_DISC_VECTOR) != 0x00000001) {
+        g_stats.ignored++;
+        return;
+    }
+    if (memcmp(buf + E131_CID, g_discPkt[g_discLive] + E131_CID, 16) == 0) return;   // our own
+    g_discReceived++;
+
+    portENTER_CRITICAL(&g_offerMux);
+    for (size_t off = E131_DISC_LIST; off + 2 <= len; off += 2) {
+        uint16_t u = be16(buf + off);
+        E131Offer *slot = nullptr;
+        for (E131Offer &o : g_offers) {
+            if (o.lastMs && o.universe == u) { slot = &o; break; }
+            if (!slot && (!o.lastMs || now - o.lastMs > E131_DISC_EXPIRE_MS)) slot = &o;
+        }
+        if (!slot) break;               // table full, keep what we have
+        slot->universe = u;
+        slot->lastMs   = now ? now : 1;
+    }
+    portEXIT_CRITICAL(&g_offerMux);
+}
+
+uint8_t e131OfferedUniverses(uint16_t *out, uint8_t max)
+{
+    uint32_t now = millis();
+    uint8_t  n   = 0;
+
+    portENTER_CRITICAL(&g_offerMux);
+    for (const E131Offer &o : g_offers) {
+        if (!o.lastMs || now - o.lastMs > E131_DISC_EXPIRE_MS || n >= max) continue;
+        // insertion sort, the list is tiny
+        uint8_t i = n++;
+        while (i > 0 && out[i - 1] > o.universe) {
+            out[i] = out[i - 1];
+            i--;
+        }
+        out[i] = o.universe;
+    }
+    portEXIT_CRITICAL(&g_offerMux);
+    return n;
+}
+
+uint16_t e131SuggestUniverse()
+{
+    uint16_t offered[E131_DISC_MAX_UNIVERSES];
+    uint8_t  n = e131OfferedUniverses(offered, E131_DISC_MAX_UNIVERSES);
+    uint16_t current = activePatch().universe;
+    for (uint8_t i = 0; i < n; i++) {
+        if (offered[i] == current) return current;
+    }
+    return n ? offered[0] : 0;
+}
+
+#if E131_AUTO_JOIN
+// Nothing received on our universe, exactly one universe on offer: follow
+// it. A patch override only, never cfg (this is the esp_timer task, and
+// it must not be saved with the next config change); the UI/API can make
+// it permanent.
+static void autoJoin()
+{
+    uint16_t offered[2];
+    uint16_t current = activePatch().universe;
+    uint32_t quiet   = millis() - g_stats.lastMs;
+    if (g_stats.lastMs && quiet < E131_DISC_EXPIRE_MS) return;
+    if (e131OfferedUniverses(offered, 2) != 1 || offered[0] == current) return;
+
+    LOGW("E1.31: nothing on universe %u, following the only one on offer: %u",
+         current, offered[0]);
+    patchOverrideUniverse(cfg.universe, offered[0]);
+}
+#endif
+
+static void discoveryTick(void *arg)
+{
+    sendDiscovery(arg);
+#if E131_AUTO_JOIN
+    autoJoin();
+#endif
+}
+
+void e131PrintDiscovery(Print &out)
+{
+    uint16_t offered[E131_DISC_MAX_UNIVERSES];
+    out.printf("relay_e131_discovery_sent_total %u\n", (unsigned)g_discSent);
+    out.printf("relay_e131_discovery_received_total %u\n", (unsigned)g_discReceived);
+    out.printf("relay_e131_universes_offered %u\n",
+               (unsigned)e131OfferedUniverses(offered, E131_DISC_MAX_UNIVERSES));
+}
+
+// E1.31 data packet → our channel window, straight from the packet
+// payload. Everything (preview, termination, start code, sequence,
+// priority) is decided from the header before any channel byte is looked
+// at.
+static void e131Relays(AsyncUDPPacket &packet, const uint8_t *buf, size_t len, uint32_t rxMicros)
+{
+    const Patch &patch = activePatch();
+    uint16_t universe  = be16(buf + E131_UNIVERSE);
+    uint8_t  options   = buf[E131_OPTIONS];
+    uint8_t  startCode = buf[E131_START_CODE];
+    uint32_t now       = millis();
+
+    if (universe != patch.universe) {
+        g_stats.ignored++;
+        return;
+    }
+
+    if (options & E131_OPT_PREVIEW) {
+        g_stats.ignored++;
+        return;
+    }
+
+    RxFrame f;
+    f.proto    = PROTO_E131;
+    f.flags    = 0;
+    f.seq      = buf[E131_SEQUENCE];
+    f.rxMicros = rxMicros;
+    f.srcIp    = (uint32_t)packet.remoteIP();
+
+    if (options & E131_OPT_TERMINATED) {
+        E131Source *src = findSource(buf + E131_CID, false);
+        if (!src) return;
+        src->used = false;
+        if (liveSources(now) == 0) {
+            // Last sender gone: failsafe now, not after the receive timeout.
+            f.flags = RX_FRAME_TERMINATED;
+            f.first = f.count = 0;
+        } else {
+            mergeSources(f, now);
+        }
+        protocolQueueFrame(g_queue, f, g_stats);
+        return;
+    }
+
+    if (startCode != E131_SC_DMX && startCode != E131_SC_PRIORITY) {
+        g_stats.ignored++;              // text, SIP, RDM... not channel data
+        return;
+    }
+
+    E131Source *src = findSource(buf + E131_CID, true);
+    if (!src) {
+        g_stats.ignored++;              // more senders than we track
+        return;
+    }
+
+    // Out-of-order within the last 20 packets of this source: discard (6.7.2)
+    int8_t seqDiff = (int8_t)(f.seq - src->lastSeq);
+    if (src->lastMs && seqDiff <= 0 && seqDiff > -20) {
+        g_stats.seqErrors++;
+        return;
+    }
+    if (src->lastMs && seqDiff != 1) g_stats.seqErrors++;
+    src->lastSeq  = f.seq;
+    src->lastMs   = now;
+    src->priority = buf[E131_PRIORITY];
+
+    // property values = start code + slots 1..N; patch.startChan is 1-based
+    uint32_t propCount = be16(buf + E131_PROP_COUNT);
+    if (E131_START_CODE + propCount > len) propCount = len - E131_START_CODE;
+    if (propCount < 2) {
+        g_stats.ignored++;
+        return;
+    }
+
+    RxFrame window;
+    memset(window.data, 0, sizeof(window.data));
+    protocolExtractWindow(window, patch.startChan, 1,
+                          buf + E131_START_ADDRESS, propCount - 1);
+
+    if (startCode == E131_SC_PRIORITY) {
+        memcpy(src->pap, window.data, sizeof(src->pap));
+        src->papMs = now ? now : 1;
+        if (!src->hasLevels) return;    // nothing to re-merge yet
+    } else {
+        memcpy(src->level, window.data, sizeof(src->level));
+        src->hasLevels = true;
+    }
+
+    // Common case: one sender, no per-address priority → straight copy.
+    bool papFresh = src->papMs && now - src->papMs <= E131_SOURCE_LOSS_MS;
+    if (liveSources(now) == 1 && !papFresh) {
+        f.first = 0;
+        f.count = CHANNEL_WINDOW;
+        memcpy(f.data, src->level, sizeof(f.data));
+    } else {
+        mergeSources(f, now);
+    }
+    protocolQueueFrame(g_queue, f, g_stats);
+}
+
+#if RELAY_GATEWAY
+// Levels of any universe to the gateway, through its own per-universe
+// sequence/source filter (our sources table only covers our universe).
+static void e131Forward(const uint8_t *buf, size_t len)
+{
+    uint16_t universe = be16(buf + E131_UNIVERSE);
+    uint8_t  options  = buf[E131_OPTIONS];
+
+    if (options & E131_OPT_PREVIEW) return;
+    if (options & E131_OPT_TERMINATED) {
+        gatewayEndUniverse(universe, buf + E131_CID);
+        return;
+    }
+    if (buf[E131_START_CODE] != E131_SC_DMX) return;
+
+    uint32_t slots = be16(buf + E131_PROP_COUNT);
+    if (E131_START_CODE + slots > len) slots = len - E131_START_CODE;
+    if (slots < 2) return;
+    gatewayIngestUniverse(universe, buf + E131_CID, buf[E131_SEQUENCE], buf[E131_PRIORITY],
+                          buf + E131_START_ADDRESS, slots - 1);
+}
+#endif
+
+static void e131Packet(AsyncUDPPacket &packet)
+{
+    uint32_t rxMicros = micros();
+    const uint8_t *buf = packet.data();
+    size_t len = packet.length();
+    g_stats.bytes += len;
+
+    if (len > E131_DISC_LIST && memcmp(buf + 4, "ASC-E1.17", 9) == 0 &&
+        be32(buf + E131_ROOT_VECTOR)  == E131_ROOT_EXTENDED &&
+        be32(buf + E131_FRAME_VECTOR) == E131_FRAME_DISCOVERY) {
+        noteDiscovery(buf, len, millis());
+        return;
+    }
+    if (len <= E131_START_ADDRESS ||
+        memcmp(buf + 4, "ASC-E1.17", 9) != 0 ||
+        be32(buf + E131_ROOT_VECTOR)  != 0x00000004 ||
+        be32(buf + E131_FRAME_VECTOR) != 0x00000002) {
+        g_stats.ignored++;
+        return;
+    }
+
+    e131Relays(packet, buf, len, rxMicros);
+#if RELAY_GATEWAY
+    e131Forward(buf, len);          // after our frame is queued
+#endif
+}
+
+static bool e131Open()
+{
+    // Unicast and every joined multicast group arrive on this one socket.
+    if (!g_queue) g_queue = memHotQueue("rx_e131", RX_QUEUE_DEPTH, sizeof(RxFrame));
+    if (!g_queue || !suUDP.listen(E131_PORT)) return false;
+    suUDP.onPacket(e131Packet);
+    followUniverse(activePatch().universe);
+
+    g_joinedIp = (uint32_t)WiFi.localIP();
+    if (!igmpUniverse(E131_DISC_UNIVERSE, true)) {
+        LOGW("E1.31 could not join the universe discovery group");
+    }
+    buildDiscovery(activePatch().universe);
+    if (!g_discTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = discoveryTick;
+        args.name     = "e131disc";
+        esp_timer_create(&args, &g_discTimer);
+    }
+    esp_timer_start_periodic(g_discTimer, (uint64_t)E131_DISC_INTERVAL_MS * 1000);
+    return true;
+}
+
+static void e131Close()
+{
+    esp_timer_stop(g_discTimer);
+    igmpUniverse(E131_DISC_UNIVERSE, false);
+    if (g_joinedUniverse) igmpUniverse(g_joinedUniverse, false);
+    g_joinedUniverse = 0;
+    suUDP.close();
+}
+
+static void e131Reconfigure()
+{
+    // New address (reconnect, DHCP renew): join both groups again on it.
+    uint32_t ip = (uint32_t)WiFi.localIP();
+    if (ip != g_joinedIp) {
+        g_joinedIp       = ip;
+        g_joinedUniverse = 0;
+        if (!igmpUniverse(E131_DISC_UNIVERSE, true)) {
+            LOGW("E1.31 could not join the universe discovery group");
+        }
+    }
+    followUniverse(activePatch().universe);
+    buildDiscovery(activePatch().universe);
+}
+
+static void e131Receive()
+{
+    protocolDrainFrames(g_queue, g_stats);
+}
+
+static const ProtocolStats &e131Stats()
+{
+    return g_stats;
+}
+
+extern const ProtocolModule e131Module = {
+    PROTO_E131, "e131", "E1.31", E131_PORT, "UDP",
+    e131Open, e131Close, e131Receive, e131Stats, e131Reconfigure,
+};
+
+#endif // RELAY_PROTO_E131
@@ -0,0 +1,125 @@
+#include "protocol.h"
+#if RELAY_PROTO_KINET
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#include "main_config.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "remote_log.h"
+
+// KiNET is little-endian throughout. Common header:
+//   magic (4) 0x4ADC0104, version (2), type (2), sequence (4)
+// DMXOUT (v1):  port, flags, timer (2), universe (4), start code, data
+// PORTOUT (v2): universe (4), port, pad, flags (2), length (2),
+//               start code (2), data
+#define KINET_MAGIC           0x4ADC0104u
+#define KINET_HEADER_LEN      12
+#define KINET_TYPE_DMXOUT     0x0101
+#define KINET_TYPE_PORTOUT    0x0108
+#define KINET_DMXOUT_DATA     21          // after the start code byte
+#define KINET_PORTOUT_DATA    24
+
+static AsyncUDP      kinetUDP;
+static QueueHandle_t g_queue = nullptr;
+static ProtocolStats g_stats;
+
+static inline uint16_t le16(const uint8_t *p)
+{
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+static inline uint32_t le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// KiNET header → our channel window, straight from the packet payload
+static void kinetPacket(AsyncUDPPacket &packet)
+{
+    const uint8_t *buf = packet.data();
+    size_t len = packet.length();
+    g_stats.bytes += len;
+
+    if (len <= KINET_HEADER_LEN || le32(buf) != KINET_MAGIC) {
+        g_stats.ignored++;
+        return;
+    }
+
+    uint16_t type = le16(buf + 6);
+    uint32_t universe;
+    size_t   dataOff, dataLen;
+    if (type == KINET_TYPE_DMXOUT && len > KINET_DMXOUT_DATA) {
+        universe = le32(buf + 16);
+        if (buf[20] != 0) {             // DMX start code only
+            g_stats.ignored++;
+            return;
+        }
+        dataOff = KINET_DMXOUT_DATA;
+        dataLen = len - dataOff;
+    } else if (type == KINET_TYPE_PORTOUT && len > KINET_PORTOUT_DATA) {
+        universe = le32(buf + 12);
+        if (le16(buf + 22) != 0) {
+            g_stats.ignored++;
+            return;
+        }
+        dataOff = KINET_PORTOUT_DATA;
+        dataLen = le16(buf + 20);
+        if (dataOff + dataLen > len) dataLen = len - dataOff;   // clamp to packet
+    } else {
+        g_stats.ignored++;              // discovery, config, unknown types
+        return;
+    }
+
+    if (universe != KINET_UNIVERSE_ANY && universe != activePatch().universe) {
+        g_stats.ignored++;
+        return;
+    }
+
+    RxFrame f;
+    f.proto    = PROTO_KINET;
+    f.flags    = 0;
+    f.seq      = (uint8_t)le32(buf + 8);    // low byte is enough to spot gaps
+    f.rxMicros = micros();
+    f.srcIp    = (uint32_t)packet.remoteIP();
+    if (!protocolExtractWindow(f, activePatch().startChan - 1, 0,
+                               buf + dataOff, dataLen)) {
+        g_stats.ignored++;
+        return;
+    }
+
+    protocolCountSeq(g_stats, f.seq, 255, true);
+    protocolQueueFrame(g_queue, f, g_stats);
+}
+
+static bool kinetOpen()
+{
+    if (!g_queue) g_queue = memHotQueue("rx_kinet", RX_QUEUE_DEPTH, sizeof(RxFrame));
+    if (!g_queue || !kinetUDP.listen(KINET_PORT)) return false;
+    kinetUDP.onPacket(kinetPacket);
+    return true;
+}
+
+static void kinetClose()
+{
+    kinetUDP.close();
+}
+
+static void kinetReceive()
+{
+    protocolDrainFrames(g_queue, g_stats);
+}
+
+static const ProtocolStats &kinetStats()
+{
+    return g_stats;
+}
+
+extern const ProtocolModule kinetModule = {
+    PROTO_KINET, "kinet", "KiNET", KINET_PORT, "UDP",
+    kinetOpen, kinetClose, kinetReceive, kinetStats, nullptr,
+};
+
+#endif // RELAY_PROTO_KINET
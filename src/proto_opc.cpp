@@ -0,0 +1,181 @@
+#include "protocol.h"
+#if RELAY_PROTO_OPC
+
+#include <Arduino.h>
+#include <AsyncTCP.h>
+
+#include "main_config.h"
+#include "mem_place.h"
+#include "patch.h"
+#include "remote_log.h"
+
+// Message: channel, command, 16-bit big-endian length, data. Senders keep
+// one connection open and stream messages back to back, split across TCP
+// segments however the stack likes, so each connection carries a small
+// parser that picks our channel window out of the body as it goes by.
+#define OPC_CMD_SET_PIXELS    0x00
+
+struct OpcConn {
+    AsyncClient *client;
+    uint32_t     lastMs;        // last data, for eviction
+    uint8_t      hdr[OPC_HEADER_LEN];
+    uint8_t      hdrLen;
+    bool         wanted;        // our channel and a set-pixels message
+    bool         hit;           // some of the body overlapped our window
+    uint16_t     bodyLen;
+    uint16_t     bodyPos;
+    uint32_t     base;          // window base, fixed per message
+    RxFrame      frame;
+};
+
+static AsyncServer   opcServer(OPC_PORT);
+static OpcConn       g_conns[OPC_MAX_CLIENTS];
+static QueueHandle_t g_queue = nullptr;
+static ProtocolStats g_stats;
+
+static void beginMessage(OpcConn &c)
+{
+    c.bodyLen = ((uint16_t)c.hdr[2] << 8) | c.hdr[3];
+    c.bodyPos = 0;
+    c.wanted  = (c.hdr[0] == 0 || c.hdr[0] == OPC_CHANNEL) &&
+                c.hdr[1] == OPC_CMD_SET_PIXELS;
+    c.hit     = false;
+    c.base    = activePatch().startChan - 1;
+
+    c.frame.proto    = PROTO_OPC;
+    c.frame.flags    = 0;
+    c.frame.seq      = 0;
+    c.frame.first    = 0;
+    c.frame.count    = 0;
+    c.frame.rxMicros = micros();
+}
+
+static void endMessage(OpcConn &c)
+{
+    if (c.hit) protocolQueueFrame(g_queue, c.frame, g_stats);
+    else       g_stats.ignored++;   // other channel / command, or not our slice
+    c.hdrLen = 0;
+}
+
+// Body bytes [bodyPos, bodyPos+n) arrived: copy just the overlap with our
+// window into the frame, growing [first, first+count) as we go.
+static void consumeBody(OpcConn &c, const uint8_t *data, uint16_t n)
+{
+    RxFrame &f    = c.frame;
+    uint16_t prevFirst = f.first;
+    uint16_t prevEnd   = f.first + f.count;
+    if (protocolExtractWindow(f, c.base, c.bodyPos, data, n)) {
+        if (c.hit) {
+            uint16_t end = f.first + f.count;
+            if (prevFirst < f.first) f.first = prevFirst;
+            f.count = (prevEnd > end ? prevEnd : end) - f.first;
+        }
+        c.hit = true;
+    }
+    c.bodyPos += n;
+}
+
+static void opcData(void *arg, AsyncClient *client, void *data, size_t len)
+{
+    OpcConn *c = (OpcConn *)arg;
+    if (c->client != client) return;        // evicted, closing
+
+    const uint8_t *p = (const uint8_t *)data;
+    g_stats.bytes += len;
+    c->lastMs = millis();
+
+    while (len) {
+        if (c->hdrLen < OPC_HEADER_LEN) {
+            c->hdr[c->hdrLen++] = *p++;
+            len--;
+            if (c->hdrLen == OPC_HEADER_LEN) {
+                beginMessage(*c);
+                if (!c->bodyLen) endMessage(*c);
+            }
+            continue;
+        }
+
+        uint16_t n = c->bodyLen - c->bodyPos;
+        if (n > len) n = len;
+        if (c->wanted) consumeBody(*c, p, n);
+        else           c->bodyPos += n;
+        p   += n;
+        len -= n;
+        if (c->bodyPos == c->bodyLen) endMessage(*c);
+    }
+}
+
+static void opcDisconnect(void *arg, AsyncClient *client)
+{
+    OpcConn *c = (OpcConn *)arg;
+    if (c->client == client) {
+        LOGI("[OPC] client %s disconnected", client->remoteIP().toString().c_str());
+        c->client = nullptr;
+    }
+    delete client;
+}
+
+// Sequencers reconnect without closing the old socket, so a full table
+// evicts the connection that has been quiet longest rather than refusing.
+static void opcConnect(void *, AsyncClient *client)
+{
+    OpcConn *slot = nullptr;
+    for (OpcConn &c : g_conns) {
+        if (!c.client) { slot = &c; break; }
+        if (!slot || (int32_t)(c.lastMs - slot->lastMs) < 0) slot = &c;
+    }
+
+    if (slot->client) {
+        LOGW("[OPC] too many clients, dropping idle %s",
+             slot->client->remoteIP().toString().c_str());
+        AsyncClient *old = slot->client;
+        slot->client = nullptr;
+        old->close(true);
+    }
+
+    slot->client = client;
+    slot->lastMs = millis();
+    slot->hdrLen = 0;
+    slot->frame.srcIp = (uint32_t)client->remoteIP();
+    client->setNoDelay(true);
+    client->onData(opcData, slot);
+    client->onDisconnect(opcDisconnect, slot);
+    LOGI("[OPC] client %s connected", client->remoteIP().toString().c_str());
+}
+
+static bool opcOpen()
+{
+    if (!g_queue) g_queue = memHotQueue("rx_opc", RX_QUEUE_DEPTH, sizeof(RxFrame));
+    if (!g_queue) return false;
+    opcServer.onClient(opcConnect, nullptr);
+    opcServer.begin();
+    return true;
+}
+
+static void opcClose()
+{
+    opcServer.end();
+    for (OpcConn &c : g_conns) {
+        if (!c.client) continue;
+        AsyncClient *client = c.client;
+        c.client = nullptr;
+        client->close(true);
+    }
+}
+
+static void opcReceive()
+{
+    protocolDrainFrames(g_queue, g_stats);
+}
+
+static const ProtocolStats &opcStats()
+{
+    return g_stats;
+}
+
+extern const ProtocolModule opcModule = {
+    PROTO_OPC, "opc", "OPC", OPC_PORT, "TCP",
+    opcOpen, opcClose, opcReceive, opcStats, nullptr,
+};
+
+#endif // RELAY_PROTO_OPC
@@ -0,0 +1,393 @@
+#include <Arduino.h>
+
+#include "protocol.h"
+#include "frame_ack.h"
+#include "packet_task.h"
+#include "patch.h"
+#include "relay_output.h"
+#include "status_led.h"
+#include "test_pattern.h"
+#include "remote_log.h"
+
+#if RELAY_PROTO_ARTNET
+extern const ProtocolModule artnetModule;
+#endif
+#if RELAY_PROTO_E131
+extern const ProtocolModule e131Module;
+#endif
+#if RELAY_PROTO_DDP
+extern const ProtocolModule ddpModule;
+#endif
+#if RELAY_PROTO_OPC
+extern const ProtocolModule opcModule;
+#endif
+#if RELAY_PROTO_KINET
+extern const ProtocolModule kinetModule;
+#endif
+
+// Everything that was compiled in, in poll order.
+static const ProtocolModule *const g_modules[] = {
+#if RELAY_PROTO_ARTNET
+    &artnetModule,
+#endif
+#if RELAY_PROTO_E131
+    &e131Module,
+#endif
+#if RELAY_PROTO_DDP
+    &ddpModule,
+#endif
+#if RELAY_PROTO_OPC
+    &opcModule,
+#endif
+#if RELAY_PROTO_KINET
+    &kinetModule,
+#endif
+};
+static constexpr uint8_t MODULE_COUNT = sizeof(g_modules) / sizeof(g_modules[0]);
+
+// The poll list: only open modules, rebuilt by protocolsApply().
+static const ProtocolModule *g_active[PROTO_COUNT];
+static uint8_t  g_activeCount = 0;
+static uint8_t  g_openMask    = 0;
+
+static unsigned long g_lastFrameMs = 0;
+static bool          g_failsafe    = false;
+
+// Receive -> commit latency, cumulative buckets in microseconds.
+static const uint32_t LATENCY_BOUNDS_US[] = { 100, 250, 500, 1000, 2500, 5000, 10000 };
+#define LATENCY_BUCKETS       (sizeof(LATENCY_BOUNDS_US) / sizeof(LATENCY_BOUNDS_US[0]))
+
+static uint32_t g_latencyCount[LATENCY_BUCKETS + 1];    // last = +Inf
+static uint64_t g_latencySumUs = 0;
+static uint32_t g_latencyTotal = 0;
+
+static void noteLatency(uint32_t us)
+{
+    uint8_t b = 0;
+    while (b < LATENCY_BUCKETS && us > LATENCY_BOUNDS_US[b]) b++;
+    g_latencyCount[b]++;
+    g_latencySumUs += us;
+    g_latencyTotal++;
+}
+
+// ---------- ARBITRATION STATE ----------
+//
+// Only PRIORITY and HTP relays need to know what the other protocols are
+// doing. A protocol counts as live for ARB_HOLD_MS after its last frame.
+//
+
+#define ARB_HOLD_MS           2500
+
+static RelayMask g_onBits[PROTO_COUNT];     // last on/off per protocol
+static uint32_t  g_seenMs[PROTO_COUNT];     // millis() of last frame, 0 = never
+
+// Rule inputs: last channel levels per protocol. Rules are only re-run
+// when one of their channels moved (results live on in g_onBits).
+static uint8_t  g_levels[PROTO_COUNT][CHANNEL_WINDOW];
+static uint32_t g_rulesGen[PROTO_COUNT];    // patch generation last evaluated
+
+static RelayMask liveMask(uint32_t now, const RelayMask *perProto, uint8_t except)
+{
+    RelayMask m = 0;
+    for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+        if (id == except || !g_seenMs[id]) continue;
+        if (now - g_seenMs[id] <= ARB_HOLD_MS) m |= perProto[id];
+    }
+    return m;
+}
+
+static bool anyProtocolLive(uint32_t now)
+{
+    for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+        if (g_seenMs[id] && now - g_seenMs[id] <= ARB_HOLD_MS) return true;
+    }
+    return false;
+}
+
+// Stage what one frame is allowed to change under the active patch.
+static void dispatchFrame(const RxFrame &f, const Patch &patch, uint32_t now)
+{
+    RelayMask   window = 0, on = 0;
+    ChannelMask changed = 0;
+    uint8_t    *levels  = g_levels[f.proto];
+    for (uint16_t i = f.first; i < f.first + f.count; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        window |= bit;
+        if (f.data[i] > 127) on |= bit;
+        if (levels[i] != f.data[i]) changed |= bit;
+        levels[i] = f.data[i];
+    }
+
+    // Ruled relays ignore their own channel and take the rule's result.
+    const RuleProgram &rules = patch.rules;
+    if (rules.ruleCount) {
+        if (g_rulesGen[f.proto] != patch.generation) {
+            changed = ~(ChannelMask)0;          // new program: run every rule
+            g_rulesGen[f.proto] = patch.generation;
+        }
+        RelayMask evaluated;
+        RelayMask result = rulesEvaluate(rules, levels, changed, evaluated);
+
+        window = (window & ~rules.ruled) | evaluated;
+        on     = (on & ~rules.ruled) | result;
+    }
+
+    g_onBits[f.proto] = (g_onBits[f.proto] & ~window) | on;
+    g_seenMs[f.proto] = now ? now : 1;
+
+    // PRIORITY relays fall back to us while their preferred source is quiet.
+    RelayMask fallback = patch.priority & ~patch.preferred[f.proto] &
+                         ~liveMask(now, patch.preferred, f.proto);
+    RelayMask write = window & (patch.direct[f.proto] | fallback);
+
+    // HTP: re-evaluate across every live protocol, ours included.
+    RelayMask htpOn = 0;
+    if (patch.htp) {
+        htpOn = liveMask(now, g_onBits, PROTO_COUNT) & patch.htp;
+        write |= patch.htp;
+    }
+
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (!(write & bit)) continue;
+        stageInput(i, (patch.htp & bit) ? (htpOn & bit) : (on & bit));
+    }
+}
+
+const ProtocolModule *protocolById(uint8_t id)
+{
+    for (uint8_t i = 0; i < MODULE_COUNT; i++) {
+        if (g_modules[i]->id == id) return g_modules[i];
+    }
+    return nullptr;
+}
+
+uint8_t protocolsCompiledMask()
+{
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < MODULE_COUNT; i++) mask |= 1u << g_modules[i]->id;
+    return mask;
+}
+
+uint8_t protocolsEnabledMask()
+{
+    return g_openMask;
+}
+
+void protocolsApply(uint8_t enableMask)
+{
+    enableMask &= protocolsCompiledMask();
+
+    g_activeCount = 0;
+    for (uint8_t i = 0; i < MODULE_COUNT; i++) {
+        const ProtocolModule *m = g_modules[i];
+        uint8_t bit   = 1u << m->id;
+        bool    want  = enableMask & bit;
+        bool    isOpen = g_openMask & bit;
+
+        if (want && !isOpen) {
+            if (m->open()) {
+                g_openMask |= bit;
+                LOGI("[PROTO] %s listening on %s port %u", m->label, m->transport, m->port);
+            } else {
+                LOGE("[PROTO] %s init FAILED", m->label);
+            }
+        } else if (!want && isOpen) {
+            m->close();
+            g_openMask &= ~bit;
+            LOGI("[PROTO] %s disabled", m->label);
+        }
+
+        if (g_openMask & bit) g_active[g_activeCount++] = m;
+    }
+}
+
+void protocolsPoll()
+{
+    for (uint8_t i = 0; i < g_activeCount; i++) {
+        g_active[i]->receive();
+    }
+}
+
+bool protocolExtractWindow(RxFrame &f, uint32_t base, uint32_t pktFirst,
+                           const uint8_t *data, uint32_t pktLen)
+{
+    uint32_t lo = base > pktFirst ? base : pktFirst;
+    uint32_t hi = base + CHANNEL_WINDOW;
+    if (pktFirst + pktLen < hi) hi = pktFirst + pktLen;
+    if (lo >= hi) return false;
+
+    f.first = lo - base;
+    f.count = hi - lo;
+    memcpy(f.data + f.first, data + (lo - pktFirst), f.count);
+    return true;
+}
+
+void protocolQueueFrame(QueueHandle_t q, const RxFrame &f, ProtocolStats &st)
+{
+    if (xQueueSend(q, &f, 0) != pdTRUE) st.dropped++;
+    packetNotify(PKT_EV_FRAME);
+}
+
+void protocolDrainFrames(QueueHandle_t q, ProtocolStats &st)
+{
+    RxFrame  f;
+    bool     any        = false;
+    bool     terminated = false;
+    uint8_t  proto      = 0;
+    uint32_t oldestRx   = 0;
+    RxFrame  newest;
+    uint32_t now        = millis();
+    const Patch &patch  = activePatch();
+
+    while (xQueueReceive(q, &f, 0) == pdTRUE) {
+        proto = f.proto;
+        if (f.flags & RX_FRAME_TERMINATED) {
+            g_seenMs[proto] = 0;        // stops counting for arbitration now
+            terminated = true;
+            continue;
+        }
+        terminated = false;
+        if (!any) testPatternPreempt();     // show data wins, before it is staged
+        dispatchFrame(f, patch, now);
+        st.packets++;
+        if (!any) oldestRx = f.rxMicros;
+        newest = f;
+        any = true;
+    }
+
+    if (any) {
+        commitRelays();
+        uint32_t committed = micros();
+        noteLatency(committed - oldestRx);  // worst frame of this batch
+        frameAckNote(newest.proto, newest.seq, newest.srcIp, newest.rxMicros, committed);
+        st.lastMs = millis();
+        protocolNoteFrame((ProtoId)proto);
+    }
+    if (terminated) {
+        const ProtocolModule *m = protocolById(proto);
+        LOGI("[PROTO] %s sender terminated its stream", m ? m->label : "?");
+        // Only the device's last live stream ending is a failsafe; other
+        // protocols may still be driving relays.
+        if (!anyProtocolLive(millis())) protocolsEnterFailsafe("stream terminated");
+    }
+}
+
+void protocolsReconfigure()
+{
+    for (uint8_t i = 0; i < g_activeCount; i++) {
+        if (g_active[i]->reconfigure) g_active[i]->reconfigure();
+    }
+}
+
+void protocolNoteFrame(ProtoId id)
+{
+    g_lastFrameMs = millis();
+    statusLedPacket(id);
+
+    if (g_failsafe) {
+        g_failsafe = false;
+        statusLedSetFailsafe(false);
+        LOGI("[PROTO] data resumed, failsafe cleared");
+    }
+}
+
+void protocolsEnterFailsafe(const char *why)
+{
+    if (g_failsafe) return;
+    g_failsafe = true;
+    statusLedSetFailsafe(true);
+    LOGW("[PROTO] failsafe: %s", why);
+
+    // No delayed close may energise a relay after this point; running
+    // pulses only end (open), so holding keeps them.
+#if FAILSAFE_RELAYS_OFF
+    relayCancelTimers(RELAY_MASK_ALL, RELAY_MASK_ALL);
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) stageRelay(i, false);
+    commitRelays();
+#else
+    relayCancelTimers(0, RELAY_MASK_ALL);
+#endif
+}
+
+bool protocolsInFailsafe()
+{
+    return g_failsafe;
+}
+
+bool protocolsShowActive()
+{
+    uint32_t last = g_lastFrameMs;
+    return last && !g_failsafe && millis() - last <= ARB_HOLD_MS;
+}
+
+// HTP relays: a protocol that went quiet (or terminated) stops holding
+// its relays on, without waiting for another protocol's next frame. With
+// nothing live at all the relays are left to the failsafe policy.
+static void expireQuietProtocols(uint32_t now)
+{
+    const Patch &patch = activePatch();
+    RelayMask dropped = 0;
+    for (uint8_t id = 0; id < PROTO_COUNT; id++) {
+        bool live = g_seenMs[id] && now - g_seenMs[id] <= ARB_HOLD_MS;
+        if (live || !g_onBits[id]) continue;
+        dropped       |= g_onBits[id];
+        g_onBits[id]   = 0;
+        g_seenMs[id]   = 0;
+        g_rulesGen[id] = 0;         // rule results were in g_onBits: rerun all
+    }
+    if (!(dropped & patch.htp) || !anyProtocolLive(now)) return;
+
+    RelayMask htpOn = liveMask(now, g_onBits, PROTO_COUNT) & patch.htp;
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (patch.htp & bit) stageInput(i, htpOn & bit);
+    }
+    commitRelays();
+}
+
+void protocolsCheckTimeout()
+{
+    uint32_t now = millis();
+    expireQuietProtocols(now);
+    if (!g_failsafe && now - g_lastFrameMs > RX_TIMEOUT_MS) {
+        protocolsEnterFailsafe("no data received");   // not receiving
+    }
+}
+
+void protocolCountSeq(ProtocolStats &st, uint8_t seq, uint8_t maxSeq, bool zeroIsOff)
+{
+    if (zeroIsOff && seq == 0) return;
+    if (st.seqSeen) {
+        uint8_t expect = (st.lastSeq >= maxSeq) ? (zeroIsOff ? 1 : 0)
+                                                : st.lastSeq + 1;
+        if (seq != expect) st.seqErrors++;
+    }
+    st.lastSeq = seq;
+    st.seqSeen = true;
+}
+
+void protocolsPrintMetrics(Print &out)
+{
+    for (uint8_t i = 0; i < MODULE_COUNT; i++) {
+        const ProtocolModule *m = g_modules[i];
+        const ProtocolStats  &st = m->stats();
+        out.printf("relay_proto_enabled{proto=\"%s\"} %u\n", m->name,
+                   (g_openMask >> m->id) & 1u);
+        out.printf("relay_proto_packets_total{proto=\"%s\"} %u\n", m->name, (unsigned)st.packets);
+        out.printf("relay_proto_bytes_total{proto=\"%s\"} %u\n", m->name, (unsigned)st.bytes);
+        out.printf("relay_proto_ignored_total{proto=\"%s\"} %u\n", m->name, (unsigned)st.ignored);
+        out.printf("relay_proto_dropped_total{proto=\"%s\"} %u\n", m->name, (unsigned)st.dropped);
+        out.printf("relay_proto_seq_errors_total{proto=\"%s\"} %u\n", m->name, (unsigned)st.seqErrors);
+    }
+
+    uint32_t cumulative = 0;
+    for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+        cumulative += g_latencyCount[b];
+        out.printf("relay_rx_commit_latency_us_bucket{le=\"%u\"} %u\n",
+                   (unsigned)LATENCY_BOUNDS_US[b], (unsigned)cumulative);
+    }
+    out.printf("relay_rx_commit_latency_us_bucket{le=\"+Inf\"} %u\n", (unsigned)g_latencyTotal);
+    out.printf("relay_rx_commit_latency_us_sum %llu\n", (unsigned long long)g_latencySumUs);
+    out.printf("relay_rx_commit_latency_us_count %u\n", (unsigned)g_latencyTotal);
+}
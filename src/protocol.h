@@ -0,0 +1,203 @@
+#pragma once
+#include <stdint.h>
+#include <Arduino.h>
+#include <freertos/queue.h>
+
+#include "main_config.h"
+
+class Print;
+
+// ---------- COMPILE-TIME PROTOCOL SELECTION ----------
+//
+// Every receiver is a module in a small registry. Build with e.g.
+// -DRELAY_PROTO_ARTNET=0 to drop a protocol's code, socket and buffers
+// entirely; at runtime cfg.protoMask decides which compiled-in modules are
+// opened and polled. Disabled modules are not in the poll list at all.
+//
+
+#ifndef RELAY_PROTO_ARTNET
+#define RELAY_PROTO_ARTNET    1
+#endif
+#ifndef RELAY_PROTO_E131
+#define RELAY_PROTO_E131      1
+#endif
+#ifndef RELAY_PROTO_DDP
+#define RELAY_PROTO_DDP       1
+#endif
+#ifndef RELAY_PROTO_OPC
+#define RELAY_PROTO_OPC       1
+#endif
+#ifndef RELAY_PROTO_KINET
+#define RELAY_PROTO_KINET     1
+#endif
+
+// ---------- PROTOCOL CONSTANTS ----------
+
+// Art-Net
+#define ARTNET_UNIVERSE       41          // default port-address
+#define ARTNET_ARTDMX         0x5000
+#define ARTNET_ARTPOLL        0x2000
+#define ARTNET_PORT           0x1936      // 6454
+#define ARTNET_START_ADDRESS  18          // first channel byte in ArtNet packet
+
+// E1.31 (sACN)
+#define E131_PORT             5568
+#define E131_START_ADDRESS    126         // first channel byte in E1.31 packet
+#define E131_DISC_UNIVERSE    64214       // universe discovery, 239.255.250.214
+#define E131_DISC_INTERVAL_MS 10000
+#define E131_DISC_EXPIRE_MS   25000       // offer forgotten after 2.5 intervals
+#define E131_DISC_MAX_UNIVERSES 32
+#ifndef E131_AUTO_JOIN
+#define E131_AUTO_JOIN        0           // 1 = follow the only universe on offer
+#endif
+
+// DDP
+#define DDP_PORT              4048
+#define DDP_HEADER_LEN        10          // payload starts at byte 10
+#define DDP_TIMECODE_LEN      4           // extra header bytes if flagged
+
+// Open Pixel Control (TCP, persistent connections)
+#define OPC_PORT              7890
+#define OPC_HEADER_LEN        4           // channel, command, 16-bit length
+#ifndef OPC_CHANNEL
+#define OPC_CHANNEL           1           // our OPC channel; 0 (all) is accepted too
+#endif
+#define OPC_MAX_CLIENTS       2           // oldest idle connection is evicted
+
+// KiNET (Color Kinetics)
+#define KINET_PORT            6038
+#define KINET_UNIVERSE_ANY    0xFFFFFFFFu
+
+// ---------- RECEIVE WINDOW ----------
+//
+// Receivers never copy whole packets. The socket callback looks at the
+// header in place (lwIP pbuf payload), then copies just the slice of
+// channels we consume into an RxFrame and queues it for the packet task.
+// Packet size doesn't matter: a 1440 byte DDP payload costs the same as
+// a 16 byte one.
+//
+
+#define CHANNEL_WINDOW        NUM_RELAYS  // channels we consume per frame
+#define RX_QUEUE_DEPTH        4           // frames buffered per protocol
+
+// ---------- FAILSAFE ----------
+//
+// No frame from any protocol for RX_TIMEOUT_MS, or a sender explicitly
+// ending its stream, puts the controller in failsafe: status LED pattern,
+// and with FAILSAFE_RELAYS_OFF=1 all relays off. The next frame clears it.
+//
+
+#define RX_TIMEOUT_MS         30000
+#ifndef FAILSAFE_RELAYS_OFF
+#define FAILSAFE_RELAYS_OFF   0           // 0 = hold last state
+#endif
+
+// RxFrame.flags
+#define RX_FRAME_TERMINATED   0x01        // sender ended the stream, no data
+
+// Stable ids; also the bit positions in cfg.protoMask.
+enum ProtoId : uint8_t {
+    PROTO_ARTNET = 0,
+    PROTO_E131   = 1,
+    PROTO_DDP    = 2,
+    PROTO_OPC    = 3,
+    PROTO_KINET  = 4,
+    PROTO_COUNT
+};
+
+struct ProtocolStats {
+    uint32_t packets;       // frames applied to the relays
+    uint32_t bytes;         // bytes seen on the socket (not copied)
+    uint32_t ignored;       // wrong opcode / universe, malformed
+    uint32_t dropped;       // frames lost because the queue was full
+    uint32_t seqErrors;     // sequence gaps or reorders seen
+    uint8_t  lastSeq;
+    bool     seqSeen;
+    uint32_t lastMs;        // millis() of the last applied frame
+};
+
+// One received frame, reduced to our channel window. Only
+// data[first .. first+count-1] is valid; a packet that covers part of the
+// window (e.g. DDP split across packets) fills just that part.
+struct RxFrame {
+    uint8_t  proto;         // ProtoId
+    uint8_t  flags;         // RX_FRAME_*
+    uint8_t  seq;
+    uint16_t first;
+    uint16_t count;
+    uint32_t rxMicros;      // micros() when the callback saw the packet
+    uint32_t srcIp;         // sender IPv4 (lwIP byte order), for frame acks
+    uint8_t  data[CHANNEL_WINDOW];
+};
+
+struct ProtocolModule {
+    ProtoId     id;
+    const char *name;       // short lowercase name, used in API/metrics
+    const char *label;      // human readable, used in UI banner
+    uint16_t    port;
+    const char *transport;  // "UDP" / "TCP", for logs
+    bool (*open)();
+    void (*close)();
+    void (*receive)();      // apply queued frames, commit once
+    const ProtocolStats &(*stats)();
+    void (*reconfigure)();  // patch changed while open (may be nullptr)
+};
+
+// Open/close modules so exactly the ones in enableMask are live.
+void protocolsApply(uint8_t enableMask);
+
+// Poll every live module once.
+void protocolsPoll();
+
+// The patch changed: let open modules follow without closing sockets.
+void protocolsReconfigure();
+
+// Bit per compiled-in module / per currently open module.
+uint8_t protocolsCompiledMask();
+uint8_t protocolsEnabledMask();
+
+// nullptr if not compiled in.
+const ProtocolModule *protocolById(uint8_t id);
+
+// Called by modules for every frame they apply (LED, failsafe, tests).
+void protocolNoteFrame(ProtoId id);
+
+// Packet task: enter failsafe once nothing arrived for RX_TIMEOUT_MS.
+void protocolsCheckTimeout();
+
+// Enter failsafe right away (e.g. E1.31 Stream_Terminated).
+void protocolsEnterFailsafe(const char *why);
+bool protocolsInFailsafe();
+
+// Show data applied within the arbitration hold time. Side channels
+// (MQTT) leave the relays alone while this is true.
+bool protocolsShowActive();
+
+// Copy the overlap of our window [base, base+CHANNEL_WINDOW) with a packet
+// carrying channels [pktFirst, pktFirst+pktLen) at data. false = no overlap.
+bool protocolExtractWindow(RxFrame &f, uint32_t base, uint32_t pktFirst,
+                           const uint8_t *data, uint32_t pktLen);
+
+// Queue a frame from a socket callback and wake the packet task; counts a
+// drop if the task is behind.
+void protocolQueueFrame(QueueHandle_t q, const RxFrame &f, ProtocolStats &st);
+
+// Packet task: apply every queued frame (stage), commit once.
+void protocolDrainFrames(QueueHandle_t q, ProtocolStats &st);
+
+// Sequence bookkeeping. Sequences run up to maxSeq and wrap; with zeroIsOff
+// they wrap to 1 and a 0 means "sender doesn't sequence" (Art-Net, DDP,
+// KiNET). OPC has no sequence field; TCP already keeps it in order.
+void protocolCountSeq(ProtocolStats &st, uint8_t seq, uint8_t maxSeq, bool zeroIsOff);
+
+// E1.31 universe discovery: universes senders currently offer (sorted),
+// and our universe if offered, else the lowest offered one, else 0.
+#if RELAY_PROTO_E131
+uint8_t  e131OfferedUniverses(uint16_t *out, uint8_t max);
+uint16_t e131SuggestUniverse();
+void     e131PrintDiscovery(Print &out);
+#endif
+
+// Per-protocol counters plus the socket-callback -> relay-commit latency
+// histogram (RxFrame.rxMicros to commitRelays()).
+void protocolsPrintMetrics(Print &out);
@@ -0,0 +1,45 @@
+#include "relay_interlock.h"
+
+uint32_t interlockWaitMs(const RelayMask *partners, const uint16_t *deadMs,
+                         const uint32_t *offMs, uint32_t nowMs,
+                         RelayMask opening, uint8_t index)
+{
+    RelayMask p    = partners[index];
+    uint32_t  dead = deadMs[index];
+    uint32_t  wait = 0;
+    for (uint8_t j = 0; j < NUM_RELAYS && p; j++) {
+        RelayMask bit = (RelayMask)1 << j;
+        if (!(p & bit)) continue;
+        p &= ~bit;
+
+        uint32_t since = (opening & bit) ? 0 : nowMs - offMs[j];
+        uint32_t left  = since < dead ? dead - since : 0;
+        if (left > wait) wait = left;
+    }
+    return wait;
+}
+
+RelayMask interlockGate(const RelayMask *partners, const uint16_t *deadMs,
+                        const uint32_t *offMs, uint32_t nowMs,
+                        RelayMask state, RelayMask next, RelayMask &held)
+{
+    RelayMask closing = next & ~state;
+    RelayMask opening = state & ~next;
+    RelayMask granted = next & ~closing;
+
+    held = 0;
+    for (uint8_t i = 0; i < NUM_RELAYS && closing; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (!(closing & bit)) continue;
+        closing &= ~bit;
+
+        RelayMask p = partners[i];
+        if (p & granted) continue;              // a partner is closed: refused
+        if (p && interlockWaitMs(partners, deadMs, offMs, nowMs, opening, i)) {
+            held |= bit;
+            continue;
+        }
+        granted |= bit;
+    }
+    return granted;
+}
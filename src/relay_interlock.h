@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+#include "main_config.h"
+
+// ---------- SELECTOR INTERLOCK ----------
+//
+// The rule every relay write passes in commitRelays(), whoever staged it:
+// a relay with interlock partners (RuleProgram.interlock, rules.h) only
+// closes while every partner is open and has been open for the relay's
+// dead time. Platform-free, so tools/interlock_test.cpp checks this same
+// code on the host.
+//
+
+// Dead time still to wait before relay `index` may close, 0 = now.
+// offMs = millis() each relay last opened; relays in `opening` open in
+// this same commit, so their dead time starts now.
+uint32_t interlockWaitMs(const RelayMask *partners, const uint16_t *deadMs,
+                         const uint32_t *offMs, uint32_t nowMs,
+                         RelayMask opening, uint8_t index);
+
+// Gate one commit: state = relays closed now, next = the staged state.
+// Returns next without the closes the rule refuses: a partner is or stays
+// closed (partners closing together: the lowest index wins), or the dead
+// time is not over yet. The latter are also in `held`, for the caller to
+// retry once the wait is over.
+RelayMask interlockGate(const RelayMask *partners, const uint16_t *deadMs,
+                        const uint32_t *offMs, uint32_t nowMs,
+                        RelayMask state, RelayMask next, RelayMask &held);
@@ -0,0 +1,338 @@
+#include <Arduino.h>
+
+#include "relay_output.h"
+#include "relay_stats.h"
+#include "event_bus.h"
+#include "i2c_output.h"
+#include "packet_task.h"
+#include "patch.h"
+#include "relay_interlock.h"
+#include "timer_wheel.h"
+#include "remote_log.h"
+
+bool relayState[NUM_RELAYS] = { false };
+
+// Wanted state from the frame path, applied by commitRelays()
+static bool g_pending[NUM_RELAYS] = { false };
+
+// Last channel level per relay (edge detection for the pulse/toggle modes)
+static bool g_input[NUM_RELAYS] = { false };
+
+// One pulse timer per relay; a retrigger re-arms it. g_delay holds a
+// relay back until its interlocked partners have been off for deadMs; a
+// pulse held back that way starts when the relay actually closes
+// (g_pulseOnClose).
+static TimerWheel g_wheel;
+static TimerNode  g_pulse[NUM_RELAYS];
+static TimerNode  g_delay[NUM_RELAYS];
+static uint32_t   g_offMs[NUM_RELAYS];     // millis() of the last on->off
+static RelayMask  g_pulseOnClose = 0;
+static uint32_t   g_interlockRefused = 0;
+
+// Runtime RelayMode from a scene, valid while cfg still has the mode it
+// replaced (g_modeFrom); RELAY_MODE_COUNT = none. Never in cfg.
+static uint8_t    g_modeOverride[NUM_RELAYS];
+static uint8_t    g_modeFrom[NUM_RELAYS];
+
+#define TIMER_DELAY_TAG       0x80         // g_delay node ids
+
+static const char *const MODE_NAMES[RELAY_MODE_COUNT] = {
+    "latched", "pulse_rise", "pulse_change", "toggle"
+};
+
+const char *relayModeName(uint8_t mode)
+{
+    return mode < RELAY_MODE_COUNT ? MODE_NAMES[mode] : "?";
+}
+
+int relayModeFromName(const char *name)
+{
+    for (uint8_t i = 0; i < RELAY_MODE_COUNT; i++) {
+        if (strcasecmp(name, MODE_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Staged only; the caller flushes once for all the relays it touched.
+static void writePin(uint8_t index, bool on)
+{
+    uint8_t gpio = cfg.relays[index].gpio;
+    if (gpio == 0xFF || gpio >= OUTPUT_COUNT) return;  // unmapped / disabled
+
+    i2cOutputStage(gpio, on);   // HIGH = ON, LOW = OFF
+}
+
+void startRelayOutput()
+{
+    startI2cOutput();
+
+    wheelInit(g_wheel, millis());
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        g_pulse[i].id = i;
+        g_delay[i].id = i | TIMER_DELAY_TAG;
+        g_modeOverride[i] = RELAY_MODE_COUNT;
+    }
+}
+
+// ---------- STAGE / COMMIT ----------
+
+// Stage a relay, honouring selector interlocks: closing a relay opens its
+// partners first and waits out the dead time on g_delay. Every stage path
+// (frames, rules, API, MQTT, scenes, test patterns) comes through here.
+void stageRelay(uint8_t index, bool on)
+{
+    if (index >= NUM_RELAYS) return;
+    RelayMask   bit      = (RelayMask)1 << index;
+    const Patch &patch   = activePatch();
+    RelayMask   partners = patch.rules.interlock[index];
+
+    if (!on || !partners) {
+        wheelCancel(g_wheel, g_delay[index]);
+        if (!on) g_pulseOnClose &= ~bit;
+        g_pending[index] = on;
+        if (on && (g_pulseOnClose & bit)) {
+            g_pulseOnClose &= ~bit;
+            wheelSchedule(g_wheel, g_pulse[index], millis(), cfg.relays[index].pulseMs);
+        }
+        return;
+    }
+
+    RelayMask opening = 0;
+    for (uint8_t j = 0; j < NUM_RELAYS; j++) {
+        RelayMask pb = (RelayMask)1 << j;
+        if (!(partners & pb)) continue;
+        wheelCancel(g_wheel, g_delay[j]);
+        g_pulseOnClose &= ~pb;
+        g_pending[j] = false;
+        if (relayState[j]) opening |= pb;       // opens with this commit
+    }
+
+    uint32_t now  = millis();
+    uint32_t wait = interlockWaitMs(patch.rules.interlock, patch.rules.deadMs, g_offMs,
+                                    now, opening, index);
+    if (!wait) {
+        wheelCancel(g_wheel, g_delay[index]);
+        g_pending[index] = true;
+        if (g_pulseOnClose & bit) {
+            g_pulseOnClose &= ~bit;
+            wheelSchedule(g_wheel, g_pulse[index], now, cfg.relays[index].pulseMs);
+        }
+    } else if (!wheelPending(g_delay[index])) {
+        wheelSchedule(g_wheel, g_delay[index], now, wait);
+    }
+}
+
+// Last line: whatever was staged, no relay closes against the interlock.
+// Refused closes stay open; ones only waiting for the dead time are
+// retried from g_delay, their pulse (if any) starting when they close.
+static void gateInterlocks(uint32_t now)
+{
+    RelayMask state = 0, next = 0;
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (relayState[i]) state |= bit;
+        if (g_pending[i])  next  |= bit;
+    }
+    if (!(next & ~state)) return;               // nothing closes
+
+    const Patch &patch = activePatch();
+    RelayMask held;
+    RelayMask granted = interlockGate(patch.rules.interlock, patch.rules.deadMs, g_offMs,
+                                      now, state, next, held);
+    RelayMask refused = next & ~granted;
+    for (uint8_t i = 0; i < NUM_RELAYS && refused; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (!(refused & bit)) continue;
+        refused &= ~bit;
+        g_pending[i] = false;
+        if (!(held & bit)) {
+            g_interlockRefused++;
+            continue;
+        }
+        if (wheelPending(g_pulse[i])) {
+            wheelCancel(g_wheel, g_pulse[i]);
+            g_pulseOnClose |= bit;
+        }
+        uint32_t wait = interlockWaitMs(patch.rules.interlock, patch.rules.deadMs, g_offMs,
+                                        now, state & ~next, i);
+        wheelSchedule(g_wheel, g_delay[i], now, wait);
+    }
+}
+
+void commitRelays()
+{
+    uint32_t  now     = millis();
+    RelayMask changed = 0, state = 0;
+    gateInterlocks(now);
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (g_pending[i]) state |= bit;
+        if (g_pending[i] == relayState[i]) continue;
+        writePin(i, g_pending[i]);
+        relayState[i] = g_pending[i];
+        relayStatsTransition(i, g_pending[i], now);
+        if (!g_pending[i]) g_offMs[i] = now;
+        changed |= bit;
+    }
+    if (!changed) return;
+
+    i2cOutputFlush();
+    eventBusPublish(changed, state);    // after the hardware, never before
+}
+
+// ---------- RELAY MODES ----------
+
+// The pulse timer starts when the relay closes, which an interlock may
+// defer (stageRelay arms it then).
+static void startPulse(uint8_t index)
+{
+    g_pulseOnClose |= (RelayMask)1 << index;
+    stageRelay(index, true);
+}
+
+void stageInput(uint8_t index, bool on)
+{
+    if (index >= NUM_RELAYS) return;
+    bool rose    = on && !g_input[index];
+    bool changed = on != g_input[index];
+    g_input[index] = on;
+
+    switch (relayMode(index)) {
+    case RELAY_PULSE_RISE:
+        if (rose) startPulse(index);
+        break;
+    case RELAY_PULSE_CHANGE:
+        if (changed) startPulse(index);
+        break;
+    case RELAY_TOGGLE:
+        if (rose) stageRelay(index, !g_pending[index]);
+        break;
+    default:                                    // RELAY_LATCHED
+        stageRelay(index, on);
+        break;
+    }
+}
+
+uint8_t relayMode(uint8_t index)
+{
+    uint8_t configured = cfg.relays[index].mode;
+    uint8_t over       = g_modeOverride[index];
+    return (over < RELAY_MODE_COUNT && g_modeFrom[index] == configured) ? over : configured;
+}
+
+void relaySetMode(uint8_t index, uint8_t mode)
+{
+    if (index >= NUM_RELAYS || mode >= RELAY_MODE_COUNT) return;
+    if (!packetTaskIsCurrent() && packetTaskRunning()) {
+        LOGE("[RELAY] mode of relay %u changed off the packet task, ignored", index);
+        return;
+    }
+    uint8_t configured    = cfg.relays[index].mode;
+    g_modeFrom[index]     = configured;
+    g_modeOverride[index] = (mode == configured) ? (uint8_t)RELAY_MODE_COUNT : mode;
+}
+
+static void timerExpired(TimerNode &n)
+{
+    if (n.id & TIMER_DELAY_TAG) stageRelay(n.id & ~TIMER_DELAY_TAG, true);
+    else                        stageRelay(n.id, false);   // pulse over, drops a held close
+}
+
+void relayCancelTimers(RelayMask pulses, RelayMask delays)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (pulses & bit) wheelCancel(g_wheel, g_pulse[i]);
+        if (delays & bit) wheelCancel(g_wheel, g_delay[i]);
+    }
+    g_pulseOnClose &= ~delays;
+}
+
+bool relayOutputBusy()
+{
+    return wheelBusy(g_wheel);
+}
+
+void relayOutputTick()
+{
+    // Same stage/commit path as a frame, so stats and diffing still apply.
+    if (wheelAdvance(g_wheel, millis(), timerExpired)) commitRelays();
+}
+
+void setRelay(uint8_t index, bool on)
+{
+    if (index >= NUM_RELAYS) return;
+    stageRelay(index, on);
+    commitRelays();
+}
+
+void setRelays(RelayMask mask, RelayMask state)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (mask & bit) stageRelay(i, state & bit);
+    }
+    commitRelays();
+}
+
+bool relayParseState(const char *text, size_t len, RelayMask &mask, RelayMask &state)
+{
+    mask  = 0;
+    state = 0;
+    if ((len == 1 && (text[0] == '0' || text[0] == '1')) ||
+        (len == 2 && strncasecmp(text, "ON", 2) == 0) ||
+        (len == 3 && strncasecmp(text, "OFF", 3) == 0)) {
+        mask  = RELAY_MASK_ALL;
+        state = (text[0] == '1' || len == 2) ? RELAY_MASK_ALL : 0;
+        return true;
+    }
+    if (!len || len > NUM_RELAYS) return false;
+    for (uint8_t i = 0; i < len; i++) {
+        RelayMask bit = (RelayMask)1 << i;
+        if (text[i] == '-') continue;
+        if (text[i] != '0' && text[i] != '1') return false;
+        mask |= bit;
+        if (text[i] == '1') state |= bit;
+    }
+    return true;
+}
+
+void setAllRelays(bool on)
+{
+    if (on) {
+        setRelays(RELAY_MASK_ALL, RELAY_MASK_ALL);  // never forced past the interlock
+        return;
+    }
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        stageRelay(i, on);
+        writePin(i, on);            // force: used at boot to sync hardware
+        if (relayState[i] != on) relayStatsTransition(i, on, now);
+        relayState[i] = on;
+    }
+    i2cOutputFlush();
+
+    eventBusPublish(RELAY_MASK_ALL, on ? RELAY_MASK_ALL : 0);
+}
+
+RelayMask relayStateMask()
+{
+    RelayMask state = 0;
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (relayState[i]) state |= (RelayMask)1 << i;
+    }
+    return state;
+}
+
+void refreshRelays(RelayMask mask)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (mask & ((RelayMask)1 << i)) writePin(i, relayState[i]);
+    }
+    i2cOutputFlush();
+}
+
+void relayOutputPrintMetrics(Print &out)
+{
+    out.printf("relay_interlock_refused_total %u\n", (unsigned)g_interlockRefused);
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "main_config.h"
+
+class Print;
+
+// High-level trigger: HIGH = ON, LOW = OFF
+extern bool relayState[NUM_RELAYS];
+
+// Bring up the PCA9685 driver.
+void startRelayOutput();
+
+// Immediate relay change (UI / API). setRelays() sets every relay in mask
+// to its bit in state with a single commit.
+void setRelay(uint8_t index, bool on);
+void setRelays(RelayMask mask, RelayMask state);
+void setAllRelays(bool on);
+
+// "1"/"0"/"ON"/"OFF" = every relay, else one '1' / '0' / '-' (leave
+// alone) per relay from relay 0, missing ones left alone; the MQTT
+// relays/set payload and POST /api/set state=. false = malformed.
+bool relayParseState(const char *text, size_t len, RelayMask &mask, RelayMask &state);
+
+// Re-send the current state of the relays in mask, e.g. after a GPIO remap.
+void refreshRelays(RelayMask mask);
+
+// relayState[] as a mask (for readers outside the packet task).
+RelayMask relayStateMask();
+
+// Every path stages the wanted state of each relay, then commits once.
+// Only relays whose state actually changed are written. Staging a close
+// opens the relay's interlock partners and defers the close for the dead
+// time; commitRelays() re-checks the interlock (relay_interlock.h) on
+// everything staged and never closes a relay against it.
+void stageRelay(uint8_t index, bool on);
+void commitRelays();
+
+// Frame path input: the channel level for a relay, run through its
+// RelayMode (latched / pulse / toggle) before it is staged.
+void stageInput(uint8_t index, bool on);
+
+// Runtime mode change (scene recall). Packet task only: the mode is read
+// on every frame, so other tasks change it through a PacketCommand
+// (PKT_CMD_SCENE) or a config hand-over (packetAdoptConfig). Off the
+// packet task the change is refused and logged. The mode is an override,
+// never written to cfg (so never saved); it lasts until a reboot or until
+// the relay's configured mode changes. relayMode() = the mode in effect.
+void relaySetMode(uint8_t index, uint8_t mode);
+uint8_t relayMode(uint8_t index);
+
+// Expire pulses that are due and commit; call from the packet task.
+void relayOutputTick();
+
+// Drop the pulse timers of the relays in `pulses` and the pending delayed
+// closes (and pulses waiting on them) of those in `delays`. Packet task.
+void relayCancelTimers(RelayMask pulses, RelayMask delays);
+
+// A pulse or interlock delay is pending (the caller must keep ticking).
+bool relayOutputBusy();
+
+// Closes refused by the interlock gate.
+void relayOutputPrintMetrics(Print &out);
+
+// RelayMode <-> API name ("latched", "pulse_rise", "pulse_change", "toggle").
+#define RELAY_MODE_NAME_MAX   12          // strlen("pulse_change")
+const char *relayModeName(uint8_t mode);
+int relayModeFromName(const char *name);            // -1 if unknown
@@ -0,0 +1,209 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <rom/crc.h>
+
+#include "relay_stats.h"
+#include "remote_log.h"
+
+// ---------- CHECKPOINT LOG ----------
+//
+// Counters live in RAM and are written to NVS at most every
+// RSTATS_CHECKPOINT_MS, and only if something changed: a transition, or
+// on-time accruing while a relay is held on. Checkpoints rotate
+// over RSTATS_SLOTS keys ("c0".."c3") with a sequence number and CRC, so a
+// power cut mid-write only ever loses the newest record, and no single key
+// is rewritten more than once per RSTATS_SLOTS checkpoints (NVS levels
+// wear across its pages on top of that).
+//
+
+#ifndef RSTATS_CHECKPOINT_MS
+#define RSTATS_CHECKPOINT_MS   (30UL * 60UL * 1000UL)
+#endif
+#define RSTATS_SLOTS           4
+#define RSTATS_MAGIC           (0x52530000UL | NUM_RELAYS)   // "RS" + relay count
+
+struct StatsRecord {
+    uint32_t      magic;
+    uint32_t      seq;
+    RelayCounters relays[NUM_RELAYS];
+    uint32_t      crc;
+};
+
+// Written by the packet task, read by loop() and the web task: g_statsMux.
+static RelayCounters g_relayCounters[NUM_RELAYS];
+static uint32_t      g_relayOnSince[NUM_RELAYS];
+static RelayMask     g_relayOn    = 0;
+static bool          g_dirty      = false;
+static bool          g_resetSave  = false;      // checkpoint a reset from loop()
+static portMUX_TYPE  g_statsMux   = portMUX_INITIALIZER_UNLOCKED;
+
+static Preferences   g_statsPrefs;
+static uint32_t      g_seq = 0;
+static unsigned long g_lastCheckpoint = 0;
+static unsigned long g_lastEolCheck   = 0;
+static bool          g_eolAlerted[NUM_RELAYS] = { false };
+
+static uint32_t recordCrc(const StatsRecord &r)
+{
+    return crc32_le(0, (const uint8_t *)&r, offsetof(StatsRecord, crc));
+}
+
+static void slotKey(char *key, uint8_t slot)
+{
+    sprintf(key, "c%u", slot);
+}
+
+void relayStatsTransition(uint8_t index, bool on, uint32_t nowMs)
+{
+    RelayMask bit = (RelayMask)1 << index;
+    portENTER_CRITICAL(&g_statsMux);
+    RelayCounters &c = g_relayCounters[index];
+    if (on) {
+        c.cycles++;
+        g_relayOnSince[index] = nowMs;
+        g_relayOn |= bit;
+    } else if (g_relayOn & bit) {
+        c.onTimeMs += nowMs - g_relayOnSince[index];
+        g_relayOn &= ~bit;
+    }
+    g_dirty = true;
+    portEXIT_CRITICAL(&g_statsMux);
+}
+
+// Caller holds g_statsMux.
+static RelayCounters snapshotLocked(uint8_t index, uint32_t nowMs)
+{
+    RelayCounters c = g_relayCounters[index];
+    if (g_relayOn & ((RelayMask)1 << index)) c.onTimeMs += nowMs - g_relayOnSince[index];
+    return c;
+}
+
+RelayCounters relayStatsGet(uint8_t index)
+{
+    uint32_t now = millis();
+    portENTER_CRITICAL(&g_statsMux);
+    RelayCounters c = snapshotLocked(index, now);
+    portEXIT_CRITICAL(&g_statsMux);
+    return c;
+}
+
+bool relayStatsEol(uint8_t index)
+{
+    return cfg.eolCycles && g_relayCounters[index].cycles >= cfg.eolCycles;
+}
+
+void startRelayStats()
+{
+    StatsRecord best;
+    bool found = false;
+
+    g_statsPrefs.begin("rstats", true);
+    for (uint8_t slot = 0; slot < RSTATS_SLOTS; slot++) {
+        char key[4];
+        slotKey(key, slot);
+
+        StatsRecord r;
+        if (g_statsPrefs.getBytes(key, &r, sizeof(r)) != sizeof(r)) continue;
+        if (r.magic != RSTATS_MAGIC || r.crc != recordCrc(r)) continue;
+        if (!found || (int32_t)(r.seq - best.seq) > 0) {
+            best  = r;
+            found = true;
+        }
+    }
+    g_statsPrefs.end();
+
+    if (found) {
+        memcpy(g_relayCounters, best.relays, sizeof(g_relayCounters));
+        g_seq = best.seq;
+        LOGI("[RSTATS] restored checkpoint #%u", (unsigned)g_seq);
+    } else {
+        LOGI("[RSTATS] no checkpoint, counters start at zero");
+    }
+    g_lastCheckpoint = millis();
+}
+
+void relayStatsCheckpoint()
+{
+    StatsRecord r;
+    memset(&r, 0, sizeof(r));
+    r.magic = RSTATS_MAGIC;
+    r.seq   = g_seq + 1;
+
+    // One consistent snapshot (64-bit on-times written from the other
+    // core), running periods included; later changes mark it dirty again.
+    uint32_t now = millis();
+    portENTER_CRITICAL(&g_statsMux);
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) r.relays[i] = snapshotLocked(i, now);
+    g_dirty     = false;
+    g_resetSave = false;
+    portEXIT_CRITICAL(&g_statsMux);
+    r.crc = recordCrc(r);
+
+    char key[4];
+    slotKey(key, r.seq % RSTATS_SLOTS);
+
+    g_statsPrefs.begin("rstats", false);
+    size_t written = g_statsPrefs.putBytes(key, &r, sizeof(r));
+    g_statsPrefs.end();
+
+    if (written == sizeof(r)) {
+        g_seq = r.seq;
+        LOGD("[RSTATS] checkpoint #%u -> %s", (unsigned)g_seq, key);
+    } else {
+        g_dirty = true;                             // try again next time
+        LOGE("[RSTATS] checkpoint write FAILED");
+    }
+    g_lastCheckpoint = millis();
+}
+
+void relayStatsReset(uint8_t index)
+{
+    uint32_t now = millis();
+    portENTER_CRITICAL(&g_statsMux);
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (index < NUM_RELAYS && i != index) continue;
+        g_relayCounters[i].cycles   = 0;
+        g_relayCounters[i].onTimeMs = 0;
+        g_relayOnSince[i] = now;
+        g_eolAlerted[i]   = false;
+    }
+    g_resetSave = true;
+    portEXIT_CRITICAL(&g_statsMux);
+}
+
+void relayStatsTick()
+{
+    unsigned long now = millis();
+
+    if (cfg.eolCycles && now - g_lastEolCheck >= 1000) {
+        g_lastEolCheck = now;
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+            if (g_eolAlerted[i] || !relayStatsEol(i)) continue;
+            g_eolAlerted[i] = true;
+            LOGW("[RSTATS] relay %u reached end of life: %u cycles (limit %u)",
+                 i + 1, (unsigned)g_relayCounters[i].cycles, (unsigned)cfg.eolCycles);
+        }
+    }
+
+    // A relay that stays on never marks the counters dirty, but its
+    // on-time still has to reach flash before a power cut. A reset is
+    // saved at once.
+    bool accruing = g_relayOn != 0;
+    if (g_resetSave ||
+        ((g_dirty || accruing) && now - g_lastCheckpoint >= RSTATS_CHECKPOINT_MS)) {
+        relayStatsCheckpoint();
+    }
+}
+
+void relayStatsPrintMetrics(Print &out)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        RelayCounters c = relayStatsGet(i);
+        out.printf("relay_cycles_total{relay=\"%u\"} %u\n", i + 1, (unsigned)c.cycles);
+        out.printf("relay_on_seconds_total{relay=\"%u\"} %llu\n", i + 1,
+                   (unsigned long long)(c.onTimeMs / 1000));
+        out.printf("relay_end_of_life{relay=\"%u\"} %u\n", i + 1,
+                   relayStatsEol(i) ? 1u : 0u);
+    }
+    out.printf("relay_stats_checkpoints_total %u\n", (unsigned)g_seq);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include "main_config.h"
+
+class Print;
+
+// Per-relay wear counters. A cycle is one off→on closure; on-time is the
+// total time the contacts were closed.
+struct RelayCounters {
+    uint32_t cycles;
+    uint64_t onTimeMs;
+};
+
+// Output path hook (packet task), called by the commit for each relay
+// that changed. RAM only: no I2C, no flash. The counters are shared with
+// loop() and the web task, so every access is under one short spinlock.
+void relayStatsTransition(uint8_t index, bool on, uint32_t nowMs);
+
+// Restore the newest valid checkpoint from flash.
+void startRelayStats();
+
+// Periodic checkpoint + end-of-life checks. Call from loop().
+void relayStatsTick();
+
+// Force a checkpoint now (e.g. before a planned reboot).
+void relayStatsCheckpoint();
+
+// One relay's counters, on-time including the currently running on
+// period; a consistent snapshot from any task.
+RelayCounters relayStatsGet(uint8_t index);
+
+// Reset one relay (after replacing it) or all (index >= NUM_RELAYS).
+// Packet task (PKT_CMD_STATS_RESET); the checkpoint follows from loop().
+void relayStatsReset(uint8_t index);
+
+bool relayStatsEol(uint8_t index);
+
+void relayStatsPrintMetrics(Print &out);
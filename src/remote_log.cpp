@@ -0,0 +1,233 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <stdarg.h>
+
+#include "remote_log.h"
+
+// ---------- SINK CONFIG ----------
+//
+// Callers format into a fixed ring of slots; a low-priority task drains the
+// ring, mirrors each line to Serial and packs as many lines as fit into one
+// UDP datagram for the collector (newline separated, RFC 3164 style header
+// per line). Nothing on the caller side ever waits for the network.
+//
+
+#ifndef LOG_SLOTS
+#define LOG_SLOTS            48
+#endif
+#define LOG_LINE_MAX         120
+#define LOG_DATAGRAM_MAX     1400        // one WiFi frame, no IP fragmentation
+#define LOG_FLUSH_MS         250         // ship partial batches at least this often
+#define LOG_FACILITY         16          // local0
+#define LOG_TAG              "relayctl"
+
+// Once the ring is this full only Warn/Error get in; the remaining quarter
+// is kept for messages that actually matter.
+#define LOG_PRESSURE_SLOTS   (LOG_SLOTS * 3 / 4)
+
+struct LogSlot {
+    uint8_t level;
+    uint8_t len;
+    char    text[LOG_LINE_MAX];
+};
+
+static LogSlot      g_ring[LOG_SLOTS];
+static uint16_t     g_head  = 0;          // next slot to write
+static uint16_t     g_count = 0;          // slots in use
+static portMUX_TYPE g_ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile uint8_t  g_minLevel      = (uint8_t)LogLevel::Info;
+static volatile uint32_t g_collectorAddr = 0;   // 0 = remote shipping off
+static volatile uint16_t g_collectorPort = 514;
+
+static TaskHandle_t g_logTask = nullptr;
+static WiFiUDP      g_logUdp;
+
+// Counters (written under g_ringMux or by the sender task only)
+static uint32_t g_dropped[8]   = { 0 };   // indexed by level
+static uint32_t g_sent         = 0;       // lines handed to the collector
+static uint32_t g_unsent       = 0;       // lines drained while link/collector down
+static uint32_t g_datagrams    = 0;
+static uint32_t g_dropsReported = 0;
+
+static const char *levelName(uint8_t level)
+{
+    switch (level) {
+    case 3:  return "error";
+    case 4:  return "warn";
+    case 5:  return "notice";
+    case 6:  return "info";
+    default: return "debug";
+    }
+}
+
+static uint32_t totalDropped()
+{
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < 8; i++) n += g_dropped[i];
+    return n;
+}
+
+// ---------- PRODUCER SIDE ----------
+
+void logSetLevel(LogLevel level)
+{
+    g_minLevel = (uint8_t)level;
+}
+
+void logSetCollector(const char *host, uint16_t port)
+{
+    IPAddress ip;
+    if (!host || !host[0] || !ip.fromString(host)) {
+        g_collectorAddr = 0;
+        return;
+    }
+    g_collectorPort = port ? port : 514;
+    g_collectorAddr = (uint32_t)ip;
+}
+
+void logPrintf(LogLevel level, const char *fmt, ...)
+{
+    uint8_t lvl = (uint8_t)level;
+    if (lvl > g_minLevel) return;
+
+    // Format on the caller's stack first so the critical section is a copy.
+    char line[LOG_LINE_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if (n >= (int)sizeof(line)) n = sizeof(line) - 1;
+
+    bool wake = false;
+
+    portENTER_CRITICAL(&g_ringMux);
+    uint16_t limit = (level <= LogLevel::Warn) ? LOG_SLOTS : LOG_PRESSURE_SLOTS;
+    if (g_count >= limit) {
+        g_dropped[lvl & 7]++;
+    } else {
+        LogSlot &s = g_ring[g_head];
+        s.level = lvl;
+        s.len   = (uint8_t)n;
+        memcpy(s.text, line, n + 1);
+        g_head = (g_head + 1) % LOG_SLOTS;
+        g_count++;
+        wake = (g_count == LOG_SLOTS / 2);
+    }
+    portEXIT_CRITICAL(&g_ringMux);
+
+    // Half full: don't wait for the flush timer.
+    if (wake && g_logTask) xTaskNotifyGive(g_logTask);
+}
+
+// ---------- SENDER TASK ----------
+
+static bool popSlot(LogSlot &out)
+{
+    bool ok = false;
+    portENTER_CRITICAL(&g_ringMux);
+    if (g_count) {
+        uint16_t tail = (g_head + LOG_SLOTS - g_count) % LOG_SLOTS;
+        out = g_ring[tail];
+        g_count--;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&g_ringMux);
+    return ok;
+}
+
+static void flushDatagram(const char *buf, size_t len, uint16_t lines)
+{
+    if (!len) return;
+
+    uint32_t addr = g_collectorAddr;
+    if (!addr || WiFi.status() != WL_CONNECTED) {
+        g_unsent += lines;
+        return;
+    }
+
+    g_logUdp.beginPacket(IPAddress(addr), g_collectorPort);
+    g_logUdp.write((const uint8_t *)buf, len);
+    if (g_logUdp.endPacket()) {
+        g_sent += lines;
+        g_datagrams++;
+    } else {
+        g_unsent += lines;
+    }
+}
+
+// Append one "<PRI>host tag: text\n" line; false if it doesn't fit.
+static bool appendLine(char *buf, size_t &len, uint8_t level, const char *text)
+{
+    const char *host = WiFi.getHostname() ? WiFi.getHostname() : "esp32-relay";
+    int n = snprintf(buf + len, LOG_DATAGRAM_MAX - len, "<%u>%s %s: %s\n",
+                     (unsigned)(LOG_FACILITY * 8 + level), host, LOG_TAG, text);
+    if (n < 0 || (size_t)n >= LOG_DATAGRAM_MAX - len) return false;
+    len += n;
+    return true;
+}
+
+static void logTask(void *)
+{
+    static char dgram[LOG_DATAGRAM_MAX];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOG_FLUSH_MS));
+
+        size_t   len   = 0;
+        uint16_t lines = 0;
+        LogSlot  slot;
+
+        while (popSlot(slot)) {
+            Serial.println(slot.text);
+
+            if (!appendLine(dgram, len, slot.level, slot.text)) {
+                flushDatagram(dgram, len, lines);
+                len = lines = 0;
+                appendLine(dgram, len, slot.level, slot.text);
+            }
+            lines++;
+        }
+
+        // Tell the collector (once per batch) that it is missing messages.
+        uint32_t dropped = totalDropped();
+        if (dropped != g_dropsReported) {
+            char note[64];
+            snprintf(note, sizeof(note), "[LOG] %u messages dropped under pressure",
+                     (unsigned)(dropped - g_dropsReported));
+            g_dropsReported = dropped;
+            Serial.println(note);
+            if (!appendLine(dgram, len, (uint8_t)LogLevel::Warn, note)) {
+                flushDatagram(dgram, len, lines);
+                len = lines = 0;
+                appendLine(dgram, len, (uint8_t)LogLevel::Warn, note);
+            }
+            lines++;
+        }
+
+        flushDatagram(dgram, len, lines);
+    }
+}
+
+void startLogging()
+{
+    if (g_logTask) return;
+    // Core 0, low priority: shares the core with WiFi, never with loop().
+    xTaskCreatePinnedToCore(logTask, "log", 3072, nullptr, 1, &g_logTask, 0);
+}
+
+// ---------- METRICS ----------
+
+void logPrintMetrics(Print &out)
+{
+    out.printf("relay_log_sent_total %u\n", (unsigned)g_sent);
+    out.printf("relay_log_unsent_total %u\n", (unsigned)g_unsent);
+    out.printf("relay_log_datagrams_total %u\n", (unsigned)g_datagrams);
+    for (uint8_t lvl = 3; lvl <= 7; lvl++) {
+        out.printf("relay_log_dropped_total{level=\"%s\"} %u\n",
+                   levelName(lvl), (unsigned)g_dropped[lvl]);
+    }
+    out.printf("relay_log_queue_depth %u\n", (unsigned)g_count);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+
+class Print;
+
+// Severity levels, numbered like syslog so they map straight onto <PRI>.
+enum class LogLevel : uint8_t {
+    Error  = 3,
+    Warn   = 4,
+    Notice = 5,
+    Info   = 6,
+    Debug  = 7,
+};
+
+// Start the background sender task. Safe to call logPrintf() before this –
+// messages just wait in the ring until the task is up.
+void startLogging();
+
+// Point the sink at a UDP syslog collector (IPv4 dotted quad). An empty host
+// disables remote shipping; Serial mirroring keeps working either way.
+void logSetCollector(const char *host, uint16_t port);
+
+// Messages above this level are discarded at the call site (cheap).
+void logSetLevel(LogLevel level);
+
+// printf-style log call. Never blocks: the message is formatted into a ring
+// slot and shipped later by the sender task. Under pressure Debug/Info are
+// dropped first, and every drop is counted.
+void logPrintf(LogLevel level, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Prometheus-style counters (sent / dropped per level / datagrams).
+void logPrintMetrics(Print &out);
+
+#define LOGE(...) logPrintf(LogLevel::Error, __VA_ARGS__)
+#define LOGW(...) logPrintf(LogLevel::Warn,  __VA_ARGS__)
+#define LOGI(...) logPrintf(LogLevel::Info,  __VA_ARGS__)
+#define LOGD(...) logPrintf(LogLevel::Debug, __VA_ARGS__)
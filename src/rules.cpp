@@ -0,0 +1,262 @@
+#include <Arduino.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "rules.h"
+#include "protocol.h"
+
+static_assert(sizeof(((DeviceConfig *)0)->rules) == RULE_SRC_MAX, "cfg.rules size");
+static_assert(CHANNEL_WINDOW <= sizeof(ChannelMask) * 8, "ChannelMask too narrow for CHANNEL_WINDOW");
+
+// ---------- COMPILER ----------
+
+struct Cursor {
+    const char *p;
+    const char *err;        // first error, nullptr while fine
+};
+
+static void skipSpace(Cursor &c)
+{
+    while (*c.p == ' ' || *c.p == '\t' || *c.p == '\r') c.p++;
+}
+
+static bool accept(Cursor &c, const char *tok)
+{
+    skipSpace(c);
+    size_t n = strlen(tok);
+    if (strncasecmp(c.p, tok, n) != 0) return false;
+    c.p += n;
+    return true;
+}
+
+static bool atStmtEnd(Cursor &c)
+{
+    skipSpace(c);
+    return *c.p == '\0' || *c.p == ';' || *c.p == '\n';
+}
+
+static bool number(Cursor &c, long lo, long hi, long &out, const char *what)
+{
+    skipSpace(c);
+    char *end;
+    long v = strtol(c.p, &end, 10);
+    if (end == c.p) {
+        if (!c.err) c.err = what;
+        return false;
+    }
+    c.p = end;
+    if (v < lo || v > hi) {
+        if (!c.err) c.err = what;
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+// "rN" / "cN", 1-based in the text, 0-based out.
+static bool ref(Cursor &c, char prefix, uint8_t count, uint8_t &out, const char *what)
+{
+    skipSpace(c);
+    if (tolower(*c.p) != prefix) {
+        if (!c.err) c.err = (prefix == 'r') ? "expected rN" : "expected cN";
+        return false;
+    }
+    c.p++;
+    long v;
+    if (!number(c, 1, count, v, what)) return false;
+    out = (uint8_t)(v - 1);
+    return true;
+}
+
+static bool addTerm(Cursor &c, RuleProgram &prog, const RuleTerm &t)
+{
+    if (prog.termCount >= RULE_MAX_TERMS) {
+        if (!c.err) c.err = "too many tests";
+        return false;
+    }
+    prog.terms[prog.termCount++] = t;
+    return true;
+}
+
+// ['!'] cN (> | < | >= | <= | != | = V[..V])
+static bool term(Cursor &c, RuleProgram &prog, uint8_t flags, ChannelMask &inputs)
+{
+    RuleTerm t = { 0, 0, 255, flags };
+    if (accept(c, "!")) t.flags ^= RULE_TERM_NOT;
+    if (!ref(c, 'c', CHANNEL_WINDOW, t.chan, "channel out of range")) return false;
+
+    long v, v2;
+    if (accept(c, ">=")) {
+        if (!number(c, 0, 255, v, "bad value")) return false;
+        t.lo = v;
+    } else if (accept(c, "<=")) {
+        if (!number(c, 0, 255, v, "bad value")) return false;
+        t.hi = v;
+    } else if (accept(c, "!=")) {
+        if (!number(c, 0, 255, v, "bad value")) return false;
+        t.lo = t.hi = v;
+        t.flags ^= RULE_TERM_NOT;
+    } else if (accept(c, ">")) {
+        if (!number(c, 0, 254, v, "bad value")) return false;
+        t.lo = v + 1;
+    } else if (accept(c, "<")) {
+        if (!number(c, 1, 255, v, "bad value")) return false;
+        t.hi = v - 1;
+    } else if (accept(c, "=")) {
+        if (!number(c, 0, 255, v, "bad value")) return false;
+        t.lo = t.hi = v;
+        if (accept(c, "..")) {
+            if (!number(c, v, 255, v2, "bad band")) return false;
+            t.hi = v2;
+        }
+    } else {
+        if (!c.err) c.err = "expected comparison";
+        return false;
+    }
+
+    inputs |= (ChannelMask)1 << t.chan;
+    return addTerm(c, prog, t);
+}
+
+static bool addRule(Cursor &c, RuleProgram &prog, uint8_t relay, uint8_t first,
+                    ChannelMask inputs)
+{
+    RelayMask bit = (RelayMask)1 << relay;
+    if (prog.ruled & bit) {
+        if (!c.err) c.err = "relay has two rules";
+        return false;
+    }
+    if (prog.ruleCount >= RULE_MAX_RULES) {
+        if (!c.err) c.err = "too many rules";
+        return false;
+    }
+    prog.rules[prog.ruleCount++] = { relay, first, (uint8_t)(prog.termCount - first), inputs };
+    prog.ruled |= bit;
+    return true;
+}
+
+// r1,r2,... = sel cN [dead MS]
+static bool selector(Cursor &c, RuleProgram &prog, const uint8_t *relays, uint8_t n)
+{
+    uint8_t chan;
+    long    dead = 0;
+    if (!ref(c, 'c', CHANNEL_WINDOW, chan, "channel out of range")) return false;
+    if (accept(c, "dead") && !number(c, 0, 60000, dead, "bad dead time")) return false;
+
+    RelayMask group = 0;
+    for (uint8_t i = 0; i < n; i++) group |= (RelayMask)1 << relays[i];
+
+    // n+1 equal bands over 0..255, band 0 selects nothing.
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t  first = prog.termCount;
+        RuleTerm t = { chan, (uint8_t)(256 * (i + 1) / (n + 1)),
+                       (uint8_t)(256 * (i + 2) / (n + 1) - 1), 0 };
+        if (!addTerm(c, prog, t)) return false;
+        if (!addRule(c, prog, relays[i], first, (ChannelMask)1 << chan)) return false;
+
+        prog.interlock[relays[i]] = group & ~((RelayMask)1 << relays[i]);
+        prog.deadMs[relays[i]]    = (uint16_t)dead;
+    }
+    return true;
+}
+
+static bool statement(Cursor &c, RuleProgram &prog)
+{
+    uint8_t relays[NUM_RELAYS];
+    uint8_t n = 0;
+    do {
+        if (n >= NUM_RELAYS) {
+            if (!c.err) c.err = "too many relays";
+            return false;
+        }
+        if (!ref(c, 'r', NUM_RELAYS, relays[n++], "relay out of range")) return false;
+    } while (accept(c, ","));
+
+    if (!accept(c, "=")) {
+        if (!c.err) c.err = "expected '='";
+        return false;
+    }
+
+    if (accept(c, "sel")) {
+        if (!selector(c, prog, relays, n)) return false;
+    } else {
+        if (n != 1) {
+            if (!c.err) c.err = "several relays need 'sel'";
+            return false;
+        }
+        uint8_t     first  = prog.termCount;
+        ChannelMask inputs = 0;
+        uint8_t     flags  = 0;
+        do {
+            if (!term(c, prog, flags, inputs)) return false;
+            flags = 0;
+            if (accept(c, "|")) flags = RULE_TERM_OR;
+            else if (!accept(c, "&")) break;
+        } while (true);
+        if (flags) {
+            if (!c.err) c.err = "dangling '|'";
+            return false;
+        }
+        if (!addRule(c, prog, relays[0], first, inputs)) return false;
+    }
+
+    if (!atStmtEnd(c)) {
+        if (!c.err) c.err = "unexpected text";
+        return false;
+    }
+    return true;
+}
+
+bool rulesCompile(const char *src, RuleProgram &out, char *err, size_t errLen)
+{
+    memset(&out, 0, sizeof(out));
+    if (err && errLen) err[0] = '\0';
+    if (!src) return true;
+
+    Cursor   c = { src, nullptr };
+    unsigned stmt = 0;
+    for (;;) {
+        while (atStmtEnd(c) && *c.p) c.p++;     // blank statements
+        if (!*c.p) break;
+        stmt++;
+        if (!statement(c, out)) {
+            if (err) snprintf(err, errLen, "stmt %u: %s", stmt, c.err ? c.err : "syntax error");
+            memset(&out, 0, sizeof(out));
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------- EVALUATION ----------
+
+RelayMask rulesEvaluate(const RuleProgram &prog, const uint8_t *levels,
+                        ChannelMask changed, RelayMask &evaluated)
+{
+    RelayMask result = 0;
+    evaluated = 0;
+
+    for (uint8_t r = 0; r < prog.ruleCount; r++) {
+        const Rule &rule = prog.rules[r];
+        if (!(rule.inputs & changed)) continue;
+
+        // OR of AND groups, flat over the rule's tests
+        bool any = false, all = true;
+        for (uint8_t i = 0; i < rule.termCount; i++) {
+            const RuleTerm &t = prog.terms[rule.firstTerm + i];
+            if (t.flags & RULE_TERM_OR) {
+                any |= all;
+                all  = true;
+            }
+            bool hit = levels[t.chan] >= t.lo && levels[t.chan] <= t.hi;
+            if (t.flags & RULE_TERM_NOT) hit = !hit;
+            all &= hit;
+        }
+        any |= all;
+
+        RelayMask bit = (RelayMask)1 << rule.relay;
+        evaluated |= bit;
+        if (any) result |= bit;
+    }
+    return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "main_config.h"
+
+// ---------- CHANNEL RULES ----------
+//
+// A few lines of text in cfg.rules, compiled once per reconfiguration into
+// range tests and evaluated per frame. Statements are separated by ';' or
+// newlines; relays (rN) and channels (cN) are 1-based, channels relative to
+// the patch start channel:
+//
+//   r3 = c5>200 & c6<50          AND binds tighter than OR ('|')
+//   r4 = c7=100..180             value band, inclusive
+//   r5 = !c1=0 | c2>=128         '!' negates one test
+//   r1,r2 = sel c8 dead 200      c8 picks at most one of r1/r2 (equal
+//                                bands, lowest = none); 200 ms all-off
+//                                between outputs
+//
+// Every comparison compiles to one lo..hi range test, so evaluation is a
+// flat loop over at most RULE_MAX_TERMS tests with no parsing at run time.
+//
+
+#define RULE_MAX_RULES        NUM_RELAYS
+#define RULE_MAX_TERMS        64
+#define RULE_SRC_MAX          192         // cfg.rules length incl. NUL
+
+// One bit per channel in our window.
+typedef RelayMask ChannelMask;
+
+#define RULE_TERM_NOT         0x01        // invert this test
+#define RULE_TERM_OR          0x02        // this test starts a new AND group
+
+struct RuleTerm {
+    uint8_t chan;           // 0-based within the window
+    uint8_t lo;
+    uint8_t hi;
+    uint8_t flags;          // RULE_TERM_*
+};
+
+struct Rule {
+    uint8_t     relay;
+    uint8_t     firstTerm;
+    uint8_t     termCount;
+    ChannelMask inputs;     // re-evaluate only when one of these changed
+};
+
+struct RuleProgram {
+    uint8_t   ruleCount;
+    uint8_t   termCount;
+    RelayMask ruled;                        // relays driven by a rule
+    Rule      rules[RULE_MAX_RULES];
+    RuleTerm  terms[RULE_MAX_TERMS];
+
+    // Selector interlocks: other relays of the same selector, and the
+    // all-off gap before this relay may close.
+    RelayMask interlock[NUM_RELAYS];
+    uint16_t  deadMs[NUM_RELAYS];
+};
+
+// Compile src into out. On error out is left empty and err describes the
+// first problem ("stmt 2: channel out of range").
+bool rulesCompile(const char *src, RuleProgram &out, char *err, size_t errLen);
+
+// Evaluate the rules whose inputs intersect `changed`. Returns their
+// results; `evaluated` gets the relays that were looked at.
+RelayMask rulesEvaluate(const RuleProgram &prog, const uint8_t *levels,
+                        ChannelMask changed, RelayMask &evaluated);
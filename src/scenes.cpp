@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <Preferences.h>
+
+#include "scenes.h"
+#include "packet_task.h"
+#include "relay_output.h"
+#include "remote_log.h"
+
+#define SCENE_MAGIC           (0x53430000UL | NUM_RELAYS)   // "SC" + relay count
+
+struct SceneRecord {
+    uint32_t magic;
+    Scene    scene;
+};
+
+static Scene        g_scenes[SCENE_COUNT];
+static bool         g_used[SCENE_COUNT];
+static uint32_t     g_dirty = 0;                // bit per slot to write / remove
+static portMUX_TYPE g_mux   = portMUX_INITIALIZER_UNLOCKED;
+static Preferences  g_scenePrefs;
+
+static uint32_t     g_recalls = 0;
+static uint32_t     g_recallsRejected = 0;
+
+static_assert(SCENE_COUNT <= 32, "g_dirty has one bit per scene");
+
+static inline RelayMask bit(uint8_t i)
+{
+    return (RelayMask)1 << i;
+}
+
+static void slotKey(char *key, uint8_t slot)
+{
+    sprintf(key, "s%u", slot + 1);
+}
+
+void startScenes()
+{
+    uint8_t loaded = 0;
+    g_scenePrefs.begin("scenes", true);
+    for (uint8_t i = 0; i < SCENE_COUNT; i++) {
+        char key[4];
+        slotKey(key, i);
+        SceneRecord r;
+        if (g_scenePrefs.getBytes(key, &r, sizeof(r)) != sizeof(r) || r.magic != SCENE_MAGIC) continue;
+        r.scene.name[SCENE_NAME_LEN - 1] = '\0';
+        g_scenes[i] = r.scene;
+        g_used[i]   = true;
+        loaded++;
+    }
+    g_scenePrefs.end();
+    LOGI("[SCENE] %u scenes loaded", loaded);
+}
+
+bool sceneGet(uint8_t n, Scene &out)
+{
+    if (n < 1 || n > SCENE_COUNT) return false;
+    portENTER_CRITICAL(&g_mux);
+    bool used = g_used[n - 1];
+    if (used) out = g_scenes[n - 1];
+    portEXIT_CRITICAL(&g_mux);
+    return used;
+}
+
+bool sceneStore(uint8_t n, const Scene &s)
+{
+    if (n < 1 || n > SCENE_COUNT) return false;
+    portENTER_CRITICAL(&g_mux);
+    g_scenes[n - 1] = s;
+    g_scenes[n - 1].name[SCENE_NAME_LEN - 1] = '\0';
+    g_used[n - 1] = true;
+    g_dirty |= 1u << (n - 1);
+    portEXIT_CRITICAL(&g_mux);
+    return true;
+}
+
+bool sceneErase(uint8_t n)
+{
+    if (n < 1 || n > SCENE_COUNT) return false;
+    portENTER_CRITICAL(&g_mux);
+    g_used[n - 1] = false;
+    g_dirty |= 1u << (n - 1);
+    portEXIT_CRITICAL(&g_mux);
+    return true;
+}
+
+bool sceneCapture(uint8_t n, const char *name)
+{
+    Scene s;
+    memset(&s, 0, sizeof(s));
+    strlcpy(s.name, name && name[0] ? name : "", sizeof(s.name));
+    if (!s.name[0]) snprintf(s.name, sizeof(s.name), "Scene %u", n);
+    s.mask  = 0;
+    s.state = relayStateMask();
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        s.mask |= bit(i);
+        s.modes[i] = SCENE_MODE_KEEP;
+    }
+    return sceneStore(n, s);
+}
+
+uint8_t sceneFind(const char *text)
+{
+    if (!text || !text[0]) return 0;
+
+    char *end = nullptr;
+    long  n   = strtol(text, &end, 10);
+    if (*end == '\0') return (n >= 1 && n <= SCENE_COUNT) ? (uint8_t)n : 0;
+
+    uint8_t found = 0;
+    portENTER_CRITICAL(&g_mux);
+    for (uint8_t i = 0; i < SCENE_COUNT && !found; i++) {
+        if (g_used[i] && strcasecmp(g_scenes[i].name, text) == 0) found = i + 1;
+    }
+    portEXIT_CRITICAL(&g_mux);
+    return found;
+}
+
+bool sceneRecall(uint8_t n)
+{
+    if (n < 1 || n > SCENE_COUNT || !g_used[n - 1]) {
+        g_recallsRejected++;
+        return false;
+    }
+    PacketCommand cmd = { PKT_CMD_SCENE, n, 0, 0, 0, 0, 0 };
+    if (!packetCommand(cmd)) {
+        g_recallsRejected++;
+        return false;
+    }
+    return true;
+}
+
+void sceneApply(uint8_t n)
+{
+    Scene s;
+    if (!sceneGet(n, s)) return;
+
+    // A running pulse or a pending delayed close would override the cue.
+    relayCancelTimers(s.mask, s.mask);
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (!(s.mask & bit(i))) continue;
+        if (s.modes[i] != SCENE_MODE_KEEP) relaySetMode(i, s.modes[i]);
+        stageRelay(i, s.state & bit(i));
+    }
+    commitRelays();                 // one flush for the whole cue
+    g_recalls++;
+    LOGD("[SCENE] recalled %u '%s'", n, s.name);
+}
+
+void scenesTick()
+{
+    if (!g_dirty) return;
+
+    for (uint8_t i = 0; i < SCENE_COUNT; i++) {
+        SceneRecord r;
+        bool        write;
+
+        portENTER_CRITICAL(&g_mux);
+        bool dirty = g_dirty & (1u << i);
+        g_dirty &= ~(1u << i);
+        write = g_used[i];
+        if (write) r.scene = g_scenes[i];
+        portEXIT_CRITICAL(&g_mux);
+        if (!dirty) continue;
+
+        char key[4];
+        slotKey(key, i);
+        g_scenePrefs.begin("scenes", false);
+        if (write) {
+            r.magic = SCENE_MAGIC;
+            if (g_scenePrefs.putBytes(key, &r, sizeof(r)) != sizeof(r)) {
+                LOGE("[SCENE] saving scene %u FAILED", i + 1);
+            }
+        } else {
+            g_scenePrefs.remove(key);
+        }
+        g_scenePrefs.end();
+    }
+}
+
+void sceneFormatState(const Scene &s, char *buf, size_t len)
+{
+    size_t n = 0;
+    for (uint8_t i = 0; i < NUM_RELAYS && n + 1 < len; i++, n++) {
+        buf[n] = !(s.mask & bit(i)) ? '-' : (s.state & bit(i)) ? '1' : '0';
+    }
+    if (len) buf[n] = '\0';
+}
+
+bool sceneParseState(Scene &s, const char *text)
+{
+    if (strlen(text) != NUM_RELAYS) return false;
+    s.mask  = 0;
+    s.state = 0;
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (text[i] == '-') continue;
+        if (text[i] != '0' && text[i] != '1') return false;
+        s.mask |= bit(i);
+        if (text[i] == '1') s.state |= bit(i);
+    }
+    return true;
+}
+
+void scenesPrintMetrics(Print &out)
+{
+    uint8_t used = 0;
+    for (uint8_t i = 0; i < SCENE_COUNT; i++) used += g_used[i];
+    out.printf("relay_scenes_stored %u\n", (unsigned)used);
+    out.printf("relay_scene_recalls_total %u\n", (unsigned)g_recalls);
+    out.printf("relay_scene_recalls_rejected_total %u\n", (unsigned)g_recallsRejected);
+}
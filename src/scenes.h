@@ -0,0 +1,70 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "main_config.h"
+
+class Print;
+
+// ---------- SCENES ----------
+//
+// A scene is a stored set of relay states, optionally with a RelayMode per
+// relay, recalled as one cue: every relay it touches is staged and the
+// whole scene goes out in a single commit (one I2C flush) from the packet
+// task. Recall sources:
+//
+//   Art-Net  ArtTrigger, Key = KeyMacro (1) or KeyShow (3), SubKey = scene
+//            ArtCommand "Scene=<n>&"
+//   control  SCENE <n|name>         (UDP port, see control.h)
+//   HTTP     POST /api/recall_scene scene=<n|name>
+//
+// Scenes are numbered 1..SCENE_COUNT like console macros. They live in
+// RAM; changes are written to NVS from loop() (scenesTick), one key per
+// scene. Modes a scene sets are runtime overrides (relaySetMode), never
+// saved to the configuration. Recall cancels the touched relays' pulse and
+// delay timers. Show data that arrives afterwards drives the relays again
+// as usual.
+//
+
+#define SCENE_COUNT           16
+#define SCENE_NAME_LEN        16          // incl. NUL
+#define SCENE_MODE_KEEP       0xFF        // Scene.modes[]: leave the mode alone
+
+struct Scene {
+    char      name[SCENE_NAME_LEN];
+    RelayMask mask;         // relays the scene sets
+    RelayMask state;        // their state, bits outside mask ignored
+    uint8_t   modes[NUM_RELAYS];    // RelayMode or SCENE_MODE_KEEP
+};
+
+// Load stored scenes from NVS.
+void startScenes();
+
+// false if n is out of range or the slot is empty.
+bool sceneGet(uint8_t n, Scene &out);
+
+// Store / clear a slot (RAM now, flash from scenesTick()).
+bool sceneStore(uint8_t n, const Scene &s);
+bool sceneErase(uint8_t n);
+
+// Current state of every relay, modes untouched.
+bool sceneCapture(uint8_t n, const char *name);
+
+// "3" or a scene name -> scene number, 0 if none.
+uint8_t sceneFind(const char *text);
+
+// Any task: hand the recall to the packet task. false = no such scene or
+// the command queue is full.
+bool sceneRecall(uint8_t n);
+
+// Packet task: stage the scene and commit once.
+void sceneApply(uint8_t n);
+
+// Persist changed slots. Call from loop().
+void scenesTick();
+
+// Scene state as one character per relay: '1' / '0', '-' = not in the
+// scene (same format as the MQTT relays/set payload).
+void sceneFormatState(const Scene &s, char *buf, size_t len);
+bool sceneParseState(Scene &s, const char *text);
+
+void scenesPrintMetrics(Print &out);
@@ -0,0 +1,109 @@
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_timer.h>
+
+#include "status_led.h"
+#include "remote_log.h"
+
+// ---------- PATTERNS ----------
+//
+// Each pattern is 32 steps of LED_TICK_MS, LSB first, so one cycle is 1.6 s.
+// Field staff read them like this:
+//
+//   OTA        : fast flicker          (uploading firmware, don't unplug)
+//   No WiFi    : one short blip        (not associated to the AP)
+//   Failsafe   : double blip           (link up, show data stopped > timeout)
+//   Idle       : slow on/off           (link up, no data seen yet)
+//   Data       : mostly ON with 1..5 dark gaps for ArtNet / E1.31 / DDP /
+//                OPC / KiNET;
+//                several live protocols take turns, one per cycle
+//
+
+#define LED_TICK_MS       50
+#define LED_STEPS         32
+
+static const uint32_t PAT_OTA       = 0x55555555;
+static const uint32_t PAT_NO_LINK   = 0x00000003;
+static const uint32_t PAT_FAILSAFE  = 0x00000033;
+static const uint32_t PAT_IDLE      = 0x0000FFFF;
+static const uint32_t PAT_DATA[PROTO_COUNT] = {
+    ~0x00000006u,   // ArtNet: one gap
+    ~0x00000066u,   // E1.31 : two gaps
+    ~0x00000666u,   // DDP   : three gaps
+    ~0x00006666u,   // OPC   : four gaps
+    ~0x00066666u,   // KiNET : five gaps
+};
+
+std::atomic<uint8_t> g_ledActivity{0};
+
+static std::atomic<bool> g_failsafe{false};
+static std::atomic<bool> g_ota{false};
+
+static esp_timer_handle_t g_ledTimer = nullptr;
+static uint8_t  g_ledPin     = 0xFF;
+static uint8_t  g_step       = 0;
+static uint32_t g_pattern    = PAT_NO_LINK;
+static uint8_t  g_lastProto  = 0;
+static bool     g_ledLevel   = false;
+
+// Pick the next pattern at a cycle boundary from what happened last cycle.
+static uint32_t choosePattern(uint8_t activity)
+{
+    if (g_ota.load(std::memory_order_relaxed))      return PAT_OTA;
+    if (WiFi.status() != WL_CONNECTED)              return PAT_NO_LINK;
+    if (activity) {
+        // Round-robin through the protocols that were live last cycle.
+        for (uint8_t n = 1; n <= PROTO_COUNT; n++) {
+            uint8_t p = (g_lastProto + n) % PROTO_COUNT;
+            if (activity & (1u << p)) {
+                g_lastProto = p;
+                return PAT_DATA[p];
+            }
+        }
+    }
+    if (g_failsafe.load(std::memory_order_relaxed)) return PAT_FAILSAFE;
+    return PAT_IDLE;
+}
+
+static void ledTick(void *)
+{
+    if (g_step == 0) {
+        uint8_t activity = g_ledActivity.exchange(0, std::memory_order_relaxed);
+        g_pattern = choosePattern(activity);
+    }
+
+    bool level = (g_pattern >> g_step) & 1u;
+    if (level != g_ledLevel) {          // only touch the pin on edges
+        digitalWrite(g_ledPin, level ? HIGH : LOW);
+        g_ledLevel = level;
+    }
+
+    g_step = (g_step + 1) % LED_STEPS;
+}
+
+void startStatusLed(uint8_t pin)
+{
+    if (g_ledTimer) return;
+
+    g_ledPin = pin;
+    pinMode(g_ledPin, OUTPUT);
+    digitalWrite(g_ledPin, LOW);
+
+    esp_timer_create_args_t args = {};
+    args.callback = ledTick;
+    args.name     = "status_led";
+    if (esp_timer_create(&args, &g_ledTimer) != ESP_OK ||
+        esp_timer_start_periodic(g_ledTimer, LED_TICK_MS * 1000ULL) != ESP_OK) {
+        LOGE("[LED] status timer init FAILED");
+    }
+}
+
+void statusLedSetFailsafe(bool on)
+{
+    g_failsafe.store(on, std::memory_order_relaxed);
+}
+
+void statusLedSetOta(bool on)
+{
+    g_ota.store(on, std::memory_order_relaxed);
+}
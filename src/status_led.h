@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+
+#include "protocol.h"
+
+// Start the timer-driven pattern engine on the given GPIO.
+void startStatusLed(uint8_t pin);
+
+// Latched by the packet path, collected by the LED timer.
+extern std::atomic<uint8_t> g_ledActivity;
+
+// Packet path hook: one relaxed atomic OR, no GPIO work. proto is a ProtoId.
+inline void statusLedPacket(uint8_t proto)
+{
+    g_ledActivity.fetch_or((uint8_t)(1u << proto), std::memory_order_relaxed);
+}
+
+// Overall receive timeout hit (or cleared again by new data).
+void statusLedSetFailsafe(bool on);
+
+// Firmware upload in progress.
+void statusLedSetOta(bool on);
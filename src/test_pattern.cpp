@@ -0,0 +1,149 @@
+#include <Arduino.h>
+
+#include "test_pattern.h"
+#include "main_config.h"
+#include "relay_output.h"
+#include "i2c_output.h"
+#include "remote_log.h"
+
+#define PULSE_STEPS   6           // on/off x3
+
+static TestPattern   g_pattern = TestPattern::None;
+static uint16_t      g_step    = 0;
+static uint16_t      g_stepMs  = TEST_STEP_DEFAULT_MS;
+static uint8_t       g_arg     = 0;
+static unsigned long g_lastMs  = 0;
+
+static const char *const PATTERN_NAMES[] = { "none", "walk", "pulse", "chase", "board" };
+
+const char *testPatternName(TestPattern p)
+{
+    return PATTERN_NAMES[(uint8_t)p];
+}
+
+TestPattern testPatternFromName(const char *name)
+{
+    for (uint8_t i = 1; i < sizeof(PATTERN_NAMES) / sizeof(PATTERN_NAMES[0]); i++) {
+        if (strcasecmp(name, PATTERN_NAMES[i]) == 0) return (TestPattern)i;
+    }
+    return TestPattern::None;
+}
+
+bool testPatternRunning()
+{
+    return g_pattern != TestPattern::None;
+}
+
+TestPattern testPatternCurrent()
+{
+    return g_pattern;
+}
+
+static void stageAll(bool on)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) stageRelay(i, on);
+}
+
+static bool onBoard(uint8_t relay)
+{
+    return cfg.relays[relay].gpio / PCA9685_OUTPUTS == g_arg;
+}
+
+// Stage the outputs for g_step; false when the pattern is finished.
+static bool renderStep()
+{
+    switch (g_pattern) {
+    case TestPattern::Walk:
+        if (g_step >= NUM_RELAYS) return false;
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) stageRelay(i, i == g_step);
+        return true;
+
+    case TestPattern::Pulse:
+        if (g_step >= PULSE_STEPS) return false;
+        stageAll((g_step & 1) == 0);
+        return true;
+
+    case TestPattern::Chase: {
+        g_step %= NUM_RELAYS;                   // runs until stopped
+        uint8_t head = g_step;
+        uint8_t tail = (head + NUM_RELAYS - 1) % NUM_RELAYS;
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) stageRelay(i, i == head || i == tail);
+        return true;
+    }
+
+    case TestPattern::Board:
+        // Skip relays that live on other boards without spending a step.
+        while (g_step < NUM_RELAYS && !onBoard(g_step)) g_step++;
+        if (g_step >= NUM_RELAYS) return false;
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) stageRelay(i, i == g_step);
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+bool testPatternStart(TestPattern p, uint16_t stepMs, uint8_t arg)
+{
+    if (p == TestPattern::None) {
+        testPatternStop();
+        return true;
+    }
+
+    g_pattern = p;
+    g_step    = 0;
+    g_stepMs  = stepMs ? stepMs : TEST_STEP_DEFAULT_MS;
+    g_arg     = arg;
+    g_lastMs  = millis();
+
+    if (!renderStep()) {
+        g_pattern = TestPattern::None;
+        return false;
+    }
+    commitRelays();
+    LOGI("[TEST] %s started (%u ms/step)", testPatternName(p), g_stepMs);
+    return true;
+}
+
+bool testPatternParseStep(const char *text, uint16_t &stepMs)
+{
+    char *end = nullptr;
+    long  ms  = strtol(text, &end, 10);
+    if (end == text || *end || ms < TEST_STEP_MIN_MS || ms > TEST_STEP_MAX_MS) return false;
+    stepMs = (uint16_t)ms;
+    return true;
+}
+
+void testPatternStop()
+{
+    if (g_pattern == TestPattern::None) return;
+    LOGI("[TEST] %s stopped", testPatternName(g_pattern));
+    g_pattern = TestPattern::None;
+    stageAll(false);
+    commitRelays();
+}
+
+void testPatternPreempt()
+{
+    if (g_pattern == TestPattern::None) return;
+    LOGI("[TEST] %s pre-empted by show data", testPatternName(g_pattern));
+    g_pattern = TestPattern::None;
+    stageAll(false);
+}
+
+void testPatternTick()
+{
+    if (g_pattern == TestPattern::None) return;
+
+    unsigned long now = millis();
+    if (now - g_lastMs < g_stepMs) return;
+    g_lastMs = now;
+
+    g_step++;
+    if (!renderStep()) {
+        LOGI("[TEST] %s complete", testPatternName(g_pattern));
+        g_pattern = TestPattern::None;
+        stageAll(false);
+    }
+    commitRelays();
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+enum class TestPattern : uint8_t {
+    None = 0,
+    Walk,       // one relay at a time, like the old POST
+    Pulse,      // all on / all off, a few times
+    Chase,      // two adjacent relays running round, until stopped
+    Board,      // walk only the outputs of one PCA9685 board
+};
+
+#define TEST_STEP_DEFAULT_MS  300
+#define TEST_STEP_MIN_MS      20          // relays are not buzzers
+#define TEST_STEP_MAX_MS      60000
+
+// Start a pattern on the output path; replaces whatever is running.
+// stepMs = time per step, arg = board number for TestPattern::Board.
+bool testPatternStart(TestPattern p, uint16_t stepMs = TEST_STEP_DEFAULT_MS, uint8_t arg = 0);
+
+// "250" -> 250 ms per step; false unless a plain number within
+// TEST_STEP_MIN_MS..TEST_STEP_MAX_MS (API and control port input).
+bool testPatternParseStep(const char *text, uint16_t &stepMs);
+
+// Stop and switch everything off.
+void testPatternStop();
+
+// Show data arrived: stop before the first frame is dispatched. Every
+// relay is staged off, not committed; the frame stages over that and its
+// commit sends both, so no pattern step ever mixes with show data.
+void testPatternPreempt();
+
+// Advance the state machine; cheap when idle. Call from the packet task.
+void testPatternTick();
+
+bool        testPatternRunning();
+TestPattern testPatternCurrent();
+
+const char *testPatternName(TestPattern p);
+TestPattern testPatternFromName(const char *name);   // None if unknown
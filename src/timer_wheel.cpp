@@ -0,0 +1,87 @@
+#include <string.h>
+
+#include "timer_wheel.h"
+
+static void link(TimerNode *&head, TimerNode &n)
+{
+    n.next  = head;
+    n.pprev = &head;
+    if (head) head->pprev = &n.next;
+    head = &n;
+}
+
+static void place(TimerWheel &w, TimerNode &n)
+{
+    uint32_t delta = n.expires - w.tick;
+    if (delta < WHEEL_SLOTS) link(w.level0[n.expires & WHEEL_MASK], n);
+    else                     link(w.level1[(n.expires >> WHEEL_BITS) & WHEEL_MASK], n);
+}
+
+void wheelInit(TimerWheel &w, uint32_t nowMs)
+{
+    memset(&w, 0, sizeof(w));
+    w.lastMs = nowMs;
+}
+
+static void unlink(TimerNode &n)
+{
+    *n.pprev = n.next;
+    if (n.next) n.next->pprev = n.pprev;
+    n.next  = nullptr;
+    n.pprev = nullptr;
+}
+
+void wheelCancel(TimerWheel &w, TimerNode &n)
+{
+    if (!n.pprev) return;
+    unlink(n);
+    w.pending--;
+}
+
+void wheelSchedule(TimerWheel &w, TimerNode &n, uint32_t nowMs, uint32_t delayMs)
+{
+    wheelCancel(w, n);
+    if (delayMs > WHEEL_MAX_MS) delayMs = WHEEL_MAX_MS;
+
+    // Counted from the last processed tick (not from an absolute time, so
+    // millis() wrapping can't shift it), rounded up so a timer never fires
+    // early; at least one tick away.
+    uint32_t since = nowMs - w.lastMs;
+    if (since > WHEEL_MAX_MS) since = WHEEL_MAX_MS;
+    uint32_t ticks = (since + delayMs + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    if (ticks < 1) ticks = 1;
+    if (ticks > WHEEL_MAX_MS / WHEEL_TICK_MS) ticks = WHEEL_MAX_MS / WHEEL_TICK_MS;
+    n.expires = w.tick + ticks;
+    place(w, n);
+    w.pending++;
+}
+
+uint16_t wheelAdvance(TimerWheel &w, uint32_t nowMs, void (*expire)(TimerNode &))
+{
+    uint16_t fired = 0;
+
+    while (nowMs - w.lastMs >= WHEEL_TICK_MS) {
+        w.lastMs += WHEEL_TICK_MS;
+        w.tick++;
+
+        // Entering a new 64-tick block: pull its level 1 bucket down.
+        if ((w.tick & WHEEL_MASK) == 0) {
+            TimerNode *n = w.level1[(w.tick >> WHEEL_BITS) & WHEEL_MASK];
+            w.level1[(w.tick >> WHEEL_BITS) & WHEEL_MASK] = nullptr;
+            while (n) {
+                TimerNode *next = n->next;
+                place(w, *n);
+                n = next;
+            }
+        }
+
+        TimerNode *&slot = w.level0[w.tick & WHEEL_MASK];
+        while (slot) {
+            TimerNode &n = *slot;
+            wheelCancel(w, n);
+            expire(n);
+            fired++;
+        }
+    }
+    return fired;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <stdint.h>
+
+// ---------- HIERARCHICAL TIMER WHEEL ----------
+//
+// Two levels of 64 slots: level 0 holds timers due within the next 64
+// ticks, level 1 holds the rest in 64-tick buckets and is cascaded into
+// level 0 one bucket at a time. Scheduling, cancelling and expiring a
+// timer are O(1); nothing scans all timers per tick.
+//
+// Time is passed in by the caller (milliseconds), so the wheel has no
+// clock of its own and can be stepped by any clock source. Only elapsed
+// time (nowMs - lastMs) is used, so millis() wrapping is harmless.
+//
+
+#define WHEEL_TICK_MS         10
+#define WHEEL_BITS            6
+#define WHEEL_SLOTS           (1u << WHEEL_BITS)
+#define WHEEL_MASK            (WHEEL_SLOTS - 1)
+#define WHEEL_MAX_MS          ((uint32_t)WHEEL_SLOTS * (WHEEL_SLOTS - 1) * WHEEL_TICK_MS)
+
+// Intrusive node: embed one per timer, owned by the caller.
+struct TimerNode {
+    TimerNode  *next;
+    TimerNode **pprev;      // nullptr = not scheduled
+    uint32_t    expires;    // in ticks
+    uint8_t     id;         // caller's tag (e.g. relay index)
+};
+
+struct TimerWheel {
+    uint32_t   tick;        // last tick processed
+    uint32_t   lastMs;      // time of that tick
+    uint16_t   pending;     // nodes scheduled
+    TimerNode *level0[WHEEL_SLOTS];
+    TimerNode *level1[WHEEL_SLOTS];
+};
+
+void wheelInit(TimerWheel &w, uint32_t nowMs);
+
+// (Re)arm node to fire delayMs from nowMs; longer delays are clamped to
+// WHEEL_MAX_MS. Re-arming a pending node moves it.
+void wheelSchedule(TimerWheel &w, TimerNode &n, uint32_t nowMs, uint32_t delayMs);
+
+void wheelCancel(TimerWheel &w, TimerNode &n);
+
+inline bool wheelPending(const TimerNode &n)
+{
+    return n.pprev != nullptr;
+}
+
+// Any node scheduled at all; O(1), for "keep ticking" decisions.
+inline bool wheelBusy(const TimerWheel &w)
+{
+    return w.pending != 0;
+}
+
+// Process every tick up to nowMs, calling expire() for each due node (the
+// node is already unlinked and may be re-armed). Returns the number fired.
+uint16_t wheelAdvance(TimerWheel &w, uint32_t nowMs, void (*expire)(TimerNode &));
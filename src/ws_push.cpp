@@ -0,0 +1,69 @@
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+
+#include "ws_push.h"
+#include "event_bus.h"
+#include "relay_output.h"
+#include "remote_log.h"
+
+static AsyncWebSocket g_ws("/ws");
+static int            g_sub = -1;
+static RelayEvent     g_last;          // newest state not yet sent
+static bool           g_pending = false;
+static uint32_t       g_sent    = 0;
+static uint32_t       g_skipped = 0;   // ticks deferred, clients were busy
+
+static void wsEvent(AsyncWebSocket *, AsyncWebSocketClient *client, AwsEventType type,
+                    void *, uint8_t *, size_t)
+{
+    if (type != WS_EVT_CONNECT) return;
+
+    // New browser: current state straight away, then deltas from the bus.
+    RelayEvent now = { 0, 0, 0, relayStateMask() };
+    char msg[EVENT_FORMAT_LEN];
+    eventBusFormat(now, msg, sizeof(msg));
+    client->text(msg);
+}
+
+void startWsPush(AsyncWebServer &server)
+{
+    g_sub = eventBusSubscribe("ws");
+    g_ws.onEvent(wsEvent);
+    server.addHandler(&g_ws);
+}
+
+void wsPushTick()
+{
+    // Only the newest state matters to a browser: collapse the backlog.
+    RelayEvent ev;
+    while (eventBusPoll(g_sub, ev)) {
+        g_last    = ev;
+        g_pending = true;
+    }
+
+    g_ws.cleanupClients();
+    if (!g_pending) return;
+    if (!g_ws.count()) {
+        g_pending = false;              // a new client gets the state on connect
+        return;
+    }
+
+    if (!g_ws.availableForWriteAll()) {
+        g_skipped++;
+        LOGD("[WS] client queue full, update %u deferred", (unsigned)g_last.seq);
+        return;
+    }
+
+    char msg[EVENT_FORMAT_LEN];
+    size_t len = eventBusFormat(g_last, msg, sizeof(msg));
+    g_ws.textAll(msg, len);
+    g_pending = false;
+    g_sent++;
+}
+
+void wsPushPrintMetrics(Print &out)
+{
+    out.printf("relay_ws_clients %u\n", (unsigned)g_ws.count());
+    out.printf("relay_ws_updates_sent_total %u\n", (unsigned)g_sent);
+    out.printf("relay_ws_updates_deferred_total %u\n", (unsigned)g_skipped);
+}
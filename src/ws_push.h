@@ -0,0 +1,16 @@
+#pragma once
+
+class AsyncWebServer;
+class Print;
+
+// Relay state pushed to browsers over /ws as it changes. Fed from the
+// output event bus, so a slow or stalled browser only drops its own
+// updates and never holds up a commit.
+void startWsPush(AsyncWebServer &server);
+
+// Forward pending events (call from loop()). An update the clients
+// can't take yet is kept and retried on the next tick.
+void wsPushTick();
+
+// Updates sent / deferred because a client queue was full.
+void wsPushPrintMetrics(Print &out);
@@ -0,0 +1,309 @@
+// Loopback test of the fan-out gateway (src/gateway_router.h).
+//
+// Runs the gateway's router against emulated downstream nodes on this
+// host: a sender streams a test pattern as DDP (or E1.31 with -e) to a
+// gateway loop on 127.0.0.1, which slices it with the same router code the
+// controller uses and forwards DDP to nodes listening on 127.0.0.10,
+// 127.0.0.11, ... Each node checks that every packet it gets holds one
+// whole, consistent frame of its window, then prints per node:
+//
+//   frames    packets received / frames sent
+//   bad       packets with wrong offset, length or mixed-frame data
+//   partial   router sends before the window was complete
+//
+// Build and run (Linux; every 127.x address is loopback there):
+//   g++ -std=c++11 -O2 -pthread -Isrc -o gateway_loopback tools/gateway_loopback.cpp src/gateway_router.cpp
+//   ./gateway_loopback [-n nodes] [-c channels] [-f frames] [-r fps] [-e] [-s size]
+//
+// Exits 1 when a node missed a frame or got bad data.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gateway_router.h"
+
+#define DDP_PORT              4048
+#define DDP_HEADER_LEN        10
+#define DDP_FLAGS_PUSH        0x01
+#define E131_PORT             5568
+#define E131_UNIVERSE         113
+#define E131_PROP_COUNT       123
+#define E131_START_ADDRESS    126
+#define NODE_BASE             10          // first node on 127.0.0.10
+
+struct Node {
+    std::thread           thread;
+    int                   fd;
+    uint32_t              first;          // 0-based in the stream
+    uint16_t              count;
+    std::atomic<uint32_t> packets;
+    std::atomic<uint32_t> bad;
+};
+
+static std::atomic<bool> g_stop(false);
+
+// Byte of channel ch in frame f; a node recovers f from its first byte.
+static inline uint8_t pattern(uint32_t f, uint32_t ch)
+{
+    return (uint8_t)(f * 7 + ch);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: gateway_loopback [-n nodes] [-c channels] [-f frames] [-r fps]"
+                    " [-e] [-s universe size]\n");
+    exit(2);
+}
+
+static int udpSocket(uint32_t ip, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { perror("socket"); exit(1); }
+    int buf = 1 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    timeval tv = { 0, 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    sockaddr_in a;
+    memset(&a, 0, sizeof(a));
+    a.sin_family      = AF_INET;
+    a.sin_port        = htons(port);
+    a.sin_addr.s_addr = ip;
+    if (bind(fd, (sockaddr *)&a, sizeof(a)) < 0) {
+        fprintf(stderr, "bind %s:%u: %s\n", inet_ntoa(a.sin_addr), port, strerror(errno));
+        exit(1);
+    }
+    return fd;
+}
+
+static uint32_t loopback(uint8_t host)
+{
+    return htonl(0x7F000000u | host);
+}
+
+// ---------- NODES ----------
+
+static void nodeLoop(Node *n)
+{
+    uint8_t buf[2048];
+    while (!g_stop) {
+        ssize_t len = recv(n->fd, buf, sizeof(buf), 0);
+        if (len < 0) continue;
+        n->packets++;
+
+        uint32_t offset  = ((uint32_t)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+        uint16_t dataLen = (buf[8] << 8) | buf[9];
+        if (len != DDP_HEADER_LEN + n->count || offset != 0 || dataLen != n->count) {
+            n->bad++;
+            continue;
+        }
+        const uint8_t *d = buf + DDP_HEADER_LEN;
+        uint32_t f = (uint8_t)((d[0] - n->first) * 183);       // 183 = 7^-1 mod 256
+        for (uint16_t j = 0; j < n->count; j++) {
+            if (d[j] != pattern(f, n->first + j)) { n->bad++; break; }
+        }
+    }
+}
+
+// ---------- GATEWAY ----------
+
+struct Gateway {
+    int           fd;                     // receive
+    int           out;                    // forward
+    bool          e131;
+    uint16_t      universeSize;
+    GatewayRouter router;
+};
+
+static bool gatewaySend(uint32_t ip, const uint8_t *pkt, size_t len, void *ctx)
+{
+    Gateway *g = (Gateway *)ctx;
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_port        = htons(DDP_PORT);
+    to.sin_addr.s_addr = ip;
+    return sendto(g->out, pkt, len, 0, (sockaddr *)&to, sizeof(to)) == (ssize_t)len;
+}
+
+// Same header handling as proto_ddp.cpp / proto_e131.cpp feeding gateway.cpp.
+static void gatewayLoop(Gateway *g)
+{
+    uint8_t buf[2048];
+    while (!g_stop) {
+        ssize_t len = recv(g->fd, buf, sizeof(buf), 0);
+        if (len <= 0) continue;
+
+        if (g->e131) {
+            if (len <= E131_START_ADDRESS) continue;
+            uint16_t universe = (buf[E131_UNIVERSE] << 8) | buf[E131_UNIVERSE + 1];
+            uint32_t slots    = (buf[E131_PROP_COUNT] << 8) | buf[E131_PROP_COUNT + 1];
+            if (E131_START_ADDRESS - 1 + slots > (uint32_t)len) slots = len - E131_START_ADDRESS + 1;
+            if (universe < 1 || slots < 2) continue;
+            gatewayRouterIngest(g->router, (uint32_t)(universe - 1) * g->universeSize,
+                                buf + E131_START_ADDRESS, slots - 1);
+        } else {
+            if (len <= DDP_HEADER_LEN) continue;
+            uint32_t offset  = ((uint32_t)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8) | buf[7];
+            uint32_t dataLen = (buf[8] << 8) | buf[9];
+            if (DDP_HEADER_LEN + dataLen > (uint32_t)len) dataLen = len - DDP_HEADER_LEN;
+            gatewayRouterIngest(g->router, offset, buf + DDP_HEADER_LEN, dataLen);
+            if (buf[0] & DDP_FLAGS_PUSH) gatewayRouterPush(g->router);
+        }
+    }
+}
+
+// ---------- SENDER ----------
+
+static void sendDdp(int fd, const sockaddr_in &to, uint32_t f, uint32_t total)
+{
+    uint8_t pkt[DDP_HEADER_LEN + GATEWAY_ROUTE_MAX];
+    for (uint32_t at = 0; at < total; at += GATEWAY_ROUTE_MAX) {
+        uint32_t n = total - at < GATEWAY_ROUTE_MAX ? total - at : GATEWAY_ROUTE_MAX;
+        pkt[0] = 0x40 | (at + n == total ? DDP_FLAGS_PUSH : 0);
+        pkt[1] = 1 + f % 15;
+        pkt[2] = 0;
+        pkt[3] = 1;
+        pkt[4] = at >> 24; pkt[5] = at >> 16; pkt[6] = at >> 8; pkt[7] = at;
+        pkt[8] = n >> 8;   pkt[9] = n & 0xFF;
+        for (uint32_t j = 0; j < n; j++) pkt[DDP_HEADER_LEN + j] = pattern(f, at + j);
+        sendto(fd, pkt, DDP_HEADER_LEN + n, 0, (const sockaddr *)&to, sizeof(to));
+    }
+}
+
+static void sendE131(int fd, const sockaddr_in &to, uint32_t f, uint32_t total, uint16_t size)
+{
+    uint8_t pkt[E131_START_ADDRESS + 512];
+    for (uint32_t at = 0, u = 1; at < total; at += size, u++) {
+        uint32_t n = total - at < size ? total - at : size;
+        memset(pkt, 0, E131_START_ADDRESS);
+        pkt[1] = 0x10;
+        memcpy(pkt + 4, "ASC-E1.17", 9);
+        pkt[21] = 0x04;                                 // root vector: data
+        pkt[43] = 0x02;                                 // frame vector: DMP
+        strcpy((char *)pkt + 44, "gateway_loopback");
+        pkt[108] = 100;                                 // priority
+        pkt[111] = f & 0xFF;                            // sequence
+        pkt[E131_UNIVERSE]       = u >> 8;
+        pkt[E131_UNIVERSE + 1]   = u & 0xFF;
+        pkt[117] = 0x02;                                // DMP vector
+        pkt[118] = 0xA1;
+        pkt[122] = 1;                                   // address increment
+        pkt[E131_PROP_COUNT]     = (n + 1) >> 8;
+        pkt[E131_PROP_COUNT + 1] = (n + 1) & 0xFF;
+        for (uint32_t j = 0; j < n; j++) pkt[E131_START_ADDRESS + j] = pattern(f, at + j);
+        sendto(fd, pkt, E131_START_ADDRESS + n, 0, (const sockaddr *)&to, sizeof(to));
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int      nodes    = 8;
+    int      channels = 510;
+    int      frames   = 200;
+    int      fps      = 40;
+    bool     e131     = false;
+    int      size     = 510;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:f:r:es:")) != -1) {
+        switch (opt) {
+        case 'n': nodes    = atoi(optarg); break;
+        case 'c': channels = atoi(optarg); break;
+        case 'f': frames   = atoi(optarg); break;
+        case 'r': fps      = atoi(optarg); break;
+        case 'e': e131     = true;         break;
+        case 's': size     = atoi(optarg); break;
+        default:  usage();
+        }
+    }
+    if (nodes < 1 || nodes > GATEWAY_MAX_ROUTES || channels < 1 || channels > GATEWAY_ROUTE_MAX ||
+        frames < 1 || fps < 1 || size < 1 || size > 512) {
+        usage();
+    }
+
+    std::string routes;
+    for (int i = 0; i < nodes; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "127.0.0.%d %d+%d;", NODE_BASE + i, 1 + i * channels, channels);
+        routes += line;
+    }
+
+    Gateway g;
+    GatewayTable t;
+    char err[64];
+    if (!gatewayParseRoutes(routes.c_str(), t, err, sizeof(err))) {
+        fprintf(stderr, "routes: %s\n", err);
+        return 2;
+    }
+    std::vector<uint8_t> arena(GATEWAY_ARENA_LEN);
+    g.router.arena = arena.data();
+    g.router.send  = gatewaySend;
+    g.router.ctx   = &g;
+    gatewayRouterLoad(g.router, t);
+    g.e131         = e131;
+    g.universeSize = size;
+    g.fd           = udpSocket(loopback(1), e131 ? E131_PORT : DDP_PORT);
+    g.out          = udpSocket(loopback(1), 0);
+
+    std::vector<Node> node(nodes);
+    for (int i = 0; i < nodes; i++) {
+        node[i].fd      = udpSocket(loopback(NODE_BASE + i), DDP_PORT);
+        node[i].first   = i * channels;
+        node[i].count   = channels;
+        node[i].packets = 0;
+        node[i].bad     = 0;
+        node[i].thread  = std::thread(nodeLoop, &node[i]);
+    }
+    std::thread gw(gatewayLoop, &g);
+
+    printf("%d nodes x %d channels, %d frames at %d fps, %s in\n",
+           nodes, channels, frames, fps, e131 ? "E1.31" : "DDP");
+
+    int         tx = udpSocket(loopback(1), 0);
+    sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family      = AF_INET;
+    to.sin_port        = htons(e131 ? E131_PORT : DDP_PORT);
+    to.sin_addr.s_addr = loopback(1);
+
+    uint32_t total = (uint32_t)nodes * channels;
+    auto     next  = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        if (e131) sendE131(tx, to, f, total, size);
+        else      sendDdp(tx, to, f, total);
+        next += std::chrono::microseconds(1000000 / fps);
+        std::this_thread::sleep_until(next);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    g_stop = true;
+    gw.join();
+    for (Node &n : node) n.thread.join();
+
+    int failed = 0;
+    printf("%-12s %10s %6s %8s %7s\n", "node", "frames", "bad", "partial", "errors");
+    for (int i = 0; i < nodes; i++) {
+        const GatewayRouteStats &s = g.router.stats[i];
+        char name[16];
+        snprintf(name, sizeof(name), "127.0.0.%d", NODE_BASE + i);
+        printf("%-12s %5u/%-4d %6u %8u %7u\n", name, node[i].packets.load(), frames,
+               node[i].bad.load(), s.partial, s.errors);
+        if (node[i].packets != (uint32_t)frames || node[i].bad || s.partial) failed++;
+    }
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,456 @@
+// Interference benchmark: show traffic under web and discovery load.
+//
+// Streams steady Art-Net to one controller and reads back its frame acks
+// (src/frame_ack.h) while a scenario adds load next to the show:
+//
+//   quiet       show traffic only (the baseline)
+//   ui_poll     4 clients polling /api/config, /api/relay_stats, /metrics
+//   websocket   4 clients on /ws receiving every relay change
+//   discovery   200 FPP/xLights discovery requests per second on 32320
+//   config      a config save (NVS write) every 500 ms
+//   post        back-to-back 1 MB POSTs to /api/config (which keeps the
+//               first 3 KB and refuses the rest). Network and web-task
+//               load only: nothing is erased or flashed, so this is not
+//               a stand-in for an OTA update (flash erase/write stalls)
+//   all         everything above at once
+//
+// Per scenario it prints p50 / p99 / max packet-to-commit latency (socket
+// callback to relays committed, measured on the controller), frames not
+// acked (coalesced with a newer frame or lost), receive-queue drops from
+// /metrics, and the p99 change against the quiet baseline.
+//
+// The controller is switched to ack.mode=sender, ack.every=1 for the run
+// and restored afterwards; the config scenario toggles eol_cycles and
+// puts it back. Run it on a wired host next to the controller:
+//
+//   g++ -std=c++11 -O2 -pthread -o interference_bench tools/interference_bench.cpp
+//   ./interference_bench [-u universe] [-r fps] [-t seconds] [-s scenario,...] <ip>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FRAME_ACK_PORT        5570
+#define FRAME_ACK_HEADER_LEN  16
+#define FRAME_ACK_SAMPLE_LEN  12
+#define ARTNET_PORT           6454
+#define DISCOVERY_PORT        32320
+#define HTTP_PORT             80
+#define PROTO_ARTNET          0
+#define CHANNELS              512
+#define POST_BODY_BYTES       (1024 * 1024)
+
+enum Load : uint32_t {
+    LOAD_UI        = 1u << 0,
+    LOAD_WS        = 1u << 1,
+    LOAD_DISCOVERY = 1u << 2,
+    LOAD_CONFIG    = 1u << 3,
+    LOAD_POST      = 1u << 4,
+};
+
+struct Scenario {
+    const char *name;
+    uint32_t    loads;
+};
+
+static const Scenario SCENARIOS[] = {
+    { "quiet",     0 },
+    { "ui_poll",   LOAD_UI },
+    { "websocket", LOAD_WS },
+    { "discovery", LOAD_DISCOVERY },
+    { "config",    LOAD_CONFIG },
+    { "post",      LOAD_POST },
+    { "all",       LOAD_UI | LOAD_WS | LOAD_DISCOVERY | LOAD_CONFIG | LOAD_POST },
+};
+
+struct Result {
+    std::vector<double> applyUs;
+    uint32_t sent;
+    uint32_t acked;
+    uint32_t ackDropped;    // samples the controller couldn't send
+    long     queueDrops;    // relay_proto_dropped_total delta, -1 = unknown
+    uint32_t loadOps;       // requests / datagrams the load threads made
+    uint32_t loadErrors;
+};
+
+static sockaddr_in       g_target;
+static std::atomic<bool> g_loadRun(false);
+static std::atomic<uint32_t> g_loadOps(0);
+static std::atomic<uint32_t> g_loadErrors(0);
+
+static uint64_t nowUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void sleepMs(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// ---------- HTTP ----------
+
+static int tcpConnect(uint16_t port)
+{
+    int s = socket(AF_INET, SOCK_STREAM, 0);
+    if (s < 0) return -1;
+    timeval tv = { 5, 0 };
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    sockaddr_in a = g_target;
+    a.sin_port = htons(port);
+    if (connect(s, (sockaddr *)&a, sizeof(a)) != 0) {
+        close(s);
+        return -1;
+    }
+    return s;
+}
+
+static bool sendAll(int s, const char *data, size_t len)
+{
+    while (len) {
+        ssize_t n = send(s, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len  -= n;
+    }
+    return true;
+}
+
+// One request with Connection: close; returns the status, body in *body.
+static int http(const char *method, const char *path, const std::string &body,
+                const char *type, std::string *reply = nullptr)
+{
+    int s = tcpConnect(HTTP_PORT);
+    if (s < 0) return -1;
+
+    char head[256];
+    int  n = snprintf(head, sizeof(head),
+                      "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n"
+                      "Content-Type: %s\r\nContent-Length: %zu\r\n\r\n",
+                      method, path, inet_ntoa(g_target.sin_addr), type, body.size());
+    bool ok = sendAll(s, head, n) && sendAll(s, body.data(), body.size());
+
+    std::string in;
+    char buf[2048];
+    ssize_t got;
+    while (ok && (got = recv(s, buf, sizeof(buf), 0)) > 0) in.append(buf, got);
+    close(s);
+
+    int status = -1;
+    if (in.compare(0, 5, "HTTP/") == 0) status = atoi(in.c_str() + 9);
+    if (reply) {
+        size_t p = in.find("\r\n\r\n");
+        *reply = p == std::string::npos ? std::string() : in.substr(p + 4);
+    }
+    return status;
+}
+
+// "key":value (number or string) after from; false if absent.
+static bool jsonValue(const std::string &json, const char *key, std::string &out, size_t from = 0)
+{
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = json.find(k, from);
+    if (p == std::string::npos || (p = json.find(':', p + k.size())) == std::string::npos) return false;
+    p = json.find_first_not_of(" \t\r\n", p + 1);
+    if (p == std::string::npos) return false;
+    if (json[p] == '"') {
+        size_t e = json.find('"', p + 1);
+        out = json.substr(p + 1, e - p - 1);
+    } else {
+        size_t e = json.find_first_of(",}] \r\n", p);
+        out = json.substr(p, e - p);
+    }
+    return true;
+}
+
+// relay_proto_dropped_total{proto="artnet"} from /metrics, -1 if unknown.
+static long queueDrops()
+{
+    std::string m;
+    if (http("GET", "/metrics", "", "text/plain", &m) != 200) return -1;
+    const char *key = "relay_proto_dropped_total{proto=\"artnet\"} ";
+    size_t p = m.find(key);
+    return p == std::string::npos ? -1 : atol(m.c_str() + p + strlen(key));
+}
+
+// ---------- LOAD ----------
+
+static void countOp(bool ok)
+{
+    g_loadOps++;
+    if (!ok) g_loadErrors++;
+}
+
+static void uiPoller()
+{
+    static const char *const PATHS[] = { "/api/config", "/api/relay_stats", "/metrics" };
+    for (unsigned i = 0; g_loadRun; i++) {
+        countOp(http("GET", PATHS[i % 3], "", "text/plain") == 200);
+        sleepMs(250);
+    }
+}
+
+static void wsClient()
+{
+    while (g_loadRun) {
+        int s = tcpConnect(HTTP_PORT);
+        if (s < 0) {
+            countOp(false);
+            sleepMs(500);
+            continue;
+        }
+        char req[256];
+        int  n = snprintf(req, sizeof(req),
+                          "GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\n"
+                          "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n\r\n", inet_ntoa(g_target.sin_addr));
+        countOp(sendAll(s, req, n));
+
+        timeval tv = { 0, 200000 };
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        char buf[1024];
+        while (g_loadRun) {
+            ssize_t got = recv(s, buf, sizeof(buf), 0);
+            if (got == 0 || (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) break;
+        }
+        close(s);
+    }
+}
+
+static void discoveryFlood()
+{
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in a = g_target;
+    a.sin_port = htons(DISCOVERY_PORT);
+    const char ping[] = "FPPD";
+    while (g_loadRun) {
+        countOp(sendto(s, ping, sizeof(ping) - 1, 0, (sockaddr *)&a, sizeof(a)) > 0);
+        sleepMs(5);
+    }
+    close(s);
+}
+
+static void configSaver(long eolCycles)
+{
+    for (unsigned i = 0; g_loadRun; i++) {
+        std::string body = "{\"eol_cycles\":" + std::to_string(eolCycles + (i & 1)) + "}";
+        countOp(http("POST", "/api/config", body, "application/json") == 200);
+        sleepMs(500);
+    }
+    http("POST", "/api/config", "{\"eol_cycles\":" + std::to_string(eolCycles) + "}",
+         "application/json");
+}
+
+static void largePoster()
+{
+    std::string blob(POST_BODY_BYTES, '\xA5');
+    while (g_loadRun) {
+        int status = http("POST", "/api/config", blob, "application/octet-stream");
+        countOp(status == 413);         // received in full, then refused
+    }
+}
+
+// ---------- SHOW TRAFFIC + ACKS ----------
+
+static size_t buildArtDmx(uint8_t *pkt, uint16_t universe, uint8_t seq)
+{
+    memset(pkt, 0, 18 + CHANNELS);
+    memcpy(pkt, "Art-Net", 8);
+    pkt[9]  = 0x50;             // OpDmx
+    pkt[11] = 14;
+    pkt[12] = seq;
+    pkt[14] = universe & 0xFF;
+    pkt[15] = (universe >> 8) & 0x7F;
+    pkt[16] = CHANNELS >> 8;
+    pkt[17] = CHANNELS & 0xFF;
+    memset(pkt + 18, (seq & 0x10) ? 255 : 0, CHANNELS);
+    return 18 + CHANNELS;
+}
+
+static Result runScenario(int sock, const Scenario &sc, int universe, int fps, int seconds,
+                          long eolCycles)
+{
+    Result r = Result();
+    r.queueDrops = queueDrops();
+    g_loadOps    = 0;
+    g_loadErrors = 0;
+    g_loadRun    = true;
+
+    std::vector<std::thread> load;
+    for (int i = 0; i < 4 && (sc.loads & LOAD_UI); i++) load.push_back(std::thread(uiPoller));
+    for (int i = 0; i < 4 && (sc.loads & LOAD_WS); i++) load.push_back(std::thread(wsClient));
+    if (sc.loads & LOAD_DISCOVERY) load.push_back(std::thread(discoveryFlood));
+    if (sc.loads & LOAD_CONFIG)    load.push_back(std::thread(configSaver, eolCycles));
+    if (sc.loads & LOAD_POST)      load.push_back(std::thread(largePoster));
+    sleepMs(500);                       // let the load ramp up
+
+    const uint64_t period = 1000000u / fps;
+    const uint64_t end    = nowUs() + (uint64_t)seconds * 1000000u;
+    uint64_t nextSend = nowUs();
+    uint8_t  seq = 0;
+    uint8_t  pkt[18 + CHANNELS];
+    uint8_t  buf[1500];
+    sockaddr_in art = g_target;
+    art.sin_port = htons(ARTNET_PORT);
+
+    while (nowUs() < end + 500000u) {
+        uint64_t now = nowUs();
+        if (now >= nextSend && now < end) {
+            seq = seq == 255 ? 1 : seq + 1;
+            sendto(sock, pkt, buildArtDmx(pkt, universe, seq), 0, (sockaddr *)&art, sizeof(art));
+            r.sent++;
+            nextSend += period;
+        }
+
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n < FRAME_ACK_HEADER_LEN || memcmp(buf, "RACK", 4) != 0 || buf[4] != 1) continue;
+        uint8_t count = buf[5];
+        if (FRAME_ACK_HEADER_LEN + count * FRAME_ACK_SAMPLE_LEN > n) continue;
+        r.ackDropped += le32(buf + 12);
+        for (uint8_t i = 0; i < count; i++) {
+            const uint8_t *s = buf + FRAME_ACK_HEADER_LEN + i * FRAME_ACK_SAMPLE_LEN;
+            if (s[0] != PROTO_ARTNET) continue;
+            r.applyUs.push_back((double)(uint32_t)(le32(s + 8) - le32(s + 4)));
+            r.acked++;
+        }
+    }
+
+    g_loadRun = false;
+    for (std::thread &t : load) t.join();
+    r.loadOps    = g_loadOps;
+    r.loadErrors = g_loadErrors;
+
+    long after = queueDrops();
+    r.queueDrops = (r.queueDrops < 0 || after < 0) ? -1 : after - r.queueDrops;
+    return r;
+}
+
+static double percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[i];
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: interference_bench [-u universe] [-r fps] [-t seconds] "
+                    "[-s scenario,...] <ip>\nscenarios:");
+    for (const Scenario &s : SCENARIOS) fprintf(stderr, " %s", s.name);
+    fprintf(stderr, "\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int         universe = -1;
+    int         fps      = 40;
+    int         seconds  = 10;
+    std::string only;
+    const char *ip = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if      (a == "-u" && i + 1 < argc) universe = atoi(argv[++i]);
+        else if (a == "-r" && i + 1 < argc) fps      = atoi(argv[++i]);
+        else if (a == "-t" && i + 1 < argc) seconds  = atoi(argv[++i]);
+        else if (a == "-s" && i + 1 < argc) only     = "," + std::string(argv[++i]) + ",";
+        else if (a[0] != '-' && !ip)        ip       = argv[i];
+        else usage();
+    }
+    g_target = sockaddr_in();
+    g_target.sin_family = AF_INET;
+    if (!ip || inet_pton(AF_INET, ip, &g_target.sin_addr) != 1 || fps < 1 || fps > 1000 ||
+        seconds < 1) {
+        usage();
+    }
+
+    // What to restore afterwards; the universe defaults to the patch.
+    std::string cfg, ackMode = "off", ackEvery = "10", eol = "0", v;
+    if (http("GET", "/api/config", "", "text/plain", &cfg) != 200) {
+        fprintf(stderr, "interference_bench: no /api/config at %s\n", ip);
+        return 1;
+    }
+    size_t ackAt = cfg.find("\"ack\"");
+    if (ackAt != std::string::npos) {
+        jsonValue(cfg, "mode", ackMode, ackAt);
+        jsonValue(cfg, "every", ackEvery, ackAt);
+    }
+    jsonValue(cfg, "eol_cycles", eol);
+    if (universe < 0) universe = jsonValue(cfg, "universe", v) ? atoi(v.c_str()) : 0;
+
+    if (http("POST", "/api/config", "{\"ack\":{\"mode\":\"sender\",\"every\":1}}",
+             "application/json") != 200) {
+        fprintf(stderr, "interference_bench: controller refused ack.mode=sender\n");
+        return 1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = sockaddr_in();
+    local.sin_family      = AF_INET;
+    local.sin_port        = htons(FRAME_ACK_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (sockaddr *)&local, sizeof(local)) < 0) {
+        perror("ack port");
+        return 1;
+    }
+    timeval tv = { 0, 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    printf("%s, universe %d, %d fps, %d s per scenario\n\n", ip, universe, fps, seconds);
+    printf("%-10s %6s %6s %8s %8s %8s %8s %7s %7s %9s\n", "scenario", "sent", "acked",
+           "p50_us", "p99_us", "max_us", "vs_quiet", "q_drop", "ack_drp", "load_ops");
+
+    double baseP99 = -1;
+    for (const Scenario &sc : SCENARIOS) {
+        if (!only.empty() && strcmp(sc.name, "quiet") != 0 &&
+            only.find("," + std::string(sc.name) + ",") == std::string::npos) {
+            continue;
+        }
+        Result r = runScenario(sock, sc, universe, fps, seconds, atol(eol.c_str()));
+        double p50 = percentile(r.applyUs, 0.50);
+        double p99 = percentile(r.applyUs, 0.99);
+        double max = r.applyUs.empty() ? 0 : *std::max_element(r.applyUs.begin(), r.applyUs.end());
+        if (baseP99 < 0) baseP99 = p99;
+
+        char vs[16] = "-";
+        if (baseP99 > 0 && sc.loads) snprintf(vs, sizeof(vs), "%+.0f", p99 - baseP99);
+        char qd[24] = "?";
+        if (r.queueDrops >= 0) snprintf(qd, sizeof(qd), "%ld", r.queueDrops);
+        char ops[24];
+        snprintf(ops, sizeof(ops), "%u/%u", r.loadOps - r.loadErrors, r.loadOps);
+
+        printf("%-10s %6u %6u %8.0f %8.0f %8.0f %8s %7s %7u %9s\n", sc.name, r.sent, r.acked,
+               p50, p99, max, vs, qd, r.ackDropped, sc.loads ? ops : "-");
+        fflush(stdout);
+    }
+    close(sock);
+
+    http("POST", "/api/config",
+         "{\"ack\":{\"mode\":\"" + ackMode + "\",\"every\":" + ackEvery + "}}", "application/json");
+    return 0;
+}
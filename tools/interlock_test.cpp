@@ -0,0 +1,147 @@
+// Host check of the selector interlock rule (src/relay_interlock.h) that
+// commitRelays() applies to every write: fixed cases for the rule itself,
+// then random staged states on a virtual clock (as an API, scene or test
+// pattern could stage them, interlock or not) committed through the gate,
+// checking that two partners are never closed together and that no relay
+// closes before its partners have been open for its dead time.
+//
+// Prints one line per case and exits 1 on any failure.
+//
+// Build and run (Linux / macOS):
+//   g++ -std=c++11 -O2 -Isrc -o interlock_test tools/interlock_test.cpp src/relay_interlock.cpp
+//   ./interlock_test
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "relay_interlock.h"
+
+#define BIT(i)                ((RelayMask)1 << (i))
+
+static RelayMask g_partners[NUM_RELAYS];
+static uint16_t  g_deadMs[NUM_RELAYS];
+static int       g_failures;
+
+static void check(bool ok, const char *what, unsigned long long want, unsigned long long got)
+{
+    if (ok) return;
+    g_failures++;
+    if (g_failures <= 20) printf("  FAIL %s: want %llx, got %llx\n", what, want, got);
+}
+
+// Relays in `group` form one selector with dead time deadMs.
+static void selector(RelayMask group, uint16_t deadMs)
+{
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+        if (!(group & BIT(i))) continue;
+        g_partners[i] = group & ~BIT(i);
+        g_deadMs[i]   = deadMs;
+    }
+}
+
+// A two-way motor selector (0/1, 100 ms), a three-way one with no dead
+// time (2/3/4) and a free relay (5).
+static void setupTable()
+{
+    memset(g_partners, 0, sizeof(g_partners));
+    memset(g_deadMs, 0, sizeof(g_deadMs));
+    selector(BIT(0) | BIT(1), 100);
+    selector(BIT(2) | BIT(3) | BIT(4), 0);
+}
+
+static void ruleCases()
+{
+    uint32_t  offMs[NUM_RELAYS] = { 0 };
+    uint32_t  now = 10000;
+    RelayMask held, got;
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, 0, BIT(0) | BIT(1) | BIT(5), held);
+    check(got == (BIT(0) | BIT(5)) && !held, "partners close together: lowest wins",
+          BIT(0) | BIT(5), got);
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, BIT(1), BIT(0) | BIT(1), held);
+    check(got == BIT(1) && !held, "partner stays closed: refused", BIT(1), got);
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, BIT(1), BIT(0), held);
+    check(got == 0 && held == BIT(0), "partner opens this commit: held", BIT(0), held);
+    uint32_t wait = interlockWaitMs(g_partners, g_deadMs, offMs, now, BIT(1), 0);
+    check(wait == 100, "partner opens this commit: full dead time", 100, wait);
+
+    offMs[1] = now - 40;
+    got  = interlockGate(g_partners, g_deadMs, offMs, now, 0, BIT(0), held);
+    wait = interlockWaitMs(g_partners, g_deadMs, offMs, now, 0, 0);
+    check(got == 0 && held == BIT(0) && wait == 60, "partner open 40 ms: wait 60", 60, wait);
+
+    offMs[1] = now - 100;
+    got = interlockGate(g_partners, g_deadMs, offMs, now, 0, BIT(0), held);
+    check(got == BIT(0) && !held, "partner open for the dead time: closes", BIT(0), got);
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, BIT(3), BIT(4), held);
+    check(got == BIT(4) && !held, "no dead time: swap in one commit", BIT(4), got);
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, BIT(2), BIT(2) | BIT(3) | BIT(4), held);
+    check(got == BIT(2), "closed relay keeps its selector", BIT(2), got);
+
+    got = interlockGate(g_partners, g_deadMs, offMs, now, BIT(0), 0, held);
+    check(got == 0 && !held, "opening is never held", 0, got);
+
+    printf("%-34s %s\n", "rule cases", g_failures ? "FAIL" : "ok");
+}
+
+// Commit random staged states through the gate the way commitRelays()
+// does and check the invariants after every commit.
+static void randomCase(const char *name, uint32_t seed, uint32_t commits, uint32_t maxStepMs)
+{
+    uint32_t  offMs[NUM_RELAYS];
+    uint32_t  now   = UINT32_MAX - 5000;        // crosses the millis() wrap
+    RelayMask state = 0;
+    uint32_t  closes = 0, refused = 0, held = 0;
+    int       before = g_failures;
+    for (uint8_t i = 0; i < NUM_RELAYS; i++) offMs[i] = now - 1000;
+
+    for (uint32_t c = 0; c < commits; c++) {
+        seed = seed * 1103515245u + 12345u;
+        now += 1 + (seed >> 16) % maxStepMs;
+        seed = seed * 1103515245u + 12345u;
+        RelayMask next = (RelayMask)(seed >> 8) & (BIT(6) - 1);
+
+        RelayMask h;
+        RelayMask got = interlockGate(g_partners, g_deadMs, offMs, now, state, next, h);
+        check((got & ~next) == 0, name, next, got);     // never closes what was not staged
+        refused += __builtin_popcountll(next & ~got & ~h);
+        held    += __builtin_popcountll(h);
+
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+            RelayMask bit = BIT(i);
+            if ((state & bit) && !(got & bit)) offMs[i] = now;
+        }
+        for (uint8_t i = 0; i < NUM_RELAYS; i++) {
+            RelayMask bit = BIT(i);
+            if (!(got & bit)) continue;
+            check(!(got & g_partners[i]), name, 0, got & g_partners[i]);
+            if (state & bit) continue;
+            closes++;
+            for (uint8_t j = 0; j < NUM_RELAYS; j++) {
+                if (!(g_partners[i] & BIT(j))) continue;
+                bool ok = (state & BIT(j)) ? g_deadMs[i] == 0 && !(got & BIT(j))   // opens now
+                                           : now - offMs[j] >= g_deadMs[i];
+                check(ok, name, g_deadMs[i], now - offMs[j]);
+            }
+        }
+        state = got;
+    }
+    printf("%-34s %u commits: %u closes, %u refused, %u held, %s\n", name, commits,
+           closes, refused, held, g_failures == before ? "ok" : "FAIL");
+}
+
+int main()
+{
+    setupTable();
+    ruleCases();
+    randomCase("random, 1..30 ms apart", 1, 200000, 30);
+    randomCase("random, 1..300 ms apart", 7, 200000, 300);
+
+    printf("%s\n", g_failures ? "FAIL" : "OK");
+    return g_failures ? 1 : 0;
+}
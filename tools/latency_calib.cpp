@@ -0,0 +1,225 @@
+// Host-side latency calibration against controllers with frame acks on.
+//
+// Drives each controller with Art-Net at a steady rate and collects the
+// acks they send back (see src/frame_ack.h), then prints per controller:
+//
+//   offset   sender -> relays committed: one-way network + controller
+//   jitter   standard deviation of offset
+//   apply    receive -> commit inside the controller
+//   net      one-way network estimate (NTP style: round trip minus the
+//            time the controller held the sample, halved)
+//
+// A sequencer can lead each controller's data by its offset.
+//
+// Controllers need ack.mode=sender and, for a quick run, ack.every=1:
+//   curl -X POST http://<ip>/api/config -d '{"ack":{"mode":"sender","every":1}}'
+//
+// Build and run (Linux / macOS):
+//   g++ -std=c++11 -O2 -o latency_calib tools/latency_calib.cpp
+//   ./latency_calib [-u universe] [-r fps] [-t seconds] <ip> [<ip> ...]
+//
+// With -l it only listens on the ack port (controllers in collector mode
+// pointed at this host) and reports the apply time.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#define FRAME_ACK_PORT        5570
+#define FRAME_ACK_HEADER_LEN  16
+#define FRAME_ACK_SAMPLE_LEN  12
+#define ARTNET_PORT           6454
+#define PROTO_ARTNET          0
+#define CHANNELS              512
+
+struct Controller {
+    std::string         name;
+    sockaddr_in         addr;
+    uint64_t            sentUs[256];    // host time per Art-Net sequence
+    std::vector<double> offsetUs;
+    std::vector<double> applyUs;
+    std::vector<double> netUs;
+    uint32_t            dropped;
+};
+
+static uint64_t nowUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: latency_calib [-u universe] [-r fps] [-t seconds] <ip> [<ip> ...]\n"
+                    "       latency_calib -l [-t seconds]\n");
+    exit(2);
+}
+
+// ArtDmx for universe; the level flips so every frame is real show data.
+static size_t buildArtDmx(uint8_t *pkt, uint16_t universe, uint8_t seq)
+{
+    memset(pkt, 0, 18 + CHANNELS);
+    memcpy(pkt, "Art-Net", 8);
+    pkt[8]  = 0x00;             // OpDmx, little endian
+    pkt[9]  = 0x50;
+    pkt[11] = 14;               // protocol version
+    pkt[12] = seq;
+    pkt[14] = universe & 0xFF;
+    pkt[15] = (universe >> 8) & 0x7F;
+    pkt[16] = CHANNELS >> 8;
+    pkt[17] = CHANNELS & 0xFF;
+    memset(pkt + 18, (seq & 0x20) ? 255 : 0, CHANNELS);
+    return 18 + CHANNELS;
+}
+
+static Controller *findController(std::vector<Controller> &ctrls, const sockaddr_in &from,
+                                  bool add)
+{
+    for (Controller &c : ctrls) {
+        if (c.addr.sin_addr.s_addr == from.sin_addr.s_addr) return &c;
+    }
+    if (!add) return nullptr;
+    Controller c = Controller();
+    c.name = inet_ntoa(from.sin_addr);
+    c.addr = from;
+    ctrls.push_back(c);
+    return &ctrls.back();
+}
+
+static void handleAck(std::vector<Controller> &ctrls, bool listenOnly,
+                      const uint8_t *buf, ssize_t len, const sockaddr_in &from, uint64_t recvUs)
+{
+    if (len < FRAME_ACK_HEADER_LEN || memcmp(buf, "RACK", 4) != 0 || buf[4] != 1) return;
+    uint8_t count = buf[5];
+    if (FRAME_ACK_HEADER_LEN + count * FRAME_ACK_SAMPLE_LEN > len) return;
+
+    Controller *c = findController(ctrls, from, listenOnly);
+    if (!c) return;
+    uint32_t ackUs = le32(buf + 8);
+    c->dropped += le32(buf + 12);
+
+    for (uint8_t i = 0; i < count; i++) {
+        const uint8_t *s = buf + FRAME_ACK_HEADER_LEN + i * FRAME_ACK_SAMPLE_LEN;
+        uint32_t rxUs     = le32(s + 4);
+        uint32_t commitUs = le32(s + 8);
+        double   apply    = (double)(uint32_t)(commitUs - rxUs);
+        c->applyUs.push_back(apply);
+
+        if (listenOnly || s[0] != PROTO_ARTNET || !c->sentUs[s[1]]) continue;
+        double roundTrip = (double)(recvUs - c->sentUs[s[1]]);
+        double held      = (double)(uint32_t)(ackUs - rxUs);
+        if (roundTrip < held) continue;     // sequence reused, stale sample
+        double net = (roundTrip - held) / 2;
+        c->netUs.push_back(net);
+        c->offsetUs.push_back(net + apply);
+    }
+}
+
+static void stats(const std::vector<double> &v, double &mean, double &sd, double &p50, double &p95)
+{
+    mean = sd = p50 = p95 = 0;
+    if (v.empty()) return;
+    for (double x : v) mean += x;
+    mean /= v.size();
+    for (double x : v) sd += (x - mean) * (x - mean);
+    sd = std::sqrt(sd / v.size());
+    std::vector<double> s(v);
+    std::sort(s.begin(), s.end());
+    p50 = s[s.size() / 2];
+    p95 = s[(s.size() * 95) / 100 < s.size() ? (s.size() * 95) / 100 : s.size() - 1];
+}
+
+int main(int argc, char **argv)
+{
+    int      universe   = 0;
+    int      fps        = 40;
+    int      seconds    = 10;
+    bool     listenOnly = false;
+    std::vector<Controller> ctrls;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if      (a == "-u" && i + 1 < argc) universe = atoi(argv[++i]);
+        else if (a == "-r" && i + 1 < argc) fps      = atoi(argv[++i]);
+        else if (a == "-t" && i + 1 < argc) seconds  = atoi(argv[++i]);
+        else if (a == "-l")                 listenOnly = true;
+        else if (a[0] == '-')               usage();
+        else {
+            sockaddr_in addr = sockaddr_in();
+            addr.sin_family = AF_INET;
+            addr.sin_port   = htons(ARTNET_PORT);
+            if (inet_pton(AF_INET, a.c_str(), &addr.sin_addr) != 1) usage();
+            findController(ctrls, addr, true);
+        }
+    }
+    if ((ctrls.empty() && !listenOnly) || fps < 1 || fps > 1000 || seconds < 1) usage();
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local = sockaddr_in();
+    local.sin_family      = AF_INET;
+    local.sin_port        = htons(FRAME_ACK_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (sock < 0 || bind(sock, (sockaddr *)&local, sizeof(local)) < 0) {
+        perror("ack port");
+        return 1;
+    }
+    timeval tv = { 0, 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    const uint64_t period = 1000000u / fps;
+    const uint64_t end    = nowUs() + (uint64_t)seconds * 1000000u;
+    uint64_t nextSend = nowUs();
+    uint8_t  seq      = 0;
+    uint8_t  pkt[18 + CHANNELS];
+    uint8_t  buf[1500];
+
+    // Keep listening a second past the last frame for the trailing batches.
+    while (nowUs() < end + 1000000u) {
+        uint64_t now = nowUs();
+        if (!listenOnly && now >= nextSend && now < end) {
+            seq = seq == 255 ? 1 : seq + 1;     // Art-Net: 0 = not sequenced
+            size_t len = buildArtDmx(pkt, universe, seq);
+            for (Controller &c : ctrls) {
+                c.sentUs[seq] = nowUs();
+                sendto(sock, pkt, len, 0, (sockaddr *)&c.addr, sizeof(c.addr));
+            }
+            nextSend += period;
+        }
+
+        sockaddr_in from;
+        socklen_t   fromLen = sizeof(from);
+        ssize_t     n = recvfrom(sock, buf, sizeof(buf), 0, (sockaddr *)&from, &fromLen);
+        if (n > 0) handleAck(ctrls, listenOnly, buf, n, from, nowUs());
+    }
+    close(sock);
+
+    printf("%-16s %7s %10s %10s %10s %10s %10s %8s\n", "controller", "samples",
+           "offset_us", "p95_us", "jitter_us", "apply_us", "net_us", "dropped");
+    for (const Controller &c : ctrls) {
+        double om, osd, o50, o95, am, asd, a50, a95, nm, nsd, n50, n95;
+        stats(c.offsetUs, om, osd, o50, o95);
+        stats(c.applyUs, am, asd, a50, a95);
+        stats(c.netUs, nm, nsd, n50, n95);
+        printf("%-16s %7zu %10.0f %10.0f %10.0f %10.0f %10.0f %8u\n", c.name.c_str(),
+               listenOnly ? c.applyUs.size() : c.offsetUs.size(),
+               o50, o95, osd, a50, n50, c.dropped);
+    }
+    return 0;
+}
@@ -0,0 +1,489 @@
+// Offline show analyzer: relay load and I2C budget for one controller.
+//
+// Reads an xLights / FPP .fseq and the controller's patch, then reports
+// per relay (channel > 127 = on, as on the controller):
+//
+//   cycles     off -> on closures            rate   worst transitions / s
+//   duty       share of frames on            dwell  shortest time between
+//                                                   two transitions
+//   flags      CHATTER  transitions closer than -m ms (default 100)
+//              FADE     crossings with the level hovering around 127
+//
+// and per frame the I2C cost of the changes, as i2c_output.cpp does it
+// (one auto-increment write per changed board, two buses in parallel)
+// next to the old per-channel path (one 6-byte write per relay, one bus),
+// against the frame period.
+//
+// Frames are extracted and costed on all cores; compressed shows need
+// libzstd (build with -DSHOW_ANALYZER_ZSTD ... -lzstd).
+//
+//   g++ -std=c++11 -O2 -pthread -o show_analyzer tools/show_analyzer.cpp
+//   curl -o patch.json http://<ip>/api/config
+//   ./show_analyzer -c patch.json show.fseq
+//   ./show_analyzer -o 1537 -n 16 show.fseq      # absolute start channel
+//
+// Options: -o first channel (absolute, 1-based)   -n relays (16)
+//          -c /api/config JSON (universe, startChan, relays[].gpio)
+//          -U universe at channel 1 (1)   -z channels per universe (512)
+//          -b I2C buses (2)   -k I2C clock Hz (400000)
+//          -m chatter dwell ms (100)      -t threads (all cores)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef SHOW_ANALYZER_ZSTD
+#include <zstd.h>
+#endif
+
+#define RELAY_THRESHOLD       127         // level > this = relay on
+#define FADE_BAND             16          // "hovering" = within this of 127
+#define PCA9685_OUTPUTS       16
+#define I2C_BITS_PER_BYTE     9           // 8 data + ACK
+#define I2C_BITS_PER_XFER     2           // START + STOP
+#define FSEQ_COMPRESS_NONE    0
+#define FSEQ_COMPRESS_ZSTD    1
+#define FSEQ_COMPRESS_ZLIB    2
+
+struct Block {
+    uint32_t firstFrame;
+    uint64_t offset;        // in the file
+    uint32_t length;
+};
+
+struct Range {
+    uint32_t start;
+    uint32_t count;
+};
+
+struct Fseq {
+    const uint8_t     *map;
+    size_t             size;
+    uint32_t           dataOffset;
+    uint32_t           channels;    // per stored frame
+    uint32_t           frames;
+    uint8_t            stepMs;
+    uint8_t            compression;
+    std::vector<Block> blocks;
+    std::vector<Range> sparse;
+};
+
+struct Options {
+    long     first       = 0;       // absolute, 1-based; 0 = from config
+    int      relays      = 16;
+    int      universe0   = 1;
+    int      universeLen = 512;
+    int      buses       = 2;
+    uint32_t clockHz     = 400000;
+    uint32_t dwellMs     = 100;
+    unsigned threads     = 0;
+    std::vector<int> gpio;          // relay -> output
+};
+
+struct RelayReport {
+    uint32_t cycles;
+    uint32_t transitions;
+    uint32_t onFrames;
+    uint32_t worstRate;     // transitions in one second
+    uint32_t minDwellMs;
+    uint32_t shortDwells;
+    uint32_t fadeCrossings;
+};
+
+struct I2cReport {
+    uint64_t framesChanged;
+    uint64_t batchedSumUs;
+    uint64_t perChanSumUs;
+    uint32_t batchedMaxUs;
+    uint32_t perChanMaxUs;
+    uint32_t worstFrame;
+    uint32_t batchedOver;   // frames whose write doesn't fit the period
+    uint32_t perChanOver;
+    uint32_t maxChanged;
+};
+
+static uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static uint32_t le24(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+static uint32_t le32(const uint8_t *p) { return le24(p) | ((uint32_t)p[3] << 24); }
+
+static void die(const char *msg)
+{
+    fprintf(stderr, "show_analyzer: %s\n", msg);
+    exit(1);
+}
+
+// ---------- FSEQ ----------
+
+static void openFseq(const char *path, Fseq &f)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) die("cannot open the show file");
+    f.size = st.st_size;
+    void *m = mmap(nullptr, f.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) die("cannot map the show file");
+    f.map = (const uint8_t *)m;
+
+    const uint8_t *h = f.map;
+    if (f.size < 28 || (memcmp(h, "PSEQ", 4) != 0 && memcmp(h, "FSEQ", 4) != 0)) {
+        die("not an fseq file");
+    }
+    f.dataOffset  = le16(h + 4);
+    f.channels    = le32(h + 10);
+    f.frames      = le32(h + 14);
+    f.stepMs      = h[18] ? h[18] : 50;
+    f.compression = FSEQ_COMPRESS_NONE;
+
+    if (h[7] >= 2) {
+        f.compression = h[20] & 0x0F;
+        uint32_t nBlocks = ((uint32_t)(h[20] & 0xF0) << 4) | h[21];
+        uint32_t nSparse = h[22];
+        const uint8_t *p = h + 32;
+        if (32 + nBlocks * 8 + nSparse * 6 > f.size) die("truncated header");
+
+        uint64_t offset = f.dataOffset;
+        for (uint32_t i = 0; i < nBlocks; i++, p += 8) {
+            Block b = { le32(p), offset, le32(p + 4) };
+            offset += b.length;
+            if (b.length) f.blocks.push_back(b);
+        }
+        for (uint32_t i = 0; i < nSparse; i++, p += 6) {
+            Range r = { le24(p), le24(p + 3) };
+            f.sparse.push_back(r);
+        }
+    }
+
+    if (f.compression == FSEQ_COMPRESS_NONE &&
+        (uint64_t)f.dataOffset + (uint64_t)f.frames * f.channels > f.size) {
+        die("truncated channel data");
+    }
+#ifndef SHOW_ANALYZER_ZSTD
+    if (f.compression != FSEQ_COMPRESS_NONE) {
+        die("compressed show: rebuild with -DSHOW_ANALYZER_ZSTD -lzstd, or export uncompressed");
+    }
+#endif
+    if (f.compression == FSEQ_COMPRESS_ZLIB) die("zlib-compressed shows are not supported");
+}
+
+// Absolute channel (0-based) -> index in a stored frame, -1 if not stored.
+static long storedIndex(const Fseq &f, uint32_t channel)
+{
+    if (f.sparse.empty()) return channel < f.channels ? (long)channel : -1;
+    uint32_t base = 0;
+    for (const Range &r : f.sparse) {
+        if (channel >= r.start && channel < r.start + r.count) return base + channel - r.start;
+        base += r.count;
+    }
+    return -1;
+}
+
+// ---------- CONFIG ----------
+
+// Just enough JSON for /api/config: the first number after "key":
+static bool jsonNumber(const std::string &json, const char *key, size_t from, long &out,
+                       size_t *at = nullptr)
+{
+    std::string k = std::string("\"") + key + "\"";
+    size_t p = json.find(k, from);
+    if (p == std::string::npos) return false;
+    p = json.find(':', p + k.size());
+    if (p == std::string::npos) return false;
+    char *end = nullptr;
+    out = strtol(json.c_str() + p + 1, &end, 10);
+    if (at) *at = end - json.c_str();
+    return end != json.c_str() + p + 1;
+}
+
+static void readConfig(const char *path, Options &o)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) die("cannot open the config file");
+    std::string json;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) json.append(buf, n);
+    fclose(fp);
+
+    long universe = 0, startChan = 0, v = 0;
+    if (!jsonNumber(json, "universe", 0, universe) || !jsonNumber(json, "startChan", 0, startChan)) {
+        die("config has no universe / startChan");
+    }
+    if (!o.first) o.first = (universe - o.universe0) * (long)o.universeLen + startChan;
+    if (jsonNumber(json, "channels", 0, v)) o.relays = (int)v;
+
+    size_t at = json.find("\"relays\"");
+    o.gpio.clear();
+    while (at != std::string::npos && jsonNumber(json, "gpio", at, v, &at)) o.gpio.push_back((int)v);
+}
+
+// ---------- ANALYSIS ----------
+
+// Run fn(begin, end) over [0, n) split across threads.
+template <typename Fn>
+static void parallelFor(uint32_t n, unsigned threads, Fn fn)
+{
+    std::vector<std::thread> pool;
+    uint32_t chunk = (n + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; t++) {
+        uint32_t b = t * chunk, e = std::min(n, b + chunk);
+        if (b >= e) break;
+        pool.push_back(std::thread(fn, b, e));
+    }
+    for (std::thread &th : pool) th.join();
+}
+
+// levels[frame * relays + r] for every frame, from all cores.
+static std::vector<uint8_t> extractLevels(const Fseq &f, const Options &o, unsigned threads)
+{
+    std::vector<long> idx(o.relays);
+    for (int r = 0; r < o.relays; r++) idx[r] = storedIndex(f, (uint32_t)(o.first - 1 + r));
+
+    std::vector<uint8_t> levels((size_t)f.frames * o.relays, 0);
+    auto copyFrames = [&](const uint8_t *data, uint32_t first, uint32_t count) {
+        for (uint32_t i = 0; i < count && first + i < f.frames; i++) {
+            const uint8_t *frame = data + (size_t)i * f.channels;
+            uint8_t       *out   = &levels[(size_t)(first + i) * o.relays];
+            for (int r = 0; r < o.relays; r++) out[r] = idx[r] >= 0 ? frame[idx[r]] : 0;
+        }
+    };
+
+    if (f.compression == FSEQ_COMPRESS_NONE) {
+        parallelFor(f.frames, threads, [&](uint32_t b, uint32_t e) {
+            copyFrames(f.map + f.dataOffset + (size_t)b * f.channels, b, e - b);
+        });
+        return levels;
+    }
+
+#ifdef SHOW_ANALYZER_ZSTD
+    std::atomic<bool> failed(false);
+    parallelFor((uint32_t)f.blocks.size(), threads, [&](uint32_t b, uint32_t e) {
+        std::vector<uint8_t> buf;
+        for (uint32_t i = b; i < e; i++) {
+            const Block &blk = f.blocks[i];
+            uint32_t next  = i + 1 < f.blocks.size() ? f.blocks[i + 1].firstFrame : f.frames;
+            uint32_t count = next - blk.firstFrame;
+            buf.resize((size_t)count * f.channels);
+            if (blk.offset + blk.length > f.size) { failed = true; return; }
+            size_t got = ZSTD_decompress(buf.data(), buf.size(), f.map + blk.offset, blk.length);
+            if (ZSTD_isError(got)) { failed = true; return; }
+            copyFrames(buf.data(), blk.firstFrame, (uint32_t)(got / f.channels));
+        }
+    });
+    if (failed) die("corrupt compressed block");
+#endif
+    return levels;
+}
+
+static RelayReport analyzeRelay(const std::vector<uint8_t> &levels, const Fseq &f,
+                                const Options &o, int r)
+{
+    RelayReport rep = RelayReport();
+    rep.minDwellMs = UINT32_MAX;
+
+    bool     on = false;            // relays boot off
+    uint8_t  prevLevel = 0;
+    long     lastEdge = -1;
+    uint32_t second = 0, inSecond = 0;
+    const uint32_t framesPerSecond = std::max(1u, 1000u / f.stepMs);
+
+    for (uint32_t fr = 0; fr < f.frames; fr++) {
+        uint8_t v   = levels[(size_t)fr * o.relays + r];
+        bool    now = v > RELAY_THRESHOLD;
+        if (fr / framesPerSecond != second) {
+            second   = fr / framesPerSecond;
+            inSecond = 0;
+        }
+        if (now != on) {
+            rep.transitions++;
+            if (now) rep.cycles++;
+            rep.worstRate = std::max(rep.worstRate, ++inSecond);
+            if (lastEdge >= 0) {
+                uint32_t dwell = (fr - lastEdge) * f.stepMs;
+                rep.minDwellMs = std::min(rep.minDwellMs, dwell);
+                if (dwell < o.dwellMs) rep.shortDwells++;
+            }
+            if (abs(prevLevel - RELAY_THRESHOLD) <= FADE_BAND &&
+                abs(v - RELAY_THRESHOLD) <= FADE_BAND) {
+                rep.fadeCrossings++;
+            }
+            lastEdge = fr;
+            on = now;
+        }
+        if (on) rep.onFrames++;
+        prevLevel = v;
+    }
+    return rep;
+}
+
+static uint32_t xferUs(uint32_t bytes, const Options &o)
+{
+    uint64_t bits = (uint64_t)bytes * I2C_BITS_PER_BYTE + I2C_BITS_PER_XFER;
+    return (uint32_t)((bits * 1000000u + o.clockHz - 1) / o.clockHz);
+}
+
+static I2cReport analyzeI2c(const std::vector<uint8_t> &levels, const Fseq &f,
+                            const Options &o, unsigned threads)
+{
+    int outputs = 0;
+    for (int r = 0; r < o.relays; r++) outputs = std::max(outputs, o.gpio[r] + 1);
+    const int boards   = (outputs + PCA9685_OUTPUTS - 1) / PCA9685_OUTPUTS;
+    const uint32_t budgetUs = f.stepMs * 1000u;
+
+    std::vector<I2cReport> parts(threads, I2cReport());
+    std::atomic<unsigned>  slot(0);
+
+    parallelFor(f.frames, threads, [&](uint32_t b, uint32_t e) {
+        unsigned   me  = slot++;
+        I2cReport &rep = parts[me];
+        std::vector<uint16_t> dirty(boards);
+        std::vector<uint32_t> busUs(o.buses);
+
+        for (uint32_t fr = b; fr < e; fr++) {
+            std::fill(dirty.begin(), dirty.end(), 0);
+            uint32_t changed = 0;
+            for (int r = 0; r < o.relays; r++) {
+                bool now  = levels[(size_t)fr * o.relays + r] > RELAY_THRESHOLD;
+                bool prev = fr && levels[(size_t)(fr - 1) * o.relays + r] > RELAY_THRESHOLD;
+                if (now == prev) continue;
+                dirty[o.gpio[r] / PCA9685_OUTPUTS] |= 1u << (o.gpio[r] % PCA9685_OUTPUTS);
+                changed++;
+            }
+            if (!changed) continue;
+
+            // Batched: one write per board spanning its lowest..highest change,
+            // buses in parallel. Per channel: 6 bytes per relay, one bus.
+            std::fill(busUs.begin(), busUs.end(), 0);
+            for (int bd = 0; bd < boards; bd++) {
+                if (!dirty[bd]) continue;
+                int lo = __builtin_ctz(dirty[bd]);
+                int hi = 31 - __builtin_clz(dirty[bd]);
+                busUs[bd % o.buses] += xferUs(2 + 4 * (hi - lo + 1), o);
+            }
+            uint32_t batched = *std::max_element(busUs.begin(), busUs.end());
+            uint32_t perChan = changed * xferUs(6, o);
+
+            rep.framesChanged++;
+            rep.batchedSumUs += batched;
+            rep.perChanSumUs += perChan;
+            if (batched > rep.batchedMaxUs) {
+                rep.batchedMaxUs = batched;
+                rep.worstFrame   = fr;
+            }
+            rep.perChanMaxUs = std::max(rep.perChanMaxUs, perChan);
+            rep.maxChanged   = std::max(rep.maxChanged, changed);
+            if (batched > budgetUs) rep.batchedOver++;
+            if (perChan > budgetUs) rep.perChanOver++;
+        }
+    });
+
+    I2cReport all = I2cReport();
+    for (unsigned t = 0; t < slot; t++) {
+        const I2cReport &p = parts[t];
+        all.framesChanged += p.framesChanged;
+        all.batchedSumUs  += p.batchedSumUs;
+        all.perChanSumUs  += p.perChanSumUs;
+        all.batchedOver   += p.batchedOver;
+        all.perChanOver   += p.perChanOver;
+        all.perChanMaxUs   = std::max(all.perChanMaxUs, p.perChanMaxUs);
+        all.maxChanged     = std::max(all.maxChanged, p.maxChanged);
+        if (p.batchedMaxUs > all.batchedMaxUs) {
+            all.batchedMaxUs = p.batchedMaxUs;
+            all.worstFrame   = p.worstFrame;
+        }
+    }
+    return all;
+}
+
+// ---------- MAIN ----------
+
+static void usage()
+{
+    fprintf(stderr, "usage: show_analyzer [-o channel | -c config.json] [-n relays] [-U universe]\n"
+                    "                     [-z size] [-b buses] [-k hz] [-m ms] [-t threads] show.fseq\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Options     o;
+    const char *config = nullptr;
+    const char *show   = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if      (a == "-o" && more) o.first       = atol(argv[++i]);
+        else if (a == "-n" && more) o.relays      = atoi(argv[++i]);
+        else if (a == "-c" && more) config        = argv[++i];
+        else if (a == "-U" && more) o.universe0   = atoi(argv[++i]);
+        else if (a == "-z" && more) o.universeLen = atoi(argv[++i]);
+        else if (a == "-b" && more) o.buses       = atoi(argv[++i]);
+        else if (a == "-k" && more) o.clockHz     = atol(argv[++i]);
+        else if (a == "-m" && more) o.dwellMs     = atol(argv[++i]);
+        else if (a == "-t" && more) o.threads     = atoi(argv[++i]);
+        else if (a[0] != '-' && !show) show       = argv[i];
+        else usage();
+    }
+    if (!show) usage();
+    if (config) readConfig(config, o);
+    if (o.first < 1 || o.relays < 1 || o.relays > 64 || o.buses < 1 || o.buses > 2 || !o.clockHz) {
+        usage();
+    }
+    if ((int)o.gpio.size() < o.relays) {
+        for (int r = (int)o.gpio.size(); r < o.relays; r++) o.gpio.push_back(r);
+    }
+    unsigned threads = o.threads ? o.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    Fseq f = Fseq();
+    openFseq(show, f);
+    if (!f.frames) die("show has no frames");
+
+    std::vector<uint8_t> levels = extractLevels(f, o, threads);
+
+    std::vector<RelayReport> relays(o.relays);
+    parallelFor((uint32_t)o.relays, threads, [&](uint32_t b, uint32_t e) {
+        for (uint32_t r = b; r < e; r++) relays[r] = analyzeRelay(levels, f, o, (int)r);
+    });
+    I2cReport i2c = analyzeI2c(levels, f, o, threads);
+
+    double seconds = (double)f.frames * f.stepMs / 1000.0;
+    printf("%s: %u frames x %u ms (%.0f s), %u channels stored, channels %ld..%ld, %u thread(s)\n\n",
+           show, f.frames, f.stepMs, seconds, f.channels, o.first, o.first + o.relays - 1, threads);
+
+    printf("relay  channel  output   cycles  cycles/h  worst/s  duty%%  min_dwell_ms  flags\n");
+    for (int r = 0; r < o.relays; r++) {
+        const RelayReport &rep = relays[r];
+        char dwell[16] = "-";
+        if (rep.minDwellMs != UINT32_MAX) snprintf(dwell, sizeof(dwell), "%u", rep.minDwellMs);
+        std::string flags;
+        if (rep.shortDwells)   flags += "CHATTER(" + std::to_string(rep.shortDwells) + ") ";
+        if (rep.fadeCrossings) flags += "FADE(" + std::to_string(rep.fadeCrossings) + ")";
+        printf("%5d  %7ld  %6d  %7u  %8.0f  %7u  %5.1f  %12s  %s\n", r, o.first + r, o.gpio[r],
+               rep.cycles, rep.cycles * 3600.0 / seconds, rep.worstRate,
+               100.0 * rep.onFrames / f.frames, dwell, flags.c_str());
+    }
+
+    printf("\nI2C at %u Hz, %d bus(es), frame period %u us, %llu frames with changes "
+           "(at most %u relays at once)\n", o.clockHz, o.buses, f.stepMs * 1000u,
+           (unsigned long long)i2c.framesChanged, i2c.maxChanged);
+    if (i2c.framesChanged) {
+        printf("  batched      worst %6u us (frame %u)  mean %6.0f us  over budget %u frames\n",
+               i2c.batchedMaxUs, i2c.worstFrame, (double)i2c.batchedSumUs / i2c.framesChanged,
+               i2c.batchedOver);
+        printf("  per channel  worst %6u us             mean %6.0f us  over budget %u frames\n",
+               i2c.perChanMaxUs, (double)i2c.perChanSumUs / i2c.framesChanged, i2c.perChanOver);
+    }
+    return 0;
+}
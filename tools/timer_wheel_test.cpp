@@ -0,0 +1,233 @@
+// Host check of the relay timer wheel (src/timer_wheel.h) on a virtual
+// clock: pulse length from every start phase against the tick, interlock
+// dead time, long timers through the level 1 cascade, millis() wrapping
+// and the pending count behind wheelBusy(), with the loop calling
+// wheelAdvance() every millisecond or at irregular intervals.
+//
+// A timer may fire late by up to one tick plus one loop interval, never
+// early. Prints one line per case and exits 1 on any failure.
+//
+// Build and run (Linux / macOS):
+//   g++ -std=c++11 -O2 -Isrc -o timer_wheel_test tools/timer_wheel_test.cpp src/timer_wheel.cpp
+//   ./timer_wheel_test
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "timer_wheel.h"
+
+#define NODES                 64
+
+static uint32_t g_now;                      // virtual millis()
+static uint32_t g_firedAt[NODES];
+static bool     g_fired[NODES];
+static int      g_failures;
+
+static void expire(TimerNode &n)
+{
+    g_fired[n.id]   = true;
+    g_firedAt[n.id] = g_now;
+}
+
+// Loop interval: fixed, or 1..jitter ms from a fixed-seed generator.
+struct Clock {
+    uint32_t step;
+    uint32_t jitter;
+    uint32_t seed;
+
+    uint32_t next()
+    {
+        if (!jitter) return step;
+        seed = seed * 1103515245u + 12345u;
+        return 1 + (seed >> 16) % jitter;
+    }
+    uint32_t maxStep() const { return jitter ? jitter : step; }
+};
+
+static void check(bool ok, const char *what, uint32_t start, uint32_t want, uint32_t got)
+{
+    if (ok) return;
+    g_failures++;
+    if (g_failures <= 20) {
+        printf("  FAIL %s: start %u, want %u ms, got %u ms\n", what, start, want, got);
+    }
+}
+
+// Run until node id fired or limit ms passed; returns the elapsed time.
+static uint32_t runUntil(TimerWheel &w, Clock &c, uint8_t id, uint32_t start, uint32_t limit)
+{
+    while (!g_fired[id] && g_now - start <= limit) {
+        g_now += c.next();
+        wheelAdvance(w, g_now, expire);
+    }
+    return g_firedAt[id] - start;
+}
+
+// One pulse per run, started at phase r % WHEEL_TICK_MS against the last
+// processed tick (runUntil() alone would always stop at the same phase):
+// on at t, must go off after exactly pulseMs (rounded up to the tick and
+// the loop interval).
+static void pulseCase(const char *name, uint32_t origin, Clock c, uint32_t pulseMs, uint32_t runs)
+{
+    TimerWheel w;
+    TimerNode  n = TimerNode();
+    n.id   = 0;
+    g_now  = origin;
+    wheelInit(w, g_now);
+
+    uint32_t worst = 0, best = UINT32_MAX, phases = 0;
+    for (uint32_t r = 0; r < runs; r++) {
+        uint32_t phase = r % WHEEL_TICK_MS;
+        do {
+            g_now++;
+            wheelAdvance(w, g_now, expire);
+        } while (g_now - w.lastMs != phase);
+        phases |= 1u << phase;
+
+        uint32_t start = g_now;
+        g_fired[0] = false;
+        wheelSchedule(w, n, start, pulseMs);
+        check(wheelBusy(w), name, start, 1, w.pending);
+        uint32_t got = runUntil(w, c, 0, start, pulseMs + 4 * WHEEL_TICK_MS + c.maxStep());
+        bool ok = g_fired[0] && got >= pulseMs && got < pulseMs + WHEEL_TICK_MS + c.maxStep();
+        check(ok, name, start, pulseMs, got);
+        check(!wheelBusy(w), name, start, 0, w.pending);
+        if (got > worst) worst = got;
+        if (got < best)  best  = got;
+    }
+    uint32_t allPhases = (1u << WHEEL_TICK_MS) - 1;
+    check(runs < WHEEL_TICK_MS || phases == allPhases, name, 0, allPhases, phases);
+    printf("%-28s %6u ms  fired %u..%u ms over %u runs, %u start phases\n",
+           name, pulseMs, best, worst, runs, (unsigned)__builtin_popcount(phases));
+}
+
+// Interlock as relay_output.cpp does it: a partner opened at off, the
+// relay is asked to close at off + ask and is held by a delay timer for
+// the rest of the dead time.
+static void interlockCase(const char *name, uint32_t origin, Clock c, uint32_t deadMs)
+{
+    TimerWheel w;
+    TimerNode  n = TimerNode();
+    n.id  = 1;
+    g_now = origin;
+    wheelInit(w, g_now);
+
+    uint32_t worst = 0;
+    for (uint32_t ask = 0; ask < deadMs; ask += 7) {
+        uint32_t off = g_now;
+        while (g_now - off < ask) {
+            g_now += c.next();
+            wheelAdvance(w, g_now, expire);
+        }
+        uint32_t since = g_now - off;
+        if (since >= deadMs) continue;      // the loop step overshot it
+
+        g_fired[1] = false;
+        wheelSchedule(w, n, g_now, deadMs - since);
+        runUntil(w, c, 1, g_now, deadMs + 4 * WHEEL_TICK_MS + c.maxStep());
+        uint32_t closed = g_firedAt[1] - off;
+        bool ok = g_fired[1] && closed >= deadMs && closed < deadMs + WHEEL_TICK_MS + c.maxStep();
+        check(ok, name, off, deadMs, closed);
+        if (closed > worst) worst = closed;
+    }
+    printf("%-28s %6u ms  closed by %u ms after the partner opened\n", name, deadMs, worst);
+}
+
+// Many timers of random length at once, against the expected fire time.
+static void mixedCase(const char *name, uint32_t origin, Clock c)
+{
+    TimerWheel w;
+    TimerNode  n[NODES];
+    uint32_t   start[NODES], delay[NODES];
+    g_now = origin;
+    wheelInit(w, g_now);
+
+    uint32_t seed = 7;
+    for (uint8_t i = 0; i < NODES; i++) {
+        n[i]       = TimerNode();
+        n[i].id    = i;
+        g_fired[i] = false;
+        seed       = seed * 1103515245u + 12345u;
+        delay[i]   = (seed >> 8) % (WHEEL_MAX_MS + 1);
+        g_now     += c.next();
+        wheelAdvance(w, g_now, expire);
+        start[i] = g_now;
+        wheelSchedule(w, n[i], g_now, delay[i]);
+    }
+    uint32_t end = g_now + WHEEL_MAX_MS + 4 * WHEEL_TICK_MS + c.maxStep();
+    while ((int32_t)(end - g_now) > 0) {
+        g_now += c.next();
+        wheelAdvance(w, g_now, expire);
+    }
+
+    check(!wheelBusy(w), name, 0, 0, w.pending);
+    uint8_t late = 0;
+    for (uint8_t i = 0; i < NODES; i++) {
+        uint32_t got  = g_firedAt[i] - start[i];
+        uint32_t want = delay[i] ? delay[i] : 1;
+        bool ok = g_fired[i] && got >= want && got < want + WHEEL_TICK_MS + c.maxStep();
+        check(ok, name, start[i], delay[i], got);
+        if (!ok) late++;
+    }
+    printf("%-28s %6u timers up to %u ms, %u off\n", name, NODES, WHEEL_MAX_MS, late);
+}
+
+// Pending count through schedule, re-arm, cancel and expiry.
+static void countCase(const char *name)
+{
+    TimerWheel w;
+    TimerNode  n[NODES];
+    g_now = 0;
+    wheelInit(w, g_now);
+
+    for (uint8_t i = 0; i < NODES; i++) {
+        n[i]       = TimerNode();
+        n[i].id    = i;
+        g_fired[i] = false;
+        wheelSchedule(w, n[i], g_now, 100 + 37 * i);
+    }
+    check(w.pending == NODES, name, 0, NODES, w.pending);
+    for (uint8_t i = 0; i < NODES; i += 2) wheelSchedule(w, n[i], g_now, 50);   // re-arm
+    check(w.pending == NODES, name, 0, NODES, w.pending);
+    for (uint8_t i = 1; i < NODES; i += 2) wheelCancel(w, n[i]);
+    wheelCancel(w, n[1]);                                                      // twice
+    check(w.pending == NODES / 2, name, 0, NODES / 2, w.pending);
+
+    while (wheelBusy(w)) {
+        g_now++;
+        wheelAdvance(w, g_now, expire);
+        if (g_now > 1000) break;
+    }
+    check(w.pending == 0 && g_now <= 50 + 2 * WHEEL_TICK_MS, name, 0, 0, w.pending);
+    printf("%-28s %6u timers, busy until %u ms\n", name, NODES, g_now);
+}
+
+int main()
+{
+    const uint32_t wrap = UINT32_MAX - 2000;    // about 2 s before millis() wraps
+    Clock every1 = { 1, 0, 0 };
+    Clock every5 = { 5, 0, 0 };
+    Clock jitter = { 0, 13, 42 };
+
+    pulseCase("pulse 500", 0, every1, 500, 200);
+    pulseCase("pulse 10 (one tick)", 12345, every1, 10, 200);
+    pulseCase("pulse 737, 5 ms loop", 0, every5, 737, 200);
+    pulseCase("pulse 500, jittery loop", 0, jitter, 500, 200);
+    pulseCase("pulse 2000, long", 0, every1, 2000, 40);
+    pulseCase("pulse 500 across wrap", wrap, every1, 500, 20);
+    pulseCase("pulse 500 jittery, wrap", wrap, jitter, 500, 20);
+
+    interlockCase("dead time 100", 0, every1, 100);
+    interlockCase("dead time 250, jittery", 0, jitter, 250);
+    interlockCase("dead time 500 across wrap", wrap + 1500, every1, 500);
+
+    mixedCase("mixed", 0, every1);
+    mixedCase("mixed across wrap", UINT32_MAX - WHEEL_MAX_MS / 2, jitter);
+
+    countCase("pending count");
+
+    printf("%s\n", g_failures ? "FAIL" : "OK");
+    return g_failures ? 1 : 0;
+}